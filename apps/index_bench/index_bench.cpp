@@ -0,0 +1,540 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+/* Benchmark of the spatial indexes of vcg/space/index.
+
+Every index is built on the faces and on the vertices of a set of procedural
+meshes (see readme.txt) and timed on the same random queries; the datasets and
+the queries depend only on the command line, so two runs (e.g. of two releases)
+can be compared entry by entry.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/complex/algorithms/closest.h>
+#include <vcg/math/random_generator.h>
+#include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
+#include <vcg/space/index/octree.h>
+#include <vcg/space/index/bvh.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+using namespace std;
+
+class BFace; class BVertex;
+struct BUsedTypes : public UsedTypes<Use<BVertex>::AsVertexType, Use<BFace>::AsFaceType>{};
+
+class BVertex : public Vertex<BUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::Mark, vertex::BitFlags>{};
+class BFace   : public Face<BUsedTypes, face::VertexRef, face::Normal3f, face::FFAdj, face::Mark, face::BitFlags>{};
+class BMesh   : public tri::TriMesh< vector<BVertex>, vector<BFace> > {};
+
+////////////////// Memory accounting
+// The memory of an index is the increase of the heap in use due to its build,
+// as reported by the allocator (-1 where it cannot be queried).
+
+long long AllocatedBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__>2 || (__GLIBC__==2 && __GLIBC_MINOR__>=33))
+  struct mallinfo2 mi=mallinfo2();
+  return (long long)(mi.uordblks+mi.hblkhd);
+#elif defined(__GLIBC__)
+  struct mallinfo mi=mallinfo();
+  return (long long)(unsigned int)mi.uordblks+(long long)(unsigned int)mi.hblkhd;
+#elif defined(__APPLE__)
+  malloc_statistics_t st;
+  malloc_zone_statistics(NULL,&st);
+  return (long long)st.size_in_use;
+#else
+  return -1;
+#endif
+}
+
+long long MemoryDelta(long long mem0)
+{
+  const long long mem1=AllocatedBytes();
+  return (mem0<0 || mem1<0) ? -1 : mem1-mem0;
+}
+
+double Now()
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+////////////////// Command line parameters
+
+vector<int> Sizes;
+int QueryNum=10000;
+int KNum=8;
+unsigned int Seed=0;
+string OnlyDataset, OnlyIndex, JsonName;
+
+void Usage()
+{
+  printf("\nUsage:  "\
+         "index_bench [opt]\n"\
+         "Where opt can be:\n"\
+         "  -s#,#,...  sizes of the datasets, in faces (default 10000,100000)\n"\
+         "  -q#        number of queries of each kind (default 10000)\n"\
+         "  -k#        number of neighbours of the k-closest queries (default 8)\n"\
+         "  -r#        random seed of datasets and queries (default 0)\n"\
+         "  -d name    run only the dataset 'name' (sphere, scan, sheets, skewed)\n"\
+         "  -i name    run only the index 'name' (grid, hash, octree, aabb, bvh, kdtree)\n"\
+         "  -j file    write the results as JSON in 'file'\n"\
+         "\n");
+  exit(-1);
+}
+
+////////////////// Datasets
+// All the datasets are triangle meshes of about the requested number of faces
+// in the unit box; the point clouds are their vertices.
+
+const char *DatasetNames[]={"sphere","scan","sheets","skewed"};
+const int DatasetNum=4;
+
+// Height field grid over [0,1]^2 (z=0) with about faceNum faces
+void PlaneGrid(BMesh &m, int faceNum)
+{
+  const int w=max(2,int(sqrt(faceNum/2.0))+1);
+  tri::Grid(m,w,w,1,1);
+}
+
+void MakeDataset(BMesh &m, int dataset, int faceNum, math::MarsenneTwisterRNG &rnd)
+{
+  m.Clear();
+  switch(dataset)
+  {
+  case 0: // uniformly tessellated sphere
+    {
+      int subdiv=0;
+      while(20*(1<<(2*(subdiv+1))) <= faceNum*2) ++subdiv;
+      tri::Sphere(m,subdiv);
+      for(size_t i=0;i<m.vert.size();++i)
+        m.vert[i].P()=m.vert[i].P()*0.5f+Point3f(0.5f,0.5f,0.5f);
+    } break;
+  case 1: // range map of a bumpy surface with measurement noise along the view direction
+    PlaneGrid(m,faceNum);
+    for(size_t i=0;i<m.vert.size();++i)
+    {
+      Point3f &p=m.vert[i].P();
+      p[2]=0.1f*sin(6*p[0])*cos(5*p[1]) + 0.002f*float(rnd.generate01()-0.5);
+    }
+    break;
+  case 2: // eight almost coincident parallel sheets
+    {
+      const int layers=8;
+      for(int l=0;l<layers;++l)
+      {
+        BMesh sheet;
+        PlaneGrid(sheet,faceNum/layers);
+        for(size_t i=0;i<sheet.vert.size();++i)
+        {
+          Point3f &p=sheet.vert[i].P();
+          p[2]=0.001f*l;
+        }
+        tri::Append<BMesh,BMesh>::Mesh(m,sheet);
+      }
+    } break;
+  case 3: // surface with the vertices crowded towards a corner
+    PlaneGrid(m,faceNum);
+    for(size_t i=0;i<m.vert.size();++i)
+    {
+      Point3f &p=m.vert[i].P();
+      const float u=p[0], v=p[1];
+      p[0]=u*u*u*u; p[1]=v*v*v*v;
+      p[2]=0.05f*sin(4*u+3*v);
+    }
+    break;
+  }
+  tri::UpdateBounding<BMesh>::Box(m);
+  tri::UpdateNormal<BMesh>::PerFaceNormalized(m);
+}
+
+////////////////// Queries
+// Points in the bounding box of the dataset (enlarged by 10%); the boxes, spheres and rays
+// are centered at them. The sphere radius and the half side of the boxes are 1% of the diagonal.
+
+struct QuerySet
+{
+  vector<Point3f> p;
+  vector<Point3f> dir;
+  float maxDist, radius;
+  Box3f Box(int i) const
+  {
+    Box3f b;
+    b.Set(p[i]);
+    b.Offset(radius);
+    return b;
+  }
+};
+
+void MakeQueries(const BMesh &m, int n, math::MarsenneTwisterRNG &rnd, QuerySet &qs)
+{
+  Box3f bb=m.bbox;
+  bb.Offset(bb.Diag()*0.05f);
+  qs.maxDist=bb.Diag();
+  qs.radius=bb.Diag()*0.01f;
+  qs.p.resize(n);
+  qs.dir.resize(n);
+  for(int i=0;i<n;++i)
+  {
+    for(int j=0;j<3;++j)
+      qs.p[i][j]=bb.min[j]+float(rnd.generate01())*bb.Dim()[j];
+    Point3f d;
+    do {
+      d=Point3f(float(rnd.generate01())*2-1,float(rnd.generate01())*2-1,float(rnd.generate01())*2-1);
+    } while(d.SquaredNorm()>1 || d.SquaredNorm()<1e-4f);
+    qs.dir[i]=d.Normalize();
+  }
+}
+
+////////////////// Results
+
+enum { Q_CLOSEST, Q_KCLOSEST, Q_INBOX, Q_INSPHERE, Q_RAY, Q_NUM };
+const char *QueryNames[]={"closest","knn","inbox","insphere","ray"};
+
+struct Result
+{
+  string dataset, target, index;
+  int size, objNum;
+  double buildTime;
+  long long memory;
+  double rate[Q_NUM];       // queries per second, <0 if the index does not support them
+  long long found[Q_NUM];   // total number of objects found, to compare the indexes
+};
+
+vector<Result> Results;
+
+////////////////// Output
+
+void PrintResult(const Result &r)
+{
+  printf("%-7s %8i %-6s %-7s %9i %9.1f",r.dataset.c_str(),r.size,r.target.c_str(),r.index.c_str(),
+         r.objNum,1000*r.buildTime);
+  if(r.memory<0) printf(" %9s","-");
+  else printf(" %9.2f",r.memory/(1024.0*1024.0));
+  for(int q=0;q<Q_NUM;++q)
+    if(r.rate[q]<0) printf(" %9s","-");
+    else printf(" %9.1f",r.rate[q]/1000);
+  printf("\n");
+  fflush(stdout);
+}
+
+////////////////// Targets
+// The queries are issued through the same tri:: functions used by the algorithms.
+
+struct FaceTarget
+{
+  typedef BFace ObjType;
+  enum { HasRay=1 };
+  static const char *Name() { return "faces"; }
+  static int ObjNum(BMesh &m) { return m.fn; }
+  template <class INDEX> static void Set(BMesh &m, INDEX &idx) { idx.Set(m.face.begin(),m.face.end()); }
+
+  template <class INDEX> static int Closest(BMesh &m, INDEX &idx, const Point3f &p, float maxDist)
+  {
+    float dist; Point3f q;
+    return tri::GetClosestFaceBase(m,idx,p,maxDist,dist,q)!=0;
+  }
+  template <class INDEX> static int KClosest(BMesh &m, INDEX &idx, int k, const Point3f &p, float maxDist)
+  {
+    static vector<BFace*> o; static vector<float> d; static vector<Point3f> q;
+    return tri::GetKClosestFaceBase(m,idx,k,p,maxDist,o,d,q);
+  }
+  template <class INDEX> static int InSphere(BMesh &m, INDEX &idx, const Point3f &p, float r)
+  {
+    static vector<BFace*> o; static vector<float> d; static vector<Point3f> q;
+    return tri::GetInSphereFaceBase(m,idx,p,r,o,d,q);
+  }
+  template <class INDEX> static int InBox(BMesh &m, INDEX &idx, const Box3f &b)
+  {
+    static vector<BFace*> o;
+    return tri::GetInBoxFace(m,idx,b,o);
+  }
+  template <class INDEX> static int Ray(BMesh &m, INDEX &idx, const Ray3f &r, float maxDist)
+  {
+    float t;
+    return tri::DoRay(m,idx,r,maxDist,t)!=0;
+  }
+};
+
+struct VertexTarget
+{
+  typedef BVertex ObjType;
+  enum { HasRay=0 };
+  static const char *Name() { return "points"; }
+  static int ObjNum(BMesh &m) { return m.vn; }
+  template <class INDEX> static void Set(BMesh &m, INDEX &idx) { idx.Set(m.vert.begin(),m.vert.end()); }
+
+  template <class INDEX> static int Closest(BMesh &m, INDEX &idx, const Point3f &p, float maxDist)
+  {
+    float dist;
+    return tri::GetClosestVertex(m,idx,p,maxDist,dist)!=0;
+  }
+  template <class INDEX> static int KClosest(BMesh &m, INDEX &idx, int k, const Point3f &p, float maxDist)
+  {
+    static vector<BVertex*> o; static vector<float> d; static vector<Point3f> q;
+    return tri::GetKClosestVertex(m,idx,k,p,maxDist,o,d,q);
+  }
+  template <class INDEX> static int InSphere(BMesh &m, INDEX &idx, const Point3f &p, float r)
+  {
+    static vector<BVertex*> o; static vector<float> d; static vector<Point3f> q;
+    return tri::GetInSphereVertex(m,idx,p,r,o,d,q);
+  }
+  template <class INDEX> static int InBox(BMesh &m, INDEX &idx, const Box3f &b)
+  {
+    static vector<BVertex*> o;
+    return tri::GetInBoxVertex(m,idx,b,o);
+  }
+  template <class INDEX> static int Ray(BMesh &, INDEX &, const Ray3f &, float) { return 0; }
+};
+
+////////////////// Indexes
+// Queries supported by each index; the unsupported ones are not compiled.
+
+template <class INDEX> struct IndexCaps { enum { InBox=1, InSphere=1, Ray=1 }; };
+template <class O, class S> struct IndexCaps<Octree<O,S> > { enum { InBox=1, InSphere=1, Ray=0 }; };
+template <class O, class S, class A> struct IndexCaps<AABBBinaryTreeIndex<O,S,A> > { enum { InBox=0, InSphere=0, Ray=1 }; };
+
+template <bool ENABLED> struct QueryRunner
+{
+  template <class TARGET, class INDEX> static void InBox(BMesh &m, INDEX &idx, const QuerySet &qs, Result &r)
+  {
+    const double t0=Now();
+    for(size_t i=0;i<qs.p.size();++i) r.found[Q_INBOX]+=TARGET::InBox(m,idx,qs.Box(int(i)));
+    r.rate[Q_INBOX]=qs.p.size()/max(Now()-t0,1e-9);
+  }
+  template <class TARGET, class INDEX> static void InSphere(BMesh &m, INDEX &idx, const QuerySet &qs, Result &r)
+  {
+    const double t0=Now();
+    for(size_t i=0;i<qs.p.size();++i) r.found[Q_INSPHERE]+=TARGET::InSphere(m,idx,qs.p[i],qs.radius);
+    r.rate[Q_INSPHERE]=qs.p.size()/max(Now()-t0,1e-9);
+  }
+  template <class TARGET, class INDEX> static void Ray(BMesh &m, INDEX &idx, const QuerySet &qs, Result &r)
+  {
+    const double t0=Now();
+    for(size_t i=0;i<qs.p.size();++i) r.found[Q_RAY]+=TARGET::Ray(m,idx,Ray3f(qs.p[i],qs.dir[i]),qs.maxDist);
+    r.rate[Q_RAY]=qs.p.size()/max(Now()-t0,1e-9);
+  }
+};
+
+template <> struct QueryRunner<false>
+{
+  template <class TARGET, class INDEX> static void InBox(BMesh &, INDEX &, const QuerySet &, Result &) {}
+  template <class TARGET, class INDEX> static void InSphere(BMesh &, INDEX &, const QuerySet &, Result &) {}
+  template <class TARGET, class INDEX> static void Ray(BMesh &, INDEX &, const QuerySet &, Result &) {}
+};
+
+void InitResult(Result &r, const char *dataset, int size, const char *target, const char *index, int objNum)
+{
+  r.dataset=dataset; r.size=size; r.target=target; r.index=index; r.objNum=objNum;
+  for(int q=0;q<Q_NUM;++q) { r.rate[q]=-1; r.found[q]=0; }
+}
+
+template <class TARGET, class INDEX>
+void RunIndex(BMesh &m, const char *dataset, int size, const char *indexName, const QuerySet &qs)
+{
+  if(!OnlyIndex.empty() && OnlyIndex!=indexName) return;
+  Result r;
+  InitResult(r,dataset,size,TARGET::Name(),indexName,TARGET::ObjNum(m));
+
+  const long long mem0=AllocatedBytes();
+  double t0=Now();
+  INDEX *idx=new INDEX;
+  TARGET::Set(m,*idx);
+  r.buildTime=Now()-t0;
+  r.memory=MemoryDelta(mem0);
+
+  t0=Now();
+  for(size_t i=0;i<qs.p.size();++i) r.found[Q_CLOSEST]+=TARGET::Closest(m,*idx,qs.p[i],qs.maxDist);
+  r.rate[Q_CLOSEST]=qs.p.size()/max(Now()-t0,1e-9);
+  t0=Now();
+  for(size_t i=0;i<qs.p.size();++i) r.found[Q_KCLOSEST]+=TARGET::KClosest(m,*idx,KNum,qs.p[i],qs.maxDist);
+  r.rate[Q_KCLOSEST]=qs.p.size()/max(Now()-t0,1e-9);
+  QueryRunner<IndexCaps<INDEX>::InBox!=0>::template InBox<TARGET>(m,*idx,qs,r);
+  QueryRunner<IndexCaps<INDEX>::InSphere!=0>::template InSphere<TARGET>(m,*idx,qs,r);
+  QueryRunner<IndexCaps<INDEX>::Ray!=0 && TARGET::HasRay!=0>::template Ray<TARGET>(m,*idx,qs,r);
+  delete idx;
+  Results.push_back(r);
+  PrintResult(r);
+}
+
+// The kd-tree indexes only points and answers only the k-closest queries
+void RunKdTree(BMesh &m, const char *dataset, int size, const QuerySet &qs)
+{
+  if(!OnlyIndex.empty() && OnlyIndex!="kdtree") return;
+  Result r;
+  InitResult(r,dataset,size,VertexTarget::Name(),"kdtree",m.vn);
+
+  const long long mem0=AllocatedBytes();
+  double t0=Now();
+  VertexConstDataWrapper<BMesh> ww(m);
+  KdTree<float> *tree=new KdTree<float>(ww);
+  r.buildTime=Now()-t0;
+  r.memory=MemoryDelta(mem0);
+
+  KdTree<float>::PriorityQueue queue;
+  t0=Now();
+  for(size_t i=0;i<qs.p.size();++i)
+  {
+    tree->doQueryK(qs.p[i],1,queue);
+    r.found[Q_CLOSEST]+=queue.getNofElements();
+  }
+  r.rate[Q_CLOSEST]=qs.p.size()/max(Now()-t0,1e-9);
+  t0=Now();
+  for(size_t i=0;i<qs.p.size();++i)
+  {
+    tree->doQueryK(qs.p[i],KNum,queue);
+    r.found[Q_KCLOSEST]+=queue.getNofElements();
+  }
+  r.rate[Q_KCLOSEST]=qs.p.size()/max(Now()-t0,1e-9);
+  delete tree;
+  Results.push_back(r);
+  PrintResult(r);
+}
+
+template <class TARGET>
+void RunTarget(BMesh &m, const char *dataset, int size, const QuerySet &qs)
+{
+  typedef typename TARGET::ObjType ObjType;
+  RunIndex<TARGET, GridStaticPtr<ObjType,float> >(m,dataset,size,"grid",qs);
+  RunIndex<TARGET, SpatialHashTable<ObjType,float> >(m,dataset,size,"hash",qs);
+  RunIndex<TARGET, Octree<ObjType,float> >(m,dataset,size,"octree",qs);
+  RunIndex<TARGET, BVHIndex<ObjType,float> >(m,dataset,size,"bvh",qs);
+}
+
+bool WriteJson(const char *filename)
+{
+  FILE *fp=fopen(filename,"w");
+  if(fp==0) return false;
+  fprintf(fp,"{\n  \"benchmark\": \"vcg_index_bench\",\n  \"version\": 1,\n");
+  fprintf(fp,"  \"seed\": %u,\n  \"queries\": %i,\n  \"k\": %i,\n",Seed,QueryNum,KNum);
+#ifdef _OPENMP
+  fprintf(fp,"  \"threads\": %i,\n",omp_get_max_threads());
+#else
+  fprintf(fp,"  \"threads\": 1,\n");
+#endif
+  fprintf(fp,"  \"results\": [\n");
+  for(size_t i=0;i<Results.size();++i)
+  {
+    const Result &r=Results[i];
+    fprintf(fp,"    {\"dataset\": \"%s\", \"size\": %i, \"target\": \"%s\", \"index\": \"%s\", \"objects\": %i,\n",
+            r.dataset.c_str(),r.size,r.target.c_str(),r.index.c_str(),r.objNum);
+    fprintf(fp,"     \"build_ms\": %.3f, \"memory_bytes\": ",1000*r.buildTime);
+    if(r.memory<0) fprintf(fp,"null");
+    else fprintf(fp,"%lld",r.memory);
+    fprintf(fp,",\n     \"queries_per_second\": {");
+    for(int q=0;q<Q_NUM;++q)
+    {
+      fprintf(fp,"%s\"%s\": ",q?", ":"",QueryNames[q]);
+      if(r.rate[q]<0) fprintf(fp,"null");
+      else fprintf(fp,"%.1f",r.rate[q]);
+    }
+    fprintf(fp,"},\n     \"found\": {");
+    for(int q=0;q<Q_NUM;++q)
+    {
+      fprintf(fp,"%s\"%s\": ",q?", ":"",QueryNames[q]);
+      if(r.rate[q]<0) fprintf(fp,"null");
+      else fprintf(fp,"%lld",r.found[q]);
+    }
+    fprintf(fp,"}}%s\n",i+1<Results.size()?",":"");
+  }
+  fprintf(fp,"  ]\n}\n");
+  return fclose(fp)==0;
+}
+
+int main(int argc, char **argv)
+{
+  for(int i=1;i<argc;++i)
+  {
+    if(argv[i][0]!='-') Usage();
+    switch(argv[i][1])
+    {
+    case 's':
+      for(char *tok=strtok(&argv[i][2],",");tok;tok=strtok(0,","))
+        if(atoi(tok)>0) Sizes.push_back(atoi(tok));
+      break;
+    case 'q': QueryNum=max(1,atoi(&argv[i][2])); break;
+    case 'k': KNum=max(1,atoi(&argv[i][2])); break;
+    case 'r': Seed=(unsigned int)(atoi(&argv[i][2])); break;
+    case 'd': if(++i>=argc) Usage(); OnlyDataset=argv[i]; break;
+    case 'i': if(++i>=argc) Usage(); OnlyIndex=argv[i]; break;
+    case 'j': if(++i>=argc) Usage(); JsonName=argv[i]; break;
+    default: Usage();
+    }
+  }
+  if(Sizes.empty()) { Sizes.push_back(10000); Sizes.push_back(100000); }
+
+  printf("%-7s %8s %-6s %-7s %9s %9s %9s %9s %9s %9s %9s %9s\n","dataset","size","target","index",
+         "objects","build ms","mem MB","closest","knn","inbox","insphere","ray");
+  printf("%62s(thousands of queries per second)\n","");
+  for(int d=0;d<DatasetNum;++d)
+  {
+    if(!OnlyDataset.empty() && OnlyDataset!=DatasetNames[d]) continue;
+    for(size_t s=0;s<Sizes.size();++s)
+    {
+      // every dataset has its own generator, so it does not depend on the other ones
+      math::MarsenneTwisterRNG rnd;
+      unsigned int key[3]={Seed,(unsigned int)(d),(unsigned int)(Sizes[s])};
+      rnd.initializeByArray(key,3);
+      BMesh m;
+      MakeDataset(m,d,Sizes[s],rnd);
+      QuerySet qs;
+      MakeQueries(m,QueryNum,rnd,qs);
+
+      RunTarget<FaceTarget>(m,DatasetNames[d],Sizes[s],qs);
+      RunIndex<FaceTarget, AABBBinaryTreeIndex<BFace,float,EmptyClass> >(m,DatasetNames[d],Sizes[s],"aabb",qs);
+      RunTarget<VertexTarget>(m,DatasetNames[d],Sizes[s],qs);
+      RunKdTree(m,DatasetNames[d],Sizes[s],qs);
+    }
+  }
+
+  if(!JsonName.empty() && !WriteJson(JsonName.c_str()))
+  {
+    printf("unable to write '%s'\n",JsonName.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,12 @@
+TARGET = index_bench
+INCLUDEPATH += . ../..
+CONFIG += console stl
+TEMPLATE = app
+SOURCES += index_bench.cpp
+
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
+
+# Mac specific Config required to avoid to make application bundles
+CONFIG -= app_bundle
@@ -107,6 +107,7 @@ GPL  added
 #include <wrap/io_trimesh/export.h>
 #include <vcg/complex/algorithms/update/component_ep.h>
 #include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/bounded_hausdorff.h>
 #include "sampling.h"
 
 using namespace std;
@@ -145,6 +146,8 @@ using namespace vcg;
 bool NumberOfSamples                = false;
 bool SamplesPerAreaUnit             = false;
 bool CleaningFlag=false;
+double StopBound=-1;
+double BoundedError=-1;
 // -----------------------------------------------------------------------------------------------
 
 void Usage()
@@ -166,6 +169,9 @@ void Usage()
                                         "  -c         save a mesh with error as per-vertex colour and quality\n"\
                                         "  -C # #     Set the min/max values used for color mapping\n"\
                                         "  -L         Remove duplicated and unreferenced vertices before processing\n"\
+                                        "  -b#        stop as soon as a distance greater than # is found (exit code 1)\n"\
+                                        "  -E#        compute the Hausdorff distance with an absolute error of at most #\n"\
+                                        "             (branch and bound on an AABB tree, no sampling)\n"\
                                         "  -h         write files with histograms of error distribution\n"\
                                         "  -G         Use a static Uniform Grid as Search Structure (default)\n"\
 																				"  -O         Use an octree as a Search Structure\n"\
@@ -253,6 +259,8 @@ int main(int argc, char**argv)
         case 'a':  SamplesPerAreaUnit    = true;     n_samples_per_area_unit = (unsigned long) atoi(&(argv[i][2])); break;
         case 'c':  flags |= SamplingFlags::SAVE_ERROR;   break;
         case 'L':  CleaningFlag=true; break;
+        case 'b':  StopBound = atof(&(argv[i][2])); break;
+        case 'E':  BoundedError = atof(&(argv[i][2])); break;
         case 'C':  ColorMin=float(atof(argv[i+1])); ColorMax=float(atof(argv[i+2])); i+=2; break;
         case 'A':  flags |= SamplingFlags::USE_AABB_TREE;   printf("Using AABB Tree as search structure\n");           break;
         case 'G':  flags |= SamplingFlags::USE_STATIC_GRID; printf("Using static uniform grid as search structure\n"); break;
@@ -311,6 +319,24 @@ int main(int argc, char**argv)
     printf("\tbbox (%7.4f %7.4f %7.4f)-(%7.4f %7.4f %7.4f)\n", tmp_bbox_M2.min[0], tmp_bbox_M2.min[1], tmp_bbox_M2.min[2], tmp_bbox_M2.max[0], tmp_bbox_M2.max[1], tmp_bbox_M2.max[2]);
     printf("\tbbox diagonal %f\n", (float)tmp_bbox_M2.Diag());
 
+    if(BoundedError>0)
+    {
+      tri::BoundedHausdorff<CMesh> forward, backward;
+      forward.Init(S2);
+      forward.Compute(S1,BoundedError);
+      backward.Init(S1);
+      backward.Compute(S2,BoundedError);
+      printf("\nForward distance (M1 -> M2):  max in [%f %f]\n", forward.Lower(), forward.Upper());
+      printf("  # closest point queries %9i\n  # split triangles       %9i\n", forward.QueryNum(), forward.PieceNum());
+      printf("\nBackward distance (M2 -> M1): max in [%f %f]\n", backward.Lower(), backward.Upper());
+      printf("  # closest point queries %9i\n  # split triangles       %9i\n", backward.QueryNum(), backward.PieceNum());
+      const double lower=max(forward.Lower(),backward.Lower()), upper=max(forward.Upper(),backward.Upper());
+      printf("\nHausdorff distance: %f (%f  wrt bounding box diagonal), at most %f\n", (float)lower, (float)lower/bbox.Diag(), (float)upper);
+      printf("  Error bound       : %f\n", (float)max(forward.MaxErr(),backward.MaxErr()));
+      printf("  Computation time  : %d ms\n\n",(int)(1000.0*(clock()-t0)/CLOCKS_PER_SEC));
+      return 0;
+    }
+
     // Forward distance.
     printf("\nForward distance (M1 -> M2):\n");
     ForwardSampling.SetFlags(flags);
@@ -325,7 +351,13 @@ int main(int argc, char**argv)
         n_samples_target = ForwardSampling.GetNSamplesTarget();
     }
     printf("target # samples      : %lu\ntarget # samples/area : %f\n", n_samples_target, n_samples_per_area_unit);
+    ForwardSampling.SetStopBound(StopBound);
     ForwardSampling.Hausdorff();
+    if(ForwardSampling.BoundExceeded())
+    {
+      printf("\nHausdorff distance greater than %f (found %f), sampling stopped\n", StopBound, ForwardSampling.GetDistMax());
+      return 1;
+    }
     dist1_max  = ForwardSampling.GetDistMax();
     printf("\ndistances:\n  max  : %f (%f  wrt bounding box diagonal)\n", (float)dist1_max, (float)dist1_max/bbox.Diag());
     printf("  mean : %f\n", ForwardSampling.GetDistMean());
@@ -350,7 +382,13 @@ int main(int argc, char**argv)
         n_samples_target = BackwardSampling.GetNSamplesTarget();
     }
     printf("target # samples      : %lu\ntarget # samples/area : %f\n", n_samples_target, n_samples_per_area_unit);
+    BackwardSampling.SetStopBound(StopBound);
     BackwardSampling.Hausdorff();
+    if(BackwardSampling.BoundExceeded())
+    {
+      printf("\nHausdorff distance greater than %f (found %f), sampling stopped\n", StopBound, BackwardSampling.GetDistMax());
+      return 1;
+    }
     dist2_max  = BackwardSampling.GetDistMax();
     printf("\ndistances:\n  max  : %f (%f  wrt bounding box diagonal)\n", (float)dist2_max, (float)dist2_max/bbox.Diag());
     printf("  mean : %f\n", BackwardSampling.GetDistMean());
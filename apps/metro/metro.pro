@@ -6,5 +6,9 @@ TEMPLATE = app
 HEADERS += sampling.h
 SOURCES += metro.cpp ../../wrap/ply/plylib.cpp
 
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
+
 # Mac specific Config required to avoid to make application bundles
 CONFIG -= app_bundle
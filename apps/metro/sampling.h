@@ -32,6 +32,7 @@
 #include <vcg/simplex/face/distance.h>
 #include <vcg/complex/algorithms/update/color.h>
 #include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/index/grid_triangle_soa.h>
 #include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
 #include <vcg/space/index/octree.h>
 #include <vcg/space/index/spatial_hashing.h>
@@ -86,6 +87,7 @@ private:
     MetroMesh       &S1;
     MetroMesh       &S2;
     MetroMeshGrid   gS2;
+    GridTriangleSoA<MetroMeshGrid> gS2Tri;
     MetroMeshHash   hS2;
     MetroMeshAABB   tS2;
 		MetroMeshOctree oS2;
@@ -101,6 +103,7 @@ private:
 		int referredBit                    ;
     // parameters
     double          dist_upper_bound;
+    double          dist_stop_bound;
     double					n_samples_per_area_unit;
     unsigned long   n_samples_target;
     int             Flags;
@@ -119,10 +122,30 @@ private:
 
     // globals
     int             n_samples;
+    bool            bound_exceeded;
+
+    // samples waiting for the distance evaluation, with the vertex that gets the error (if any)
+    std::vector<Point3x>       pending_pos;
+    std::vector<VertexPointer> pending_vert;
+    enum { SAMPLE_BATCH_SIZE = 1<<16 };
+    typedef tri::LocalFaceTmark<MetroMesh> MetroMeshMarker;
+
+    // distance statistics of the samples evaluated by one thread
+    struct PartialStats
+    {
+      int               first;      // index of the first sample evaluated
+      double            max_dist;
+      double            mean_dist;
+      double            RMS_dist;
+      unsigned long     n_samples;
+      Histogram<double> hist;
+    };
 
     // private methods
     inline double   ComputeMeshArea(MetroMesh & mesh);
-    float           AddSample(const Point3x &p);
+    void            AddSample(const Point3x &p, VertexPointer v=0);
+    ScalarType      ComputeDistance(const Point3x &p, MetroMeshMarker &mf);
+    void            FlushSamples();
     inline void     AddRandomSample(FaceIterator &T);
     inline void     SampleEdge(const Point3x & v0, const Point3x & v1, int n_samples_per_edge);
     void            VertexSampling();
@@ -155,6 +178,8 @@ public :
     void            SetParam(double _n_samp)    {n_samples_target = _n_samp;}
     void            SetSamplesTarget(unsigned long _n_samp);
     void            SetSamplesPerAreaUnit(double _n_samp);
+    void            SetStopBound(double _bound)  {dist_stop_bound = _bound;}
+    bool            BoundExceeded()             {return bound_exceeded;}
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -164,6 +189,8 @@ template <class MetroMesh>
 Sampling<MetroMesh>::Sampling(MetroMesh &_s1, MetroMesh &_s2):S1(_s1),S2(_s2)
 {
     Flags = 0;
+    dist_stop_bound = -1;
+    bound_exceeded = false;
     area_S1 = ComputeMeshArea(_s1);
 		// set default numbers
 		n_samples_per_face             =	10;
@@ -221,39 +248,121 @@ inline double Sampling<MetroMesh>::ComputeMeshArea(MetroMesh & mesh)
     return area/2.0;
 }
 
+// The samples are collected and their distances are computed in batches, in parallel: every search
+// structure can be queried concurrently, each thread marks the visited faces with its own marker.
+// Each thread accumulates the statistics of a contiguous range of samples; the partial results are
+// merged in sample order, so they do not depend on the thread scheduling (only the rounding of the
+// sums depends on the number of threads).
+template <class MetroMesh>
+void Sampling<MetroMesh>::AddSample(const Point3x &p, VertexPointer v)
+{
+    // once the stop bound is exceeded the remaining samples are not evaluated
+    if(bound_exceeded) return;
+    pending_pos.push_back(p);
+    pending_vert.push_back(v);
+    if(pending_pos.size() >= SAMPLE_BATCH_SIZE)
+        FlushSamples();
+}
+
 template <class MetroMesh>
-float Sampling<MetroMesh>::AddSample(const Point3x &p )
+typename Sampling<MetroMesh>::ScalarType Sampling<MetroMesh>::ComputeDistance(const Point3x &p, MetroMeshMarker &mf)
 {
     FaceType   *f=0;
-    Point3x             normf, bestq, ip;
+    Point3x             bestq;
 		ScalarType              dist;
+    const ScalarType maxd = ScalarType(dist_upper_bound);
+    face::PointDistanceEPFunctor<ScalarType> PDistFunct;
 
-    dist = dist_upper_bound;
+    dist = maxd;
 
     // compute distance between p_i and the mesh S2
     if(Flags & SamplingFlags::USE_AABB_TREE)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshAABB>(S2, tS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=tS2.GetClosest(PDistFunct, mf, p, maxd, dist, bestq);
     if(Flags & SamplingFlags::USE_HASH_GRID)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshHash>(S2, hS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=hS2.GetClosest(PDistFunct, mf, p, maxd, dist, bestq);
+    // the candidates of the static grid are ranked with the vectorized kernel, the winner with the EP distance
     if(Flags & SamplingFlags::USE_STATIC_GRID)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshGrid>(S2, gS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=GridClosestSoA(gS2, gS2Tri, PDistFunct, p, maxd, dist, bestq);
     if (Flags & SamplingFlags::USE_OCTREE)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshOctree>(S2, oS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=oS2.GetClosest(PDistFunct, mf, p, maxd, dist, bestq);
 
-    // update distance measures
-    if(dist == dist_upper_bound)
-        return -1.0;
+    if(f==0 || fabs(dist) >= maxd)
+      return maxd;
+    return ScalarType(fabs(dist));
+}
 
-    if(dist > max_dist)
-        max_dist = dist;        // L_inf
-    mean_dist += dist;	        // L_1
-    RMS_dist  += dist*dist;     // L_2
-    n_total_samples++;
+template <class MetroMesh>
+void Sampling<MetroMesh>::FlushSamples()
+{
+    const int n = int(pending_pos.size());
+    std::vector< std::pair<int, PartialStats *> > partials;
 
-    if(Flags &  SamplingFlags::HIST)
-        hist.Add((float)fabs(dist));
+#pragma omp parallel
+    {
+      // the hash grid and the octree mark the faces already tested
+      MetroMeshMarker mf;
+      if(Flags & (SamplingFlags::USE_HASH_GRID | SamplingFlags::USE_OCTREE))
+        mf.SetMesh(&S2);
+
+      PartialStats st;
+      st.first     = -1;
+      st.max_dist  = -HUGE_VAL;
+      st.mean_dist = st.RMS_dist = 0;
+      st.n_samples = 0;
+      if(Flags & SamplingFlags::HIST)
+        st.hist.SetRange(0.0, dist_upper_bound/100.0, n_hist_bins);
+
+#pragma omp for schedule(static)
+      for(int i=0; i<n; ++i)
+      {
+        if(st.first<0) st.first = i;
+        const double dist = ComputeDistance(pending_pos[i], mf);
+        float error = -1.0f;
+        // update distance measures
+        if(dist != dist_upper_bound)
+        {
+          if(dist > st.max_dist)
+              st.max_dist = dist;      // L_inf
+          st.mean_dist += dist;        // L_1
+          st.RMS_dist  += dist*dist;   // L_2
+          st.n_samples++;
+
+          if(Flags &  SamplingFlags::HIST)
+              st.hist.Add((float)fabs(dist));
+          error = (float)dist;
+        }
+        // save vertex quality
+        if(pending_vert[i] && (Flags & SamplingFlags::SAVE_ERROR))
+          pending_vert[i]->Q() = error;
+      }
+
+      if(st.first>=0)
+      {
+#pragma omp critical
+        partials.push_back(std::make_pair(st.first, &st));
+      }
+#pragma omp barrier
+#pragma omp single
+      {
+        std::sort(partials.begin(), partials.end());
+        for(size_t i=0; i<partials.size(); ++i)
+        {
+          const PartialStats &ps = *partials[i].second;
+          if(ps.max_dist > max_dist)
+              max_dist = ps.max_dist;
+          mean_dist += ps.mean_dist;
+          RMS_dist  += ps.RMS_dist;
+          n_total_samples += ps.n_samples;
+          if(Flags &  SamplingFlags::HIST)
+              hist.Merge(ps.hist);
+        }
+      }
+    }
+    pending_pos.clear();
+    pending_vert.clear();
 
-    return (float)dist;
+    if(dist_stop_bound >= 0 && max_dist > dist_stop_bound)
+      bound_exceeded = true;
 }
 
 
@@ -265,7 +374,6 @@ void Sampling<MetroMesh>::VertexSampling()
 {
     // Vertex sampling.
     int   cnt = 0;
-    float error;
 
     printf("Vertex sampling\n");
     VertexIterator vi;
@@ -274,17 +382,15 @@ void Sampling<MetroMesh>::VertexSampling()
 			if(  (*vi).IsUserBit(referredBit) || // it is referred
 					((Flags&SamplingFlags::INCLUDE_UNREFERENCED_VERTICES) != 0) ) //include also unreferred
     {
-        error = AddSample((*vi).cP());
+        AddSample((*vi).cP(), &*vi);
 
         n_total_vertex_samples++;
 
-        // save vertex quality
-        if(Flags & SamplingFlags::SAVE_ERROR)  (*vi).Q() = error;
-
         // print progress information
         if(!(++cnt % print_every_n_elements))
             printf("Sampling vertices %d%%\r", (100 * cnt/S1.vn));
     }
+    FlushSamples();
     printf("                       \r");
 }
 
@@ -349,6 +455,7 @@ void Sampling<MetroMesh>::EdgeSampling()
         if(!(++cnt % print_every_n_elements))
             printf("Sampling edge %lu%%\r", (100 * cnt/Edges.size()));
     }
+    FlushSamples();
     printf("                     \r");
 }
 
@@ -389,11 +496,12 @@ template <class MetroMesh>
 void Sampling<MetroMesh>::MontecarloFaceSampling()
 {
     // Montecarlo sampling.
+    int     cnt = 0;
     double  n_samples_decimal = 0.0;
     FaceIterator fi;
 
     srand(clock());
- //   printf("Montecarlo face sampling\n");
+    printf("Montecarlo face sampling\n");
     for(fi=S1.face.begin(); fi != S1.face.end(); fi++)
 		if(!(*fi).IsD())
     {
@@ -408,10 +516,11 @@ void Sampling<MetroMesh>::MontecarloFaceSampling()
         n_samples_decimal -= (double) n_samples;
 
         // print progress information
-//        if(!(++cnt % print_every_n_elements))
- //           printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
+        if(!(++cnt % print_every_n_elements))
+            printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
     }
- //   printf("                     \r");
+    FlushSamples();
+    printf("                     \r");
 }
 
 
@@ -487,6 +596,7 @@ void Sampling<MetroMesh>::SubdivFaceSampling()
         if(!(++cnt % print_every_n_elements))
             printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
     }
+    FlushSamples();
     printf("                     \r");
 }
 
@@ -536,6 +646,7 @@ void Sampling<MetroMesh>::SimilarFaceSampling()
         if(!(++cnt % print_every_n_elements))
             printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
     }
+    FlushSamples();
     printf("                     \r");
 }
 
@@ -552,7 +663,11 @@ void Sampling<MetroMesh>::Hausdorff()
     // set grid meshes.
     if(Flags & SamplingFlags::USE_HASH_GRID)   hS2.Set(S2.face.begin(),S2.face.end());
     if(Flags & SamplingFlags::USE_AABB_TREE)   tS2.Set(S2.face.begin(),S2.face.end());
-    if(Flags & SamplingFlags::USE_STATIC_GRID) gS2.Set(S2.face.begin(),S2.face.end());
+    if(Flags & SamplingFlags::USE_STATIC_GRID)
+    {
+      gS2.Set(S2.face.begin(),S2.face.end());
+      gS2Tri.Set(gS2);
+    }
 		if(Flags & SamplingFlags::USE_OCTREE)      oS2.Set(S2.face.begin(),S2.face.end());
 
     // set bounding box
@@ -565,6 +680,7 @@ void Sampling<MetroMesh>::Hausdorff()
     n_total_area_samples = n_total_edge_samples = n_total_vertex_samples = n_total_samples = n_samples = 0;
 		max_dist             = -HUGE_VAL;
 		mean_dist = RMS_dist = 0;
+    bound_exceeded = false;
 
     // Vertex sampling.
     if(Flags & SamplingFlags::VERTEX_SAMPLING)
@@ -26,9 +26,12 @@ SUBDIRS       = trimesh_base  \
                 trimesh_refine \
                 trimesh_sampling \
                 trimesh_smooth \
+                trimesh_soa \
                 trimesh_split_vertex \
                 trimesh_texture \
                 trimesh_topology \
+                trimesh_topology_parallel \
+                trimesh_update_parallel \
                 polygonmesh_base \
                 space_packer \
                 aabb_binary_tree
@@ -174,6 +174,23 @@ bool UnitTest_Closest(const char *filename1, int sampleNum, float dispPerc, std:
   printf("Grid Size %3i %3i %3i - ",TRGrid.siz[0],TRGrid.siz[1],TRGrid.siz[2]);
   printf("Avg dist %6.9lf - ",avgDist / float(MontecarloSamples.size()));
   printf("Grid Query %6.3f \n", float(endGridQuery-startGridQuery)/CLOCKS_PER_SEC);
+
+  // The same queries issued as a single (multithreaded) batch must give the same faces.
+  if(!useEdge && useWrap)
+  {
+    std::vector<FaceType *> faceVec;
+    std::vector<ScalarType> distVec;
+    std::vector<CoordType> closestVec;
+    struct timeb startBatch,endBatch;
+    ftime(&startBatch);
+    tri::GetClosestFaceBaseBatch(mr,TRGrid,MontecarloSamples,maxDist,faceVec,distVec,closestVec);
+    ftime(&endBatch);
+    int diffNum=0;
+    for(size_t i=0;i<MontecarloSamples.size();++i)
+      if(faceVec[i] && resultVec[i]!=int(tri::Index(mr,faceVec[i]))) ++diffNum;
+    printf("Batch Query %6.3f (wall clock) - %i different results\n",
+           float(endBatch.time-startBatch.time)+float(endBatch.millitm-startBatch.millitm)/1000.0f,diffNum);
+  }
   return true;
 }
 
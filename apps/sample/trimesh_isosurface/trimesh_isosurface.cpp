@@ -25,7 +25,10 @@
 #include <vcg/complex/algorithms/create/marching_cubes.h>
 #include <vcg/complex/algorithms/create/extended_marching_cubes.h>
 #include <vcg/complex/algorithms/create/mc_trivial_walker.h>
+#include <vcg/complex/algorithms/create/mc_streaming_walker.h>
+#include <vcg/complex/algorithms/create/mc_parallel_walker.h>
 #include <wrap/io_trimesh/export_ply.h>
+#include <wrap/io_trimesh/export_ply_stream.h>
 
 using namespace std;
 using namespace vcg;
@@ -47,8 +50,35 @@ class MyMesh		: public vcg::tri::TriMesh< std::vector< MyVertex>, std::vector< M
 
 typedef SimpleVolume<SimpleVoxel> MyVolume;
 
-int main(int /*argc*/ , char **/*argv*/)
+// Out of core extraction of a raw volume of unsigned char, streamed to a ply
+int StreamRawVolume(const char *filename, Point3i size, float threshold)
 {
+  typedef RawVolumeSlabReader<unsigned char> MySource;
+  typedef vcg::tri::StreamingWalker<MyMesh,MySource> MyStreamingWalker;
+  typedef vcg::tri::MarchingCubes<MyMesh, MyStreamingWalker> MyStreamingMarchingCubes;
+  MySource source;
+  if(!source.Open(filename,size))
+  {
+    printf("Error reading file %s\n",filename);
+    return -1;
+  }
+  vcg::tri::io::PlyStreamWriter out;
+  out.Open("marching_cubes_stream.ply");
+  MyMesh buffer;
+  MyStreamingWalker walker;
+  MyStreamingMarchingCubes mc(buffer, walker);
+  walker.BuildMesh(buffer, source, mc, out, threshold);
+  printf("Streamed %i vertices and %i faces\n",out.VN(),out.FN());
+  return out.Close();
+}
+
+int main(int argc , char **argv)
+{
+  if(argc>=5)
+  {
+    return StreamRawVolume(argv[1],Point3i(atoi(argv[2]),atoi(argv[3]),atoi(argv[4])),argc>5 ? atof(argv[5]) : 128);
+  }
+
     MyVolume	volume;
 
   typedef vcg::tri::TrivialWalker<MyMesh,MyVolume>	MyWalker;
@@ -72,4 +102,30 @@ int main(int /*argc*/ , char **/*argv*/)
 	vcg::tri::io::ExporterPLY<MyMesh>::Save( mc_mesh, "marching_cubes.ply");
 
 	printf("OK!\n");
+
+	// The same extraction, with the volume split in blocks of slices processed by different threads
+	typedef vcg::tri::ParallelWalker<MyMesh,MyVolume> MyParallelWalker;
+	typedef vcg::tri::MarchingCubes<MyMesh, MyParallelWalker> MyParallelMarchingCubes;
+	MyMesh pmc_mesh;
+	MyParallelWalker parallelWalker;
+	MyParallelMarchingCubes pmc(pmc_mesh, parallelWalker);
+	printf("[MARCHING CUBES] Building mesh in parallel...");
+	parallelWalker.BuildMesh<MyParallelMarchingCubes>(pmc_mesh, volume, pmc, 20*20);
+	vcg::tri::io::ExporterPLY<MyMesh>::Save( pmc_mesh, "marching_cubes_parallel.ply");
+	printf("OK!\n");
+
+	// The same extraction, streaming the volume one slice at a time and the mesh directly to the file
+	typedef VolumeSlabSource<MyVolume> MySource;
+	typedef vcg::tri::StreamingWalker<MyMesh,MySource> MyStreamingWalker;
+	typedef vcg::tri::MarchingCubes<MyMesh, MyStreamingWalker> MyStreamingMarchingCubes;
+	MySource source(volume);
+	MyMesh buffer;
+	MyStreamingWalker streamingWalker;
+	MyStreamingMarchingCubes smc(buffer, streamingWalker);
+	vcg::tri::io::PlyStreamWriter out;
+	printf("[MARCHING CUBES] Streaming mesh...");
+	out.Open("marching_cubes_stream.ply");
+	streamingWalker.BuildMesh(buffer, source, smc, out, 20*20);
+	out.Close();
+	printf("OK!\n");
 };
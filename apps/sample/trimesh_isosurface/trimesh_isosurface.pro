@@ -1,3 +1,7 @@
 include(../common.pri)
 TARGET = trimesh_isosurface
 SOURCES += trimesh_isosurface.cpp ../../../wrap/ply/plylib.cpp
+# OpenMP is used by the ParallelWalker
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
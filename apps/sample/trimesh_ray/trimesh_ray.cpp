@@ -15,6 +15,7 @@ using namespace std;
 #include <vcg/complex/algorithms/intersection.h>
 #include <vcg/space/index/grid_static_ptr.h>
 #include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/bvh.h>
 #include <vcg/complex/algorithms/closest.h>
 
 // VCG File Format Importer/Exporter
@@ -38,9 +39,10 @@ class MyFace    : public Face  <MyUsedTypes, face::VertexRef,face::BitFlags,face
 
 class MyMesh : public tri::TriMesh< vector<MyVertex>, vector<MyFace > >{};
 
-// Uncomment only one of the two following lines to test different data structures
+// Uncomment only one of the following lines to test different data structures
 typedef vcg::GridStaticPtr<MyMesh::FaceType, MyMesh::ScalarType> TriMeshGrid;
 //typedef vcg::SpatialHashTable<MyMesh::FaceType, MyMesh::ScalarType> TriMeshGrid;
+//typedef vcg::BVHIndex<MyMesh::FaceType, MyMesh::ScalarType> TriMeshGrid;
 
 int main(int argc,char ** argv)
 {
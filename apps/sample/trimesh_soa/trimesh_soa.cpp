@@ -0,0 +1,100 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2012                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_soa.cpp
+\ingroup code_sample
+
+\brief An example of a mesh whose vertex data is stored as a structure of arrays
+
+The vertex container vertex::vector_soa stores the data of the Soa components
+(Coord3fSoa, Normal3fSoa, BitFlagsSoa, ...) in separate contiguous arrays, while
+the vertices keep the usual accessors. This sample runs the same algorithms on
+a standard mesh and on a SoA mesh, checks that the results are equal and
+prints the times.
+*/
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/smooth.h>
+#include <wrap/io_trimesh/import.h>
+
+using namespace vcg;
+using namespace std;
+
+class MyFace; class MyVertex;
+class MyFaceSoa; class MyVertexSoa;
+struct MyUsedTypes    : public UsedTypes<Use<MyVertex>::AsVertexType,    Use<MyFace>::AsFaceType>{};
+struct MyUsedTypesSoa : public UsedTypes<Use<MyVertexSoa>::AsVertexType, Use<MyFaceSoa>::AsFaceType>{};
+
+class MyVertex    : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::Color4b, vertex::Qualityf, vertex::BitFlags, vertex::Mark>{};
+class MyVertexSoa : public Vertex<MyUsedTypesSoa, vertex::InfoSoa, vertex::Coord3fSoa, vertex::Normal3fSoa, vertex::Color4b, vertex::Qualityf, vertex::BitFlagsSoa, vertex::Mark>{};
+class MyFace      : public Face<MyUsedTypes,    face::VertexRef, face::Normal3f, face::FFAdj, face::BitFlags>{};
+class MyFaceSoa   : public Face<MyUsedTypesSoa, face::VertexRef, face::Normal3f, face::FFAdj, face::BitFlags>{};
+
+class MyMesh    : public tri::TriMesh< vector<MyVertex>,               vector<MyFace> > {};
+class MyMeshSoa : public tri::TriMesh< vertex::vector_soa<MyVertexSoa>, vector<MyFaceSoa> > {};
+
+template <class MeshType>
+float Run(MeshType &m, int iter)
+{
+  clock_t t0=clock();
+  for(int i=0;i<iter;++i)
+  {
+    tri::UpdateBounding<MeshType>::Box(m);
+    tri::UpdateNormal<MeshType>::PerVertexNormalized(m);
+  }
+  tri::Smooth<MeshType>::VertexCoordLaplacian(m,iter);
+  return float(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+int main( int argc, char **argv )
+{
+  MyMesh m;
+  MyMeshSoa ms;
+  if(argc>1)
+  {
+    if(tri::io::Importer<MyMesh>::Open(m,argv[1])!=0 || tri::io::Importer<MyMeshSoa>::Open(ms,argv[1])!=0)
+    {
+      printf("Error reading file  %s\n",argv[1]);
+      exit(0);
+    }
+  }
+  else
+  {
+    tri::Sphere(m,7);
+    tri::Sphere(ms,7);
+  }
+  printf("Mesh has %i vertices and %i faces\n",m.VN(),m.FN());
+
+  float t=Run(m,10);
+  float ts=Run(ms,10);
+
+  int diff=0;
+  for(int i=0;i<m.VN();++i)
+    if(m.vert[i].P()!=ms.vert[i].P() || m.vert[i].N()!=ms.vert[i].N()) ++diff;
+  printf("Bounding box, normals and laplacian smoothing: %5.3f sec (AoS) %5.3f sec (SoA), %i different vertices\n",t,ts,diff);
+
+  return 0;
+}
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = trimesh_soa
+SOURCES += trimesh_soa.cpp ../../../wrap/ply/plylib.cpp
@@ -0,0 +1,126 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2012                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_topology_parallel.cpp
+\ingroup code_sample
+
+\brief Timing of the bucketed topology builders against the sort based ones
+
+FF and VF adjacency and the unique edge vector are computed with the standard
+sort based functions and with the bucketed (and multithreaded, when OpenMP is enabled)
+ones; the times are printed together with the number of differences.
+Without a mesh, a 10M faces grid is generated.
+*/
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <wrap/io_trimesh/import.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+using namespace std;
+
+class MyFace; class MyVertex;
+struct MyUsedTypes : public UsedTypes<Use<MyVertex>::AsVertexType, Use<MyFace>::AsFaceType>{};
+
+class MyVertex : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::VFAdj, vertex::BitFlags>{};
+class MyFace   : public Face<MyUsedTypes, face::VertexRef, face::FFAdj, face::VFAdj, face::BitFlags>{};
+class MyMesh   : public tri::TriMesh< vector<MyVertex>, vector<MyFace> > {};
+
+typedef tri::UpdateTopology<MyMesh> Topo;
+typedef pair<MyFace *,int> Adj;
+
+double Now()
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+int main( int argc, char **argv )
+{
+  MyMesh m;
+  if(argc>1)
+  {
+    if(tri::io::Importer<MyMesh>::Open(m,argv[1])!=0)
+    {
+      printf("Error reading file  %s\n",argv[1]);
+      exit(0);
+    }
+  }
+  else
+    tri::Grid(m,2237,2237,1.0f,1.0f); // (2237-1)^2*2 ~ 10M faces
+  printf("Mesh has %i vertices and %i faces\n",m.VN(),m.FN());
+
+  // Face-Face
+  double t0=Now();
+  Topo::FaceFace(m);
+  double t1=Now();
+  vector<Adj> ff(m.face.size()*3);
+  for(size_t i=0;i<m.face.size();++i)
+    for(int j=0;j<3;++j) ff[i*3+j]=Adj(m.face[i].FFp(j),m.face[i].FFi(j));
+  double t2=Now();
+  Topo::FaceFaceBucketed(m);
+  double t3=Now();
+  int diff=0;
+  for(size_t i=0;i<m.face.size();++i)
+    for(int j=0;j<3;++j)
+      if(ff[i*3+j]!=Adj(m.face[i].FFp(j),m.face[i].FFi(j))) ++diff;
+  printf("FaceFace             %7.3f sec (sort) %7.3f sec (buckets), %i differences\n",t1-t0,t3-t2,diff);
+
+  // Vertex-Face
+  t0=Now();
+  Topo::VertexFace(m);
+  t1=Now();
+  vector<Adj> vf(m.vert.size()+m.face.size()*3);
+  for(size_t i=0;i<m.vert.size();++i) vf[i]=Adj(m.vert[i].VFp(),m.vert[i].VFi());
+  for(size_t i=0;i<m.face.size();++i)
+    for(int j=0;j<3;++j) vf[m.vert.size()+i*3+j]=Adj(m.face[i].VFp(j),m.face[i].VFi(j));
+  t2=Now();
+  Topo::VertexFaceParallel(m);
+  t3=Now();
+  diff=0;
+  for(size_t i=0;i<m.vert.size();++i)
+    if(vf[i]!=Adj(m.vert[i].VFp(),m.vert[i].VFi())) ++diff;
+  for(size_t i=0;i<m.face.size();++i)
+    for(int j=0;j<3;++j)
+      if(vf[m.vert.size()+i*3+j]!=Adj(m.face[i].VFp(j),m.face[i].VFi(j))) ++diff;
+  printf("VertexFace           %7.3f sec (serial) %7.3f sec (parallel), %i differences\n",t1-t0,t3-t2,diff);
+
+  // Unique edges
+  vector<Topo::PEdge> e0,e1;
+  t0=Now();
+  Topo::FillUniqueEdgeVector(m,e0);
+  t1=Now();
+  Topo::FillUniqueEdgeVectorBucketed(m,e1);
+  t2=Now();
+  diff=int(max(e0.size(),e1.size())-min(e0.size(),e1.size()));
+  for(size_t i=0;i<min(e0.size(),e1.size());++i)
+    if(!(e0[i]==e1[i])) ++diff;
+  printf("FillUniqueEdgeVector %7.3f sec (sort) %7.3f sec (buckets), %i differences\n",t1-t0,t2-t1,diff);
+  return 0;
+}
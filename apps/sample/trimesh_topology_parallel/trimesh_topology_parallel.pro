@@ -0,0 +1,7 @@
+include(../common.pri)
+TARGET = trimesh_topology_parallel
+SOURCES += trimesh_topology_parallel.cpp ../../../wrap/ply/plylib.cpp
+# OpenMP is used by the bucketed topology builders
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
@@ -0,0 +1,141 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2012                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file trimesh_update_parallel.cpp
+\ingroup code_sample
+
+\brief Timing of the multithreaded normal and bounding box updates
+
+Per vertex normals, per face normals and the bounding box are computed with one
+thread and with all the available threads, the times are printed together with
+the largest difference between the two sets of normals.
+Without a mesh, a 10M faces height field is generated.
+Compile with OpenMP enabled to get the multithreaded versions.
+*/
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <wrap/io_trimesh/import.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+using namespace std;
+
+class MyFace; class MyVertex;
+struct MyUsedTypes : public UsedTypes<Use<MyVertex>::AsVertexType, Use<MyFace>::AsFaceType>{};
+
+class MyVertex : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::BitFlags>{};
+class MyFace   : public Face<MyUsedTypes, face::VertexRef, face::Normal3f, face::BitFlags>{};
+class MyMesh   : public tri::TriMesh< vector<MyVertex>, vector<MyFace> > {};
+
+double Now()
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+void SetThreads(int n)
+{
+#ifdef _OPENMP
+  omp_set_num_threads(n);
+#else
+  (void)n;
+#endif
+}
+
+int MaxThreads()
+{
+#ifdef _OPENMP
+  return omp_get_num_procs();
+#else
+  return 1;
+#endif
+}
+
+/// Time of each update, averaged over iter runs.
+void Run(MyMesh &m, int iter, double t[4])
+{
+  double t0=Now();
+  for(int i=0;i<iter;++i) tri::UpdateNormal<MyMesh>::PerVertexNormalized(m);
+  double t1=Now();
+  for(int i=0;i<iter;++i) tri::UpdateNormal<MyMesh>::PerVertexAngleWeighted(m);
+  double t2=Now();
+  for(int i=0;i<iter;++i) tri::UpdateNormal<MyMesh>::PerFaceNormalized(m);
+  double t3=Now();
+  for(int i=0;i<iter;++i) tri::UpdateBounding<MyMesh>::Box(m);
+  double t4=Now();
+  t[0]=(t1-t0)/iter; t[1]=(t2-t1)/iter; t[2]=(t3-t2)/iter; t[3]=(t4-t3)/iter;
+}
+
+int main( int argc, char **argv )
+{
+  MyMesh m;
+  if(argc>1)
+  {
+    if(tri::io::Importer<MyMesh>::Open(m,argv[1])!=0)
+    {
+      printf("Error reading file  %s\n",argv[1]);
+      exit(0);
+    }
+  }
+  else
+  {
+    const int side=2237; // (side-1)^2*2 ~ 10M faces
+    vector<float> height(side*side);
+    for(int i=0;i<side;++i)
+      for(int j=0;j<side;++j)
+        height[i*side+j]=0.05f*sin(i*0.05f)*cos(j*0.07f);
+    tri::Grid(m,side,side,1.0f,1.0f,&height[0]);
+  }
+  printf("Mesh has %i vertices and %i faces\n",m.VN(),m.FN());
+
+  const int iter=5;
+  const char *name[4]={"PerVertexNormalized","PerVertexAngleWeighted","PerFaceNormalized","Box"};
+  double ts[4],tp[4];
+
+  SetThreads(1);
+  Run(m,iter,ts);
+  vector<Point3f> serialN(m.vert.size());
+  tri::UpdateNormal<MyMesh>::PerVertexNormalized(m);
+  for(size_t i=0;i<m.vert.size();++i) serialN[i]=m.vert[i].N();
+  Box3f serialBox=m.bbox;
+
+  const int threads=MaxThreads();
+  SetThreads(threads);
+  Run(m,iter,tp);
+  tri::UpdateNormal<MyMesh>::PerVertexNormalized(m);
+  float maxDiff=0;
+  for(size_t i=0;i<m.vert.size();++i)
+    maxDiff=max(maxDiff,Distance(serialN[i],m.vert[i].N()));
+
+  for(int k=0;k<4;++k)
+    printf("%-24s %7.4f sec (1 thread) %7.4f sec (%i threads) speedup %4.2f\n",name[k],ts[k],tp[k],threads,ts[k]/tp[k]);
+  printf("Max normal difference %g, same box %s\n",maxDiff,serialBox==m.bbox?"yes":"no");
+  return 0;
+}
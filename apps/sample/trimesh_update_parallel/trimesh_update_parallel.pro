@@ -0,0 +1,7 @@
+include(../common.pri)
+TARGET = trimesh_update_parallel
+SOURCES += trimesh_update_parallel.cpp ../../../wrap/ply/plylib.cpp
+# OpenMP is used by the multithreaded updates
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
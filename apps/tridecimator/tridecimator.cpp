@@ -4,11 +4,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 // stuff to define the mesh
-#include <vcg/simplex/vertex/base.h>
-#include <vcg/simplex/face/base.h>
-#include <vcg/simplex/edge/base.h>
 #include <vcg/complex/complex.h>
 
 #include <vcg/math/quadric.h>
@@ -82,6 +85,24 @@ class MyTriEdgeCollapse: public vcg::tri::TriEdgeCollapseQuadric< MyMesh, Vertex
             inline MyTriEdgeCollapse(  const VertexPair &p, int i, BaseParameterClass *pp) :TECQ(p,i,pp){}
 };
 
+// Peak memory used by the process in MB
+double PeakMemoryMB()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if(GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc))) return pmc.PeakWorkingSetSize/(1024.0*1024.0);
+  return 0;
+#else
+  struct rusage ru;
+  getrusage(RUSAGE_SELF,&ru);
+#ifdef __APPLE__
+  return ru.ru_maxrss/(1024.0*1024.0); // bytes
+#else
+  return ru.ru_maxrss/1024.0; // kilobytes
+#endif
+#endif
+}
+
 void Usage()
 {
   	printf(
@@ -110,6 +131,8 @@ void Usage()
 			"     -T[y|n]  Preserve or not Topology (default no)\n"
 			"     -H[y|n]  Use or not Safe Heap Update (default no)\n"
 		  "     -P       Before simplification, remove duplicate & unreferenced vertices\n"
+		  "     -j#      Batched (multithreaded) simplification, # independent collapses per step (default 0, no batching)\n"
+		  "     -I[y|n]  Use or not the addressable heap (default no)\n"
                                        );
   exit(-1);
 }
@@ -134,6 +157,7 @@ if(argc<4) Usage();
   qparams.QualityThr  =.3;
   float TargetError=std::numeric_limits<float>::max();
   bool CleaningFlag =false;
+  int BatchSize=0;
      // parse command line.
     for(int i=4; i < argc;)
     {
@@ -141,6 +165,8 @@ if(argc<4) Usage();
         switch(argv[i][1])
       {
         case 'H' : qparams.SafeHeapUpdate=true; printf("Using Safe heap option\n"); break;
+        case 'I' : if(argv[i][2]=='y') { qparams.AddressableHeap	= true;  printf("Using Addressable Heap\n");	}
+                                  else { qparams.AddressableHeap	= false; printf("NOT Using Addressable Heap\n");	}        break;
         case 'Q' : if(argv[i][2]=='y') { qparams.QualityCheck	= true;  printf("Using Quality Checking\n");	}
                                   else { qparams.QualityCheck	= false; printf("NOT Using Quality Checking\n");	}                break;
         case 'N' : if(argv[i][2]=='y') { qparams.NormalCheck	= true;  printf("Using Normal Deviation Checking\n");	}
@@ -158,6 +184,7 @@ if(argc<4) Usage();
         case 'b' :	qparams.BoundaryWeight  = atof(argv[i]+2);			printf("Setting Boundary Weight to %f\n",atof(argv[i]+2)); break;
         case 'e' :	TargetError = float(atof(argv[i]+2));			printf("Setting TargetError to %g\n",atof(argv[i]+2)); break;
         case 'P' :	CleaningFlag=true;  printf("Cleaning mesh before simplification\n"); break;
+        case 'j' :	BatchSize = atoi(argv[i]+2);  printf("Using batches of %i collapses\n",BatchSize); break;
 
         default  :  printf("Unknown option '%s'\n", argv[i]);
           exit(0);
@@ -181,6 +208,7 @@ if(argc<4) Usage();
   // decimator initialization
   vcg::LocalOptimization<MyMesh> DeciSession(mesh,&qparams);
 	
+  MyTriEdgeCollapse::FailStat::Init();
   int t1=clock();
   DeciSession.Init<MyTriEdgeCollapse>();
   int t2=clock();
@@ -188,14 +216,26 @@ if(argc<4) Usage();
 
   DeciSession.SetTargetSimplices(FinalSize);
   DeciSession.SetTimeBudget(0.5f);
+  DeciSession.SetBatchSize(BatchSize);
   if(TargetError< std::numeric_limits<float>::max() ) DeciSession.SetTargetMetric(TargetError);
 
+  size_t MaxHeapSize=DeciSession.h.size();
+  int TotalOps=0;
   while(DeciSession.DoOptimization() && mesh.fn>FinalSize && DeciSession.currMetric < TargetError)
+  {
+    TotalOps+=DeciSession.nPerfmormedOps;
+    MaxHeapSize=std::max(MaxHeapSize,DeciSession.h.size());
     printf("Current Mesh size %7i heap sz %9i err %9g \r",mesh.fn, int(DeciSession.h.size()),DeciSession.currMetric);
+  }
+  TotalOps+=DeciSession.nPerfmormedOps;
+  DeciSession.Finalize<MyTriEdgeCollapse>();
 
   int t3=clock();
   printf("mesh  %d %d Error %g \n",mesh.vn,mesh.fn,DeciSession.currMetric);
   printf("\nCompleted in (%i+%i) msec\n",t2-t1,t3-t2);
+  printf("%i collapses, %.0f collapses/sec, %i out of date collapses popped\n",TotalOps,
+         TotalOps/(std::max(1,t3-t2)/double(CLOCKS_PER_SEC)),MyTriEdgeCollapse::FailStat::OutOfDate());
+  printf("Max heap size %i, peak memory %.1f MB\n",int(MaxHeapSize),PeakMemoryMB());
 	
   vcg::tri::io::ExporterPLY<MyMesh>::Save(mesh,argv[2]);
 	return 0;
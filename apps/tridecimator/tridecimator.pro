@@ -10,3 +10,7 @@ SOURCES += tridecimator.cpp ../../wrap/ply/plylib.cpp
 
 # Mac specific Config required to avoid to make application bundles
 CONFIG -= app_bundle
+# OpenMP is used by the batched simplification (-j option)
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:QMAKE_LFLAGS += -fopenmp
+win32-msvc*:QMAKE_CXXFLAGS += /openmp
@@ -0,0 +1,283 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_BOUNDED_HAUSDORFF
+#define __VCG_BOUNDED_HAUSDORFF
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <vcg/space/box3.h>
+#include <vcg/simplex/face/distance.h>
+#include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
+#include <vcg/complex/algorithms/update/normal.h>
+
+namespace vcg {
+namespace tri {
+
+/** Hausdorff distance between two meshes with a guaranteed absolute error.
+
+The one-sided distance h(A,B) (the max over the points of A of their distance from B) is found
+by branch and bound on two hierarchies: the faces of B are kept in an AABBBinaryTreeIndex, that
+answers the closest point queries, while the faces of A are adaptively split in four.
+Every piece of A has an upper bound of the distance of all its points from B:
+the distance from a single triangle of B is convex, so over the piece it is at most the one of
+its worst corner (this is tried with the closest faces of the corners), and moreover a point is
+no farther from B than a corner plus its distance from that corner (and no corner is farther
+than the circumradius).
+The distance of every queried point is a lower bound of h(A,B); the piece with the greatest
+upper bound is split until no piece can be more than maxErr above the lower bound, so the
+pieces far from the maximum are discarded without being refined.
+\code
+tri::BoundedHausdorff<MyMesh> bh;
+bh.Init(b);                        // hierarchy of the target mesh
+float h = bh.Compute(a, maxErr);   // h <= h(A,B) <= bh.Upper() <= h+maxErr
+\endcode
+The deleted faces and vertices of both meshes are skipped; the unreferenced vertices of A are
+queried too. maxErr is clamped to 1e-5 times the diagonal of the two meshes (the pieces cannot
+be split below the float precision); MaxErr() is the tolerance actually used.
+The search is serial, the pieces are refined one at a time from a priority queue; the closest point
+queries do not write into the AABB tree, so different objects can run Compute() concurrently.
+*/
+template <class MeshType>
+class BoundedHausdorff
+{
+public:
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef typename MeshType::CoordType CoordType;
+  typedef typename MeshType::FaceType FaceType;
+  typedef typename MeshType::FacePointer FacePointer;
+  typedef typename MeshType::FaceIterator FaceIterator;
+  typedef typename MeshType::VertexIterator VertexIterator;
+  typedef AABBBinaryTreeIndex<FaceType, ScalarType, vcg::EmptyClass> IndexType;
+
+  BoundedHausdorff():lower(0),upper(0),maxErr(0),queryNum(0),pieceNum(0) {}
+
+  /// Build the hierarchy of the target mesh B, that must not change until the last Compute().
+  /// The face normals of B are recomputed (normalized), the distance functions need them.
+  void Init(MeshType &b)
+  {
+    UpdateNormal<MeshType>::PerFaceNormalized(b);
+    targetBox.SetNull();
+    std::vector<FacePointer> faces;
+    faces.reserve(b.fn);
+    for(FaceIterator fi=b.face.begin();fi!=b.face.end();++fi)
+      if(!(*fi).IsD())
+      {
+        faces.push_back(&*fi);
+        for(int i=0;i<3;++i) targetBox.Add((*fi).cP(i));
+      }
+    index.Set(faces.begin(),faces.end());
+  }
+
+  /// One-sided Hausdorff distance h(A,B) from the mesh A to the target mesh of Init().
+  /// Returns a lower bound (the distance of MaxPoint()) that is at most maxErr below
+  /// the true value; Upper() is the corresponding upper bound.
+  ScalarType Compute(MeshType &a, ScalarType _maxErr)
+  {
+    lower=upper=0;
+    maxErr=_maxErr;
+    queryNum=pieceNum=0;
+    if(targetBox.IsNull()) return 0;
+
+    // the pieces cannot be split below the float precision
+    Box3<ScalarType> bb=targetBox;
+    for(VertexIterator vi=a.vert.begin();vi!=a.vert.end();++vi)
+      if(!(*vi).IsD()) bb.Add((*vi).cP());
+    maxErr=std::max(maxErr,bb.Diag()*ScalarType(1e-5));
+
+    std::vector<ScalarType> vd(a.vert.size(),0);
+    std::vector<FacePointer> vf(a.vert.size(),(FacePointer)0);
+    for(VertexIterator vi=a.vert.begin();vi!=a.vert.end();++vi)
+      if(!(*vi).IsD())
+      {
+        const size_t i=vi-a.vert.begin();
+        Query((*vi).cP(),vd[i],vf[i]);
+      }
+
+    // every face of A is a piece; the discarded ones are at most maxErr above the lower bound
+    // of when they are discarded, that can only grow
+    ScalarType discarded=0;
+    std::vector<Piece> heap;
+    for(FaceIterator fi=a.face.begin();fi!=a.face.end();++fi)
+      if(!(*fi).IsD())
+      {
+        Piece pc;
+        for(int i=0;i<3;++i)
+        {
+          const size_t vi=(*fi).cV(i)-&*a.vert.begin();
+          pc.p[i]=(*fi).cP(i);
+          pc.d[i]=vd[vi];
+          pc.f[i]=vf[vi];
+        }
+        pc.best=pc.f[0];
+        Push(heap,pc,discarded);
+      }
+
+    while(!heap.empty() && heap.front().u>lower+maxErr)
+    {
+      std::pop_heap(heap.begin(),heap.end());
+      const Piece pc=heap.back();
+      heap.pop_back();
+      ++pieceNum;
+
+      // split in four at the midpoints of the edges
+      CoordType mp[3];
+      ScalarType md[3];
+      FacePointer mf[3];
+      for(int i=0;i<3;++i)
+      {
+        mp[i]=(pc.p[i]+pc.p[(i+1)%3])/ScalarType(2);
+        Query(mp[i],md[i],mf[i]);
+      }
+      for(int i=0;i<3;++i)
+      {
+        // corner i, midpoint of the edge i, midpoint of the edge before
+        const int j=(i+2)%3;
+        Piece ch;
+        ch.p[0]=pc.p[i]; ch.d[0]=pc.d[i]; ch.f[0]=pc.f[i];
+        ch.p[1]=mp[i];   ch.d[1]=md[i];   ch.f[1]=mf[i];
+        ch.p[2]=mp[j];   ch.d[2]=md[j];   ch.f[2]=mf[j];
+        ch.best=pc.best;
+        Push(heap,ch,discarded);
+      }
+      Piece ch;
+      for(int i=0;i<3;++i) { ch.p[i]=mp[i]; ch.d[i]=md[i]; ch.f[i]=mf[i]; }
+      ch.best=pc.best;
+      Push(heap,ch,discarded);
+    }
+
+    upper=std::max(lower,discarded);
+    if(!heap.empty()) upper=std::max(upper,heap.front().u);
+    return lower;
+  }
+
+  /// Symmetric Hausdorff distance max(h(A,B),h(B,A)) with at most maxErr of absolute error;
+  /// returns the lower bound and sets the upper one.
+  static ScalarType Symmetric(MeshType &a, MeshType &b, ScalarType maxErr, ScalarType &upperBound)
+  {
+    BoundedHausdorff ab, ba;
+    ab.Init(b);
+    ab.Compute(a,maxErr);
+    ba.Init(a);
+    ba.Compute(b,maxErr);
+    upperBound=std::max(ab.Upper(),ba.Upper());
+    return std::max(ab.Lower(),ba.Lower());
+  }
+
+  ScalarType Lower() const { return lower; }
+  ScalarType Upper() const { return upper; }
+  /// Error bound used by the last Compute(), the requested one clamped to the float precision
+  ScalarType MaxErr() const { return maxErr; }
+  /// Point of A at distance Lower() from B
+  const CoordType &MaxPoint() const { return maxPoint; }
+  /// Closest point queries done by the last Compute()
+  int QueryNum() const { return queryNum; }
+  /// Pieces split by the last Compute()
+  int PieceNum() const { return pieceNum; }
+
+protected:
+  struct Piece
+  {
+    CoordType p[3];
+    ScalarType d[3];
+    FacePointer f[3];
+    FacePointer best;   // the face of B that gives the upper bound
+    ScalarType u;
+    bool operator<(const Piece &o) const { return u<o.u; }
+  };
+
+  void Query(const CoordType &p, ScalarType &dist, FacePointer &f)
+  {
+    face::PointDistanceBaseFunctor<ScalarType> pdf;
+    vcg::EmptyClass marker;
+    const ScalarType maxDist=Distance(p,targetBox.Center())+targetBox.Diag();
+    CoordType closest;
+    dist=maxDist;
+    f=index.GetClosest(pdf,marker,p,maxDist,dist,closest);
+    ++queryNum;
+    if(f!=0 && dist>lower)
+    {
+      lower=dist;
+      maxPoint=p;
+    }
+  }
+
+  /// Upper bound of the distance from B of the points of the piece
+  static void UpperBound(Piece &pc)
+  {
+    // a point of the piece is no farther than a corner plus their distance
+    pc.u=std::numeric_limits<ScalarType>::max();
+    for(int i=0;i<3;++i)
+    {
+      const ScalarType e=std::max(Distance(pc.p[i],pc.p[(i+1)%3]),Distance(pc.p[i],pc.p[(i+2)%3]));
+      pc.u=std::min(pc.u,pc.d[i]+e);
+    }
+    // and every point is within the circumradius from a corner
+    const ScalarType a=Distance(pc.p[0],pc.p[1]), b=Distance(pc.p[1],pc.p[2]), c=Distance(pc.p[2],pc.p[0]);
+    const ScalarType area2=((pc.p[1]-pc.p[0])^(pc.p[2]-pc.p[0])).Norm();
+    if(area2>0)
+      pc.u=std::min(pc.u,std::max(pc.d[0],std::max(pc.d[1],pc.d[2]))+a*b*c/(2*area2));
+    // the distance from a face is convex, so over the piece it is at most the one of a corner
+    FacePointer cand[4]={pc.best,pc.f[0],pc.f[1],pc.f[2]};
+    for(int c=0;c<4;++c)
+    {
+      if(cand[c]==0 || std::find(cand,cand+c,cand[c])!=cand+c) continue;
+      ScalarType worst=0;
+      int i;
+      for(i=0;i<3;++i)
+      {
+        ScalarType dist=pc.u;
+        CoordType closest;
+        if(!face::PointDistanceBase(*cand[c],pc.p[i],dist,closest)) break;
+        worst=std::max(worst,dist);
+      }
+      if(i==3 && worst<pc.u)
+      {
+        pc.u=worst;
+        pc.best=cand[c];
+      }
+    }
+  }
+
+  void Push(std::vector<Piece> &heap, Piece &pc, ScalarType &discarded)
+  {
+    UpperBound(pc);
+    if(pc.u<=lower+maxErr)
+      discarded=std::max(discarded,pc.u);
+    else
+    {
+      heap.push_back(pc);
+      std::push_heap(heap.begin(),heap.end());
+    }
+  }
+
+  IndexType index;
+  Box3<ScalarType> targetBox;
+  ScalarType lower, upper, maxErr;
+  CoordType maxPoint;
+  int queryNum, pieceNum;
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif
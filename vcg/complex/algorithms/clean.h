@@ -37,6 +37,7 @@
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/index/grid_static_ptr.h>
 #include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/bvh.h>
 #include <vcg/complex/allocate.h>
 #include <vcg/complex/algorithms/update/selection.h>
 #include <vcg/complex/algorithms/update/flag.h>
@@ -137,15 +138,55 @@ private:
 			//vcg::face::Pos<FaceType> he;
 			//vcg::face::Pos<FaceType> hei;
 
-			/* classe di confronto per l'algoritmo di eliminazione vertici duplicati*/
-			class RemoveDuplicateVert_Compare{
+			/// Vertex position and index, sorted by position and then by index (used by RemoveDuplicateVertex)
+			class SortedVert
+			{
 			public:
-				inline bool operator()(VertexPointer const &a, VertexPointer const &b)
+				Point3x p;
+				int i;
+				inline bool operator < (const SortedVert &o) const
 				{
-					return (*a).cP() < (*b).cP();
+					return (p!=o.p) ? (p<o.p) : (i<o.i);
 				}
 			};
 
+			/// Vertex grid cell and index, sorted by cell and then by index (used by WeldRemap)
+			class CellVert
+			{
+			public:
+				Point3i c;
+				int i;
+				inline bool operator < (const CellVert &o) const
+				{
+					return (c!=o.c) ? (c<o.c) : (i<o.i);
+				}
+			};
+
+			/// Sort a range in parallel: blocks of the range are sorted independently and then merged pairwise.
+			/// The result is the same of std::sort for any number of threads.
+			template <class RandomIterator>
+			static void ParallelSort(RandomIterator first, RandomIterator last)
+			{
+				const int n=int(last-first);
+				const int blockNum=16;
+				if(n<blockNum*4096)
+				{
+					std::sort(first,last);
+					return;
+				}
+				std::vector<int> bound(blockNum+1);
+				for(int b=0;b<=blockNum;++b)
+					bound[b]=int((long long)(n)*b/blockNum);
+#pragma omp parallel for schedule(dynamic,1)
+				for(int b=0;b<blockNum;++b)
+					std::sort(first+bound[b],first+bound[b+1]);
+				for(int w=1;w<blockNum;w*=2)
+				{
+#pragma omp parallel for schedule(dynamic,1)
+					for(int b=0;b<blockNum-w;b+=2*w)
+						std::inplace_merge(first+bound[b],first+bound[b+w],first+bound[std::min(b+2*w,blockNum)]);
+				}
+			}
 
 			/** This function removes all duplicate vertices of the mesh by looking only at their spatial positions.
 			Note that it does not update any topology relation that could be affected by this like the VT or TT relation.
@@ -153,68 +194,185 @@ private:
 			*/
 			static int RemoveDuplicateVertex( MeshType & m, bool RemoveDegenerateFlag=true)    // V1.0
 			{
-				if(m.vert.size()==0 || m.vn==0) return 0;
-
-				std::map<VertexPointer, VertexPointer> mp;
-				size_t i,j;
-				VertexIterator vi;
-				int deleted=0;
-				int k=0;
-				size_t num_vert = m.vert.size();
-				std::vector<VertexPointer> perm(num_vert);
-				for(vi=m.vert.begin(); vi!=m.vert.end(); ++vi, ++k)
-					perm[k] = &(*vi);
-
-				RemoveDuplicateVert_Compare c_obj;
-
-				std::sort(perm.begin(),perm.end(),c_obj);
+				std::vector<int> remap;
+				return RemoveDuplicateVertex(m,remap,0,RemoveDegenerateFlag);
+			}
 
-				j = 0;
-				i = j;
-				mp[perm[i]] = perm[j];
-				++i;
-				for(;i!=num_vert;)
+			/** Same as above, and returns in remap the index of the vertex that replaced each vertex
+			(remap[i]==i for the vertices that are kept, and for the deleted ones), so that the caller can update
+			its own per vertex data. Among coincident vertices the one with the lowest index is kept.
+			If weldRadius is greater than zero also the near duplicates are welded: vertices are scanned in index order
+			and each one is merged with the lowest index kept vertex closer than weldRadius, if any.
+			The faces and the edges are updated with a remap table; the vertices are not compacted, so remap is valid
+			until the next CompactVertexVector.
+			*/
+			static int RemoveDuplicateVertex( MeshType & m, std::vector<int> &remap, ScalarType weldRadius=0, bool RemoveDegenerateFlag=true)
+			{
+				const int vn=int(m.vert.size());
+				remap.resize(vn);
+				for(int i=0;i<vn;++i) remap[i]=i;
+				if(vn==0 || m.vn==0) return 0;
+
+				std::vector<SortedVert> sv;
+				sv.reserve(m.vn);
+				for(int i=0;i<vn;++i)
+					if(!m.vert[i].IsD())
+					{
+						SortedVert e;
+						e.p=Point3x::Construct(m.vert[i].cP());
+						e.i=i;
+						sv.push_back(e);
+					}
+				ParallelSort(sv.begin(),sv.end());
+				for(size_t k=1,j=0;k<sv.size();++k)
+				{
+					if(sv[k].p==sv[j].p) remap[sv[k].i]=sv[j].i;
+					else j=k;
+				}
+				if(weldRadius>0)
 				{
-					if( (! (*perm[i]).IsD()) &&
-						(! (*perm[j]).IsD()) &&
-						(*perm[i]).P() == (*perm[j]).cP() )
+					WeldRemap(m,remap,weldRadius);
+					for(int i=0;i<vn;++i) remap[i]=remap[remap[i]];
+				}
+
+				int deleted=0;
+				for(int i=0;i<vn;++i)
+					if(remap[i]!=i)
 					{
-						VertexPointer t = perm[i];
-						mp[perm[i]] = perm[j];
-						++i;
-						Allocator<MeshType>::DeleteVertex(m,*t);
+						Allocator<MeshType>::DeleteVertex(m,m.vert[i]);
 						deleted++;
 					}
-					else
+				if(deleted==0) return 0;
+
+				const int fn=int(m.face.size());
+#pragma omp parallel for schedule(static)
+				for(int i=0;i<fn;++i)
+					if( !m.face[i].IsD() )
+						for(int k=0;k<m.face[i].VN();++k)
+							m.face[i].V(k)=&m.vert[remap[tri::Index(m,m.face[i].V(k))]];
+
+				const int en=int(m.edge.size());
+#pragma omp parallel for schedule(static)
+				for(int i=0;i<en;++i)
+					if( !m.edge[i].IsD() )
+						for(int k=0;k<2;++k)
+							m.edge[i].V(k)=&m.vert[remap[tri::Index(m,m.edge[i].V(k))]];
+
+				if(RemoveDegenerateFlag) RemoveDegenerateFace(m);
+				if(RemoveDegenerateFlag && m.en>0) {
+					RemoveDegenerateEdge(m);
+					RemoveDuplicateEdge(m);
+				}
+				return deleted;
+			}
+
+			/// Weld the near duplicates for RemoveDuplicateVertex: only the vertices kept after the
+			/// removal of the exact duplicates (remap[i]==i) are considered. They are bucketed in a hashed grid
+			/// of cells of size twice the radius, so that only 8 cells must be checked for each vertex
+			/// (any larger size works too: the cells are enlarged when the radius is so small w.r.t. the
+			/// bounding box that the cell coordinates would overflow an int).
+			static void WeldRemap(MeshType &m, std::vector<int> &remap, ScalarType weldRadius)
+			{
+				const int vn=int(m.vert.size());
+				Box3Type bb;
+				for(int i=0;i<vn;++i)
+					if(!m.vert[i].IsD() && remap[i]==i) bb.Add(Point3x::Construct(m.vert[i].cP()));
+				const ScalarType cellSize=std::max(2*weldRadius,bb.Diag()/ScalarType(1<<30));
+				std::vector<CellVert> cv;
+				for(int i=0;i<vn;++i)
+					if(!m.vert[i].IsD() && remap[i]==i)
 					{
-						j = i;
-						++i;
+						const Point3x d=(Point3x::Construct(m.vert[i].cP())-bb.min)/cellSize;
+						CellVert e;
+						e.c=Point3i((int)d[0],(int)d[1],(int)d[2]);
+						e.i=i;
+						cv.push_back(e);
 					}
+				ParallelSort(cv.begin(),cv.end());
+				std::vector<Point3i> cellKey;
+				std::vector<int> cellStart;
+				for(size_t k=0;k<cv.size();++k)
+					if(k==0 || cv[k].c!=cv[k-1].c)
+					{
+						cellKey.push_back(cv[k].c);
+						cellStart.push_back(int(k));
+					}
+				cellStart.push_back(int(cv.size()));
+
+				// open addressing hash table from cell to its index in cellKey
+				size_t tableSize=1;
+				while(tableSize<2*cellKey.size()) tableSize*=2;
+				std::vector<int> table(tableSize,-1);
+				HashFunctor hf;
+				for(size_t u=0;u<cellKey.size();++u)
+				{
+					size_t h=hf(cellKey[u])&(tableSize-1);
+					while(table[h]>=0) h=(h+1)&(tableSize-1);
+					table[h]=int(u);
 				}
 
-		for(FaceIterator fi = m.face.begin(); fi!=m.face.end(); ++fi)
-					if( !(*fi).IsD() )
-						for(k = 0; k < 3; ++k)
-							if( mp.find( (typename MeshType::VertexPointer)(*fi).V(k) ) != mp.end() )
-							{
-								(*fi).V(k) = &*mp[ (*fi).V(k) ];
-							}
-
+				// First, in parallel, find for each vertex the lowest index vertex within the radius.
+				// Then scan the vertices in index order (so that the candidates are already resolved):
+				// if that candidate has been kept it is the answer, otherwise search the lowest index kept one.
+				WeldGrid g(m,bb.min,cellSize,weldRadius*weldRadius,remap,cellKey,cellStart,cv,table);
+				std::vector<int> candidate(vn,-1);
+#pragma omp parallel for schedule(dynamic,1024)
+				for(int i=0;i<vn;++i)
+					if(!m.vert[i].IsD() && remap[i]==i)
+						candidate[i] = g.Lowest(i,false);
+				for(int i=0;i<vn;++i)
+					if(candidate[i]>=0 && candidate[i]!=i)
+						remap[i] = (remap[candidate[i]]==candidate[i]) ? candidate[i] : g.Lowest(i,true);
+			}
 
-        for(EdgeIterator ei = m.edge.begin(); ei!=m.edge.end(); ++ei)
-          if( !(*ei).IsD() )
-            for(k = 0; k < 2; ++k)
-              if( mp.find( (typename MeshType::VertexPointer)(*ei).V(k) ) != mp.end() )
-              {
-                (*ei).V(k) = &*mp[ (*ei).V(k) ];
-              }
-        if(RemoveDegenerateFlag) RemoveDegenerateFace(m);
-        if(RemoveDegenerateFlag && m.en>0) {
-          RemoveDegenerateEdge(m);
-          RemoveDuplicateEdge(m);
-        }
-                return deleted;
-      }
+			/// Hashed grid of the vertices used by WeldRemap.
+			class WeldGrid
+			{
+			public:
+				MeshType &m;
+				Point3x origin;
+				ScalarType cellSize,sqRadius;
+				const std::vector<int> &remap;
+				const std::vector<Point3i> &cellKey;
+				const std::vector<int> &cellStart;
+				const std::vector<CellVert> &cv;
+				const std::vector<int> &table;
+
+				WeldGrid(MeshType &_m, const Point3x &_origin, ScalarType _cellSize, ScalarType _sqRadius, const std::vector<int> &_remap,
+								 const std::vector<Point3i> &_cellKey, const std::vector<int> &_cellStart,
+								 const std::vector<CellVert> &_cv, const std::vector<int> &_table)
+					:m(_m),origin(_origin),cellSize(_cellSize),sqRadius(_sqRadius),remap(_remap),
+					 cellKey(_cellKey),cellStart(_cellStart),cv(_cv),table(_table) {}
+
+				/// Lowest index vertex within the radius from vertex i (i itself if none has a lower index);
+				/// if onlyKept is set, only the vertices not merged yet are considered.
+				/// The cells have size twice the radius, so the neighbours are in the cell of the vertex and in
+				/// the adjacent ones on the side of the half cell where the vertex lies.
+				int Lowest(int i, bool onlyKept) const
+				{
+					const Point3x p=Point3x::Construct(m.vert[i].cP());
+					const Point3x d=(p-origin)/cellSize;
+					const Point3i c((int)d[0],(int)d[1],(int)d[2]);
+					const Point3i o(d[0]-c[0]<0.5?-1:1, d[1]-c[1]<0.5?-1:1, d[2]-c[2]<0.5?-1:1);
+					const size_t mask=table.size()-1;
+					HashFunctor hf;
+					int best=i;
+					for(int n=0;n<8;++n)
+					{
+						const Point3i nc(c[0]+((n&1)?o[0]:0), c[1]+((n&2)?o[1]:0), c[2]+((n&4)?o[2]:0));
+						size_t h=hf(nc)&mask;
+						while(table[h]>=0 && cellKey[table[h]]!=nc) h=(h+1)&mask;
+						if(table[h]<0) continue;
+						const int u=table[h];
+						// the vertices of a cell are sorted by index: stop at the first one not lower than the current best
+						for(int k=cellStart[u];k<cellStart[u+1] && cv[k].i<best;++k)
+							if((!onlyKept || remap[cv[k].i]==cv[k].i) &&
+									SquaredDistance(Point3x::Construct(m.vert[cv[k].i].cP()),p)<=sqRadius)
+								best=cv[k].i;
+					}
+					return best;
+				}
+			};
 
 			class SortedPair
 				  {
@@ -1530,6 +1688,51 @@ private:
 				return (ret.size()>0);
 			}
 
+			/** Parallel version of SelfIntersections that returns the pairs of intersecting faces,
+			each one with the lower index face first, sorted by index. It returns the number of pairs.
+
+			The broad phase is the self traversal of a BVHIndex of the faces: the pairs of faces whose
+			bounding boxes overlap are tested (with TestFaceFaceIntersection) by different threads, each
+			pair once, so no per face mark is needed and the result does not depend on the number of threads.
+			*/
+			class FaceIntersectionTest
+			{
+			public:
+				// the lower index face first, as in SelfIntersections
+				bool operator()(FaceType &f0, FaceType &f1) const
+				{ return (&f0<&f1) ? TestFaceFaceIntersection(&f0,&f1) : TestFaceFaceIntersection(&f1,&f0); }
+			};
+
+			static int SelfIntersectingPairs(MeshType &m, std::vector<std::pair<FacePointer,FacePointer> > &ret)
+			{
+				ret.clear();
+				BVHIndex<FaceType,ScalarType> bvh;
+				bvh.Set(m.face.begin(),m.face.end());
+				FaceIntersectionTest pairTest;
+				bvh.GetOverlappingPairs(pairTest,ret);
+				for(size_t i=0;i<ret.size();++i)
+					if(ret[i].second<ret[i].first) std::swap(ret[i].first,ret[i].second);
+				std::sort(ret.begin(),ret.end());
+				return int(ret.size());
+			}
+
+			/// Same as SelfIntersections (returns the intersecting faces, each one once, in index order)
+			/// but computed in parallel by SelfIntersectingPairs; it does not need the per face mark.
+			static bool SelfIntersectionsParallel(MeshType &m, std::vector<FaceType*> &ret)
+			{
+				std::vector<std::pair<FacePointer,FacePointer> > pairs;
+				SelfIntersectingPairs(m,pairs);
+				ret.clear();
+				for(size_t i=0;i<pairs.size();++i)
+				{
+					ret.push_back(pairs[i].first);
+					ret.push_back(pairs[i].second);
+				}
+				std::sort(ret.begin(),ret.end());
+				ret.erase(std::unique(ret.begin(),ret.end()),ret.end());
+				return (ret.size()>0);
+			}
+
       /**
       This function simply test that the vn and fn counters be consistent with the size of the containers and the number of deleted simplexes.
       */
@@ -75,6 +75,47 @@ namespace vcg {
 			inline void SetMesh(void * /*m=0*/) const {}
 		};
 
+		/** Marker that keeps its own visitation stamps instead of using the
+		imark of the mesh elements, so that many threads can query the same
+		spatial index at the same time, each one with its own marker.
+		It costs an unsigned int per element of the mesh.
+		*/
+		template <class MESH_TYPE,class OBJ_TYPE>
+		class LocalTmark
+		{
+			MESH_TYPE *m;
+			std::vector<unsigned int> stamp;
+			unsigned int curStamp;
+		public:
+			LocalTmark():m(0),curStamp(1){}
+			void UnMarkAll()
+			{
+				if(++curStamp==0) // wrap around: clear all the stamps
+				{
+					std::fill(stamp.begin(),stamp.end(),0u);
+					curStamp=1;
+				}
+			}
+			bool IsMarked(OBJ_TYPE* obj){return stamp[vcg::tri::Index(*m,obj)]==curStamp;}
+			void Mark(OBJ_TYPE* obj){ stamp[vcg::tri::Index(*m,obj)]=curStamp;}
+			void SetMesh(MESH_TYPE *_m, size_t elemNum)
+			{
+				m=_m;
+				stamp.assign(elemNum,0u);
+				curStamp=1;
+			}
+		};
+
+		template <class MESH_TYPE>
+		class LocalFaceTmark:public LocalTmark<MESH_TYPE,typename MESH_TYPE::FaceType>
+		{
+		public:
+			LocalFaceTmark(){}
+			LocalFaceTmark(MESH_TYPE *m) {this->SetMesh(m);}
+			void SetMesh(MESH_TYPE *_m)
+			{LocalTmark<MESH_TYPE,typename MESH_TYPE::FaceType>::SetMesh(_m,_m->face.size());}
+		};
+
 		//**CLOSEST FUNCTION DEFINITION**//
 
 		/*
@@ -270,8 +311,9 @@ namespace vcg {
 			MarkerFace mf;
 			mf.SetMesh(&mesh);
 			typedef vcg::face::PointDistanceBaseFunctor<typename MESH::ScalarType> FDistFunct;
+			FDistFunct fDistFunct;
 			return (gr.GetInSphere/*<FDistFunct,MarkerFace,OBJPTRCONTAINER,DISTCONTAINER,POINTCONTAINER>*/
-				(FDistFunct(),mf,_p,_r,_objectPtrs,_distances,_points));
+				(fDistFunct,mf,_p,_r,_objectPtrs,_distances,_points));
 		}
 
 		template <class MESH, class GRID, class OBJPTRCONTAINER, class DISTCONTAINER, class POINTCONTAINER>
@@ -362,6 +404,95 @@ namespace vcg {
 			return f;
 		}
 
+		/** Batched version of the closest face query.
+		For each point of _p it returns the closest face (NULL if farther than _maxDist),
+		the distance and the closest point on the face. The queries are run in parallel
+		(OpenMP) over the same grid; every thread uses its own LocalFaceTmark, so the
+		mesh imark is never touched and the grid must not be modified meanwhile.
+		Any point-face distance functor can be used (e.g. PointDistanceEPFunctor when
+		the EdgePlane component has been computed).
+		*/
+		template <class MESH, class GRID, class DISTFUNCTOR>
+		void GetClosestFaceBatch(MESH & mesh, GRID & gr, DISTFUNCTOR distFunct,
+								 const std::vector<typename GRID::CoordType> & _p,
+								 const typename GRID::ScalarType _maxDist,
+								 std::vector<typename MESH::FacePointer> & _faces,
+								 std::vector<typename GRID::ScalarType> & _minDist,
+								 std::vector<typename GRID::CoordType> & _closestPt)
+		{
+			typedef LocalFaceTmark<MESH> MarkerFace;
+			const int n = int(_p.size());
+			_faces.resize(n);
+			_minDist.resize(n);
+			_closestPt.resize(n);
+#pragma omp parallel
+			{
+				MarkerFace mf(&mesh);
+				DISTFUNCTOR localDistFunct(distFunct);
+#pragma omp for schedule(dynamic,64)
+				for(int i=0;i<n;++i)
+				{
+					_minDist[i]=_maxDist;
+					_faces[i]=gr.GetClosest(localDistFunct,mf,_p[i],_maxDist,_minDist[i],_closestPt[i]);
+				}
+			}
+		}
+
+		template <class MESH, class GRID>
+		void GetClosestFaceBaseBatch(MESH & mesh, GRID & gr,
+									 const std::vector<typename GRID::CoordType> & _p,
+									 const typename GRID::ScalarType _maxDist,
+									 std::vector<typename MESH::FacePointer> & _faces,
+									 std::vector<typename GRID::ScalarType> & _minDist,
+									 std::vector<typename GRID::CoordType> & _closestPt)
+		{
+			vcg::face::PointDistanceBaseFunctor<typename GRID::ScalarType> PDistFunct;
+			GetClosestFaceBatch(mesh,gr,PDistFunct,_p,_maxDist,_faces,_minDist,_closestPt);
+		}
+
+		/// Batched version of GetClosestVertex. The vertex marker is stateless so no extra state is needed.
+		template <class MESH, class GRID>
+		void GetClosestVertexBatch(MESH & mesh, GRID & gr,
+								   const std::vector<typename GRID::CoordType> & _p,
+								   const typename GRID::ScalarType _maxDist,
+								   std::vector<typename MESH::VertexPointer> & _verts,
+								   std::vector<typename GRID::ScalarType> & _minDist)
+		{
+			const int n = int(_p.size());
+			_verts.resize(n);
+			_minDist.resize(n);
+#pragma omp parallel for schedule(dynamic,64)
+			for(int i=0;i<n;++i)
+				_verts[i]=GetClosestVertex(mesh,gr,_p[i],_maxDist,_minDist[i]);
+		}
+
+		/// Batched version of DoRay: for each ray it returns the first hit face (NULL if none within _maxDist) and its parameter t.
+		template <class MESH, class GRID>
+		void DoRayBatch(MESH & mesh, GRID & gr,
+						const std::vector< Ray3<typename GRID::ScalarType> > & _ray,
+						const typename GRID::ScalarType & _maxDist,
+						std::vector<typename GRID::ObjPtr> & _faces,
+						std::vector<typename GRID::ScalarType> & _t)
+		{
+			typedef LocalFaceTmark<MESH> MarkerFace;
+			typedef vcg::RayTriangleIntersectionFunctor<true> FintFunct;
+			const int n = int(_ray.size());
+			_faces.resize(n);
+			_t.resize(n);
+#pragma omp parallel
+			{
+				MarkerFace mf(&mesh);
+				FintFunct ff;
+#pragma omp for schedule(dynamic,64)
+				for(int i=0;i<n;++i)
+				{
+					Ray3<typename GRID::ScalarType> _ray1=_ray[i];
+					_ray1.Normalize();
+					_faces[i]=gr.DoRay(ff,mf,_ray1,_maxDist,_t[i]);
+				}
+			}
+		}
+
 		///Iteratively Do Ray sampling on spherical coordinates 
 		///sampling along the two angles
 		template <class MESH, class GRID, class OBJPTRCONTAINER, class COORDCONTAINER>
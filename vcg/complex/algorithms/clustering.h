@@ -429,6 +429,54 @@ class Clustering
     }
 
   }
+
+  /// As ExtractPointSet, but the cells are pushed (position, normal and color) to a stream
+  /// writer like io::PlyStreamWriter, with the PushVertex(p,n,c) method, instead of a mesh.
+  template <class StreamType>
+  void ExtractPointSetToStream(StreamType &out)
+  {
+    typename STDEXT::hash_map<HashedPoint3i,CellType>::iterator gi;
+    for(gi=GridCell.begin();gi!=GridCell.end();++gi)
+      out.PushVertex((*gi).second.Pos(),(*gi).second.N(),(*gi).second.Col());
+  }
+
+  /// As ExtractMesh, but the vertices and faces are pushed to a stream writer like
+  /// io::PlyStreamWriter (with PushVertex(p,n,c) and PushFace(i0,i1,i2)) instead of a mesh,
+  /// so the simplified mesh is never built in memory. The face indices are offset by
+  /// the vertices already pushed to the stream (out.VN()).
+  template <class StreamType>
+  void ExtractMeshToStream(StreamType &out)
+  {
+    if (TriSet.empty() || GridCell.empty())
+      return;
+
+    const int base=out.VN();
+    typename STDEXT::hash_map<HashedPoint3i,CellType>::iterator gi;
+    int i=0;
+    for(gi=GridCell.begin();gi!=GridCell.end();++gi)
+    {
+      out.PushVertex((*gi).second.Pos(),CoordType(0,0,0),(*gi).second.Col());
+      (*gi).second.id=i;
+      ++i;
+    }
+    TriHashSetIterator ti;
+    for(ti=TriSet.begin();ti!=TriSet.end();++ti)
+    {
+      int v0=(*ti).v[0]->id, v1=(*ti).v[1]->id, v2=(*ti).v[2]->id;
+      // same orientation choice of ExtractMesh
+      if(!DuplicateFaceParam)
+      {
+        CoordType N=((*ti).v[1]->Pos()-(*ti).v[0]->Pos())^((*ti).v[2]->Pos()-(*ti).v[0]->Pos());
+        int badOrient=0;
+        if( N.dot((*ti).v[0]->N()) <0) ++badOrient;
+        if( N.dot((*ti).v[1]->N()) <0) ++badOrient;
+        if( N.dot((*ti).v[2]->N()) <0) ++badOrient;
+        if(badOrient>2)
+          std::swap(v0,v1);
+      }
+      out.PushFace(base+v0,base+v1,base+v2);
+    }
+  }
 }; //end class clustering
  } // namespace tri
 } // namespace vcg
@@ -58,7 +58,7 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
     max_edge *= radius;    
       
     VertexConstDataWrapper<MESH> ww(this->mesh);
-    tree = new KdTree<float>(ww);
+    tree = new KdTree<ScalarType>(ww);
     tree->setMaxNofNeighbors(16);
     
     usedBit = VertexType::NewBitFlag();
@@ -322,7 +322,7 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
   int last_seed;     //used for new seeds when front is empty
   int usedBit;       //use to detect if a vertex has been already processed.
   Point3x baricenter;//used for the first seed.  
-  KdTree<float> *tree;
+  KdTree<ScalarType> *tree;
 
     
   /* returns the sphere touching p0, p1, p2 of radius r such that
@@ -0,0 +1,318 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_PARALLEL_WALKER
+#define __VCG_PARALLEL_WALKER
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <wrap/callback.h>
+#include <vcg/complex/allocate.h>
+
+namespace vcg {
+namespace tri {
+
+/** Multithreaded version of the TrivialWalker.
+
+The volume is cut along Y in blocks of SlabSize cells that are extracted at the same
+time by different threads (OpenMP), each one with its own copy of the extractor and its
+own mesh; the blocks are then merged in order. Each block starts one slice earlier, on
+the last slice of the previous block, whose output is thrown away: in this way the
+vertices on the plane shared by two blocks are created by both of them, with the same
+value, and the cells of the first slice of the block find them already there, as in a
+serial walk (the vertex inside an ambiguous cell is the mean of the existing ones).
+Only the shared vertices of the lower block are kept. The result does not depend on
+the number of threads and it is the same mesh, with the same vertex and face order,
+of a single block walk (i.e. of a serial walk of all the cells).
+
+It is a drop in replacement of the TrivialWalker: the volume interface is the same
+(ISize(), Val(x,y,z) and Get[XYZ]Intercept(p1,p2,v,thr)) and so is the BuildMesh() call:
+
+    typedef vcg::tri::ParallelWalker<MyMesh,MyVolume>   MyWalker;
+    typedef vcg::tri::MarchingCubes<MyMesh, MyWalker>   MyMarchingCubes;
+    MyWalker walker;
+    MyMarchingCubes mc(mesh, walker);
+    walker.BuildMesh<MyMarchingCubes>(mesh, volume, mc, threshold);
+
+The extractor of each block is built as EXTRACTOR_TYPE(blockMesh, blockWalker), the
+constructor used above, and it must build only the triangles of the cells it processes,
+as MarchingCubes does (ExtendedMarchingCubes flips the edges of the whole mesh in its
+Finalize() and it needs a serial walker). The volume must support concurrent reads.
+Unlike the TrivialWalker all the cells of the volume are processed, up to the last sample.
+*/
+template <class MeshType, class VolumeType>
+class ParallelWalker
+{
+private:
+  typedef int VertexIndex;
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef typename MeshType::VertexPointer VertexPointer;
+
+  // What is left of a block walk for the merge: the block mesh, the number of vertices and faces
+  // of its halo slice, the vertices on its first and last plane (indexed as the slice arrays)
+  // and the global index of its vertices
+  struct Block
+  {
+    Block():mesh(0),haloVert(0),haloFace(0) {}
+    MeshType *mesh;
+    int haloVert,haloFace;
+    std::vector<VertexIndex> bottomX,bottomZ,topX,topZ;
+    std::vector<VertexIndex> remap;
+  };
+
+public:
+  ParallelWalker():SlabSize(16),_mesh(0),_volume(0),_thr(0) {}
+
+  /// Number of cell slices of each block
+  int SlabSize;
+
+  template<class EXTRACTOR_TYPE>
+  void BuildMesh(MeshType &mesh, VolumeType &volume, EXTRACTOR_TYPE &/*extractor*/, const float threshold, vcg::CallBackPos * cb=0)
+  {
+    mesh.Clear();
+    const Point3i siz=volume.ISize();
+    if(siz[0]<2 || siz[1]<2 || siz[2]<2) return;
+    const int cellY=siz[1]-1;
+    const int slab=std::max(1,SlabSize);
+    const int blockNum=(cellY+slab-1)/slab;
+    std::vector<Block> blocks(blockNum);
+    int doneNum=0;
+
+#pragma omp parallel for schedule(dynamic,1)
+    for(int b=0;b<blockNum;++b)
+    {
+      Block &bl=blocks[b];
+      bl.mesh=new MeshType();
+      ParallelWalker blockWalker;
+      blockWalker.Init(volume,threshold,b*slab,std::min(cellY,(b+1)*slab));
+      EXTRACTOR_TYPE blockExtractor(*bl.mesh,blockWalker);
+      blockWalker.WalkBlock(*bl.mesh,blockExtractor,bl);
+#pragma omp critical (ParallelWalkerProgress)
+      {
+        ++doneNum;
+        if(cb) cb((100*doneNum)/blockNum,"Marching volume");
+      }
+    }
+
+    Merge(mesh,blocks);
+    for(int b=0;b<blockNum;++b)
+      delete blocks[b].mesh;
+  }
+
+  /// The volume of the block being walked, e.g. for an extractor that skips some cells
+  VolumeType &Volume() { return *_volume; }
+
+  float V(int pi, int pj, int pk)
+  {
+    return _volume->Val(pi, pj, pk)-_thr;
+  }
+
+  bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
+  {
+    int pos = p0.X()+p0.Z()*_bbox.max.X();
+    int vidx;
+
+    if (p0.X()!=p1.X()) // punti allineati lungo l'asse X
+      vidx = (p0.Y()==_current_slice) ? _x_cs[pos] : _x_ns[pos];
+    else if (p0.Y()!=p1.Y()) // punti allineati lungo l'asse Y
+      vidx = _y_cs[pos];
+    else if (p0.Z()!=p1.Z()) // punti allineati lungo l'asse Z
+      vidx = (p0.Y()==_current_slice)? _z_cs[pos] : _z_ns[pos];
+    else
+    {
+      assert(false);
+      vidx = -1;
+    }
+
+    v = (vidx!=-1)? &_mesh->vert[vidx] : NULL;
+    return v!=NULL;
+  }
+
+  void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    VertexIndex *cache = (p1.Y()==_current_slice) ? &_x_cs[0] : &_x_ns[0];
+    VertexIndex &pos = cache[p1.X()+p1.Z()*_bbox.max.X()];
+    if(pos==-1)
+    {
+      pos = NewVertex(v);
+      _volume->GetXIntercept(p1, p2, v, _thr);
+    }
+    v = &_mesh->vert[pos];
+  }
+  void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    VertexIndex &pos = _y_cs[p1.X()+p1.Z()*_bbox.max.X()];
+    if(pos==-1)
+    {
+      pos = NewVertex(v);
+      _volume->GetYIntercept(p1, p2, v, _thr);
+    }
+    v = &_mesh->vert[pos];
+  }
+  void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    VertexIndex *cache = (p1.Y()==_current_slice) ? &_z_cs[0] : &_z_ns[0];
+    VertexIndex &pos = cache[p1.X()+p1.Z()*_bbox.max.X()];
+    if(pos==-1)
+    {
+      pos = NewVertex(v);
+      _volume->GetZIntercept(p1, p2, v, _thr);
+    }
+    v = &_mesh->vert[pos];
+  }
+
+protected:
+  Box3i _bbox;          // the whole volume
+  int _y0,_y1;          // the cell slices [_y0,_y1) of this block (plus the halo slice _y0-1)
+  int _slice_dimension;
+  int _current_slice;
+
+  std::vector<VertexIndex> _x_cs; // indici dell'intersezioni della superficie lungo gli Xedge della fetta corrente
+  std::vector<VertexIndex> _y_cs; // indici dell'intersezioni della superficie lungo gli Yedge della fetta corrente
+  std::vector<VertexIndex> _z_cs; // indici dell'intersezioni della superficie lungo gli Zedge della fetta corrente
+  std::vector<VertexIndex> _x_ns; // indici dell'intersezioni della superficie lungo gli Xedge della prossima fetta
+  std::vector<VertexIndex> _z_ns; // indici dell'intersezioni della superficie lungo gli Zedge della prossima fetta
+
+  MeshType   *_mesh;
+  VolumeType *_volume;
+  float _thr;
+
+  void Init(VolumeType &volume, float threshold, int y0, int y1)
+  {
+    _volume = &volume;
+    _thr = threshold;
+    _bbox = Box3i(Point3i(0,0,0),volume.ISize());
+    _y0 = y0;
+    _y1 = y1;
+    _slice_dimension = _bbox.DimX()*_bbox.DimZ();
+    _x_cs.assign(_slice_dimension,-1);
+    _y_cs.assign(_slice_dimension,-1);
+    _z_cs.assign(_slice_dimension,-1);
+    _x_ns.assign(_slice_dimension,-1);
+    _z_ns.assign(_slice_dimension,-1);
+    _current_slice = std::max(0,_y0-1);
+  }
+
+  VertexIndex NewVertex(VertexPointer &v)
+  {
+    VertexIndex pos = VertexIndex(_mesh->vert.size());
+    Allocator<MeshType>::AddVertices( *_mesh, 1 );
+    v = &_mesh->vert[pos];
+    return pos;
+  }
+
+  template<class EXTRACTOR_TYPE>
+  void WalkBlock(MeshType &mesh, EXTRACTOR_TYPE &extractor, Block &bl)
+  {
+    _mesh = &mesh;
+    vcg::Point3i p1, p2;
+    extractor.Initialize();
+    for (int j=_current_slice; j<_y1; ++j)
+    {
+      for (int i=0; i<_bbox.max.X()-1; ++i)
+        for (int k=0; k<_bbox.max.Z()-1; ++k)
+        {
+          p1.X()=i;   p1.Y()=j;   p1.Z()=k;
+          p2.X()=i+1; p2.Y()=j+1; p2.Z()=k+1;
+          extractor.ProcessCell(p1, p2);
+        }
+      NextSlice();
+      if(j==_y0-1) // end of the halo slice
+      {
+        bl.haloVert=int(mesh.vert.size());
+        bl.haloFace=int(mesh.face.size());
+        bl.bottomX=_x_cs;
+        bl.bottomZ=_z_cs;
+      }
+    }
+    // after the last swap the current slice is the last plane of the block
+    bl.topX.swap(_x_cs);
+    bl.topZ.swap(_z_cs);
+    extractor.Finalize();
+    _mesh = NULL;
+  }
+
+  void NextSlice()
+  {
+    std::fill(_x_cs.begin(),_x_cs.end(),-1);
+    std::fill(_y_cs.begin(),_y_cs.end(),-1);
+    std::fill(_z_cs.begin(),_z_cs.end(),-1);
+    _x_cs.swap(_x_ns);
+    _z_cs.swap(_z_ns);
+    _current_slice += 1;
+  }
+
+  // The halo vertices of the first plane of a block take the index of the same vertex of the
+  // previous block, the other halo vertices and faces are dropped and all the others are
+  // appended in block order.
+  static void Merge(MeshType &mesh, std::vector<Block> &blocks)
+  {
+    const int blockNum=int(blocks.size());
+    std::vector<int> vertBase(blockNum+1,0), faceBase(blockNum+1,0);
+    for(int b=0;b<blockNum;++b)
+    {
+      Block &bl=blocks[b];
+      bl.remap.assign(bl.mesh->vert.size(),-1);
+      std::fill(bl.remap.begin(),bl.remap.begin()+bl.haloVert,-2);
+      if(b>0)
+      {
+        const Block &prev=blocks[b-1];
+        for(size_t pos=0;pos<bl.bottomX.size();++pos)
+        {
+          if(bl.bottomX[pos]!=-1 && prev.topX[pos]!=-1) bl.remap[bl.bottomX[pos]]=prev.remap[prev.topX[pos]];
+          if(bl.bottomZ[pos]!=-1 && prev.topZ[pos]!=-1) bl.remap[bl.bottomZ[pos]]=prev.remap[prev.topZ[pos]];
+        }
+      }
+      int cnt=vertBase[b];
+      for(size_t i=bl.haloVert;i<bl.remap.size();++i)
+        if(bl.remap[i]==-1) bl.remap[i]=cnt++;
+      vertBase[b+1]=cnt;
+      faceBase[b+1]=faceBase[b]+int(bl.mesh->face.size())-bl.haloFace;
+      bl.bottomX.clear(); bl.bottomZ.clear();
+      if(b>0) { blocks[b-1].topX.clear(); blocks[b-1].topZ.clear(); }
+    }
+
+    Allocator<MeshType>::AddVertices(mesh,vertBase[blockNum]);
+    Allocator<MeshType>::AddFaces(mesh,faceBase[blockNum]);
+
+#pragma omp parallel for schedule(dynamic,1)
+    for(int b=0;b<blockNum;++b)
+    {
+      const MeshType &bm=*blocks[b].mesh;
+      const std::vector<VertexIndex> &remap=blocks[b].remap;
+      for(size_t i=blocks[b].haloVert;i<bm.vert.size();++i)
+        if(remap[i]>=vertBase[b]) // not shared with the previous block
+          mesh.vert[remap[i]].ImportData(bm.vert[i]);
+      for(size_t i=blocks[b].haloFace;i<bm.face.size();++i)
+      {
+        typename MeshType::FaceType &f=mesh.face[faceBase[b]+i-blocks[b].haloFace];
+        f.ImportData(bm.face[i]);
+        for(int j=0;j<3;++j)
+          f.V(j)=&mesh.vert[remap[tri::Index(bm,bm.face[i].cV(j))]];
+      }
+    }
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCG_PARALLEL_WALKER
@@ -0,0 +1,306 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_STREAMING_WALKER
+#define __VCG_STREAMING_WALKER
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <wrap/callback.h>
+
+namespace vcg {
+
+// Slab sources: the StreamingWalker pulls the volume one Z slice at a time, in increasing z order,
+// from any class with this interface:
+//   const Point3i &ISize();                 // number of samples along each axis
+//   void GetSlice(int z, float *slice);     // fill the ISize()[0]*ISize()[1] samples of slice z (x fastest)
+
+/// Slab source reading a raw volume file of VOXEL_SCALAR values (x fastest, then y, then z),
+/// sequentially, one slice at a time.
+template <class VOXEL_SCALAR>
+class RawVolumeSlabReader
+{
+public:
+  RawVolumeSlabReader():fp(0),nextZ(0) {}
+  ~RawVolumeSlabReader() { if(fp) fclose(fp); }
+
+  /// headerSize is the number of bytes to skip at the beginning of the file
+  bool Open(const char *filename, const Point3i &size, long headerSize=0)
+  {
+    fp=fopen(filename,"rb");
+    if(!fp) return false;
+    sz=size;
+    nextZ=0;
+    buf.resize(size_t(sz[0])*sz[1]);
+    return headerSize==0 || fseek(fp,headerSize,SEEK_SET)==0;
+  }
+
+  const Point3i &ISize() const { return sz; }
+
+  void GetSlice(int z, float *slice)
+  {
+    assert(z==nextZ); // the file is read sequentially
+    size_t n=fread(&buf[0],sizeof(VOXEL_SCALAR),buf.size(),fp);
+    for(size_t i=0;i<n;++i) slice[i]=float(buf[i]);
+    for(size_t i=n;i<buf.size();++i) slice[i]=0; // truncated file
+    nextZ=z+1;
+  }
+
+protected:
+  FILE *fp;
+  Point3i sz;
+  int nextZ;
+  std::vector<VOXEL_SCALAR> buf;
+};
+
+/// Slab source reading an in memory volume (e.g. a SimpleVolume) through its Val(x,y,z) method.
+template <class VolumeType>
+class VolumeSlabSource
+{
+public:
+  VolumeSlabSource(VolumeType &_v):v(_v) {}
+  const Point3i &ISize() { return v.ISize(); }
+  void GetSlice(int z, float *slice)
+  {
+    const Point3i &sz=v.ISize();
+    for(int y=0;y<sz[1];++y)
+      for(int x=0;x<sz[0];++x)
+        *slice++=v.Val(x,y,z);
+  }
+protected:
+  VolumeType &v;
+};
+
+namespace tri {
+
+/** \brief Walker for MarchingCubes that streams both the volume and the resulting mesh.
+
+The volume is pulled from a slab source one Z slice at a time and only two slices are kept in memory,
+together with the indices of the vertices on the edges of the current cell layer.
+The mesh passed to BuildMesh is used only as a buffer for the current layer: after each layer its
+new vertices and its faces are pushed to the sink and the buffer is emptied, keeping only the
+vertices on the next slice. So both the volume and the extracted surface can be much larger than
+the available memory: the memory used is O(sx*sy) plus the surface crossing one cell layer.
+
+The sink must provide:
+  void PushVertices(const std::vector<CoordType> &pos);
+  void PushFaces(const std::vector<Point3i> &tri);   // global indices, in the order the vertices were pushed
+e.g. io::PlyStreamWriter. Vertices are in grid coordinates, as with TrivialWalker.
+
+Usage:
+\code
+  RawVolumeSlabReader<unsigned char> source;
+  source.Open("volume.raw",Point3i(2048,2048,2048));
+  io::PlyStreamWriter out;
+  out.Open("surface.ply");
+  MyMesh buffer;
+  StreamingWalker<MyMesh, RawVolumeSlabReader<unsigned char> > walker;
+  MarchingCubes<MyMesh, StreamingWalker<MyMesh, RawVolumeSlabReader<unsigned char> > > mc(buffer, walker);
+  walker.BuildMesh(buffer, source, mc, out, 128);
+  out.Close();
+\endcode
+*/
+template <class MeshType, class SourceType>
+class StreamingWalker
+{
+private:
+  typedef int VertexIndex;
+  typedef typename MeshType::ScalarType ScalarType;
+  typedef typename MeshType::CoordType CoordType;
+  typedef typename MeshType::VertexPointer VertexPointer;
+public:
+
+  template<class EXTRACTOR_TYPE, class SINK_TYPE>
+  void BuildMesh(MeshType &mesh, SourceType &source, EXTRACTOR_TYPE &extractor, SINK_TYPE &sink, const float threshold, vcg::CallBackPos * cb=0)
+  {
+    _sz=source.ISize();
+    _mesh=&mesh;
+    _thr=threshold;
+    _pushedVertNum=0;
+    _slice_dimension=_sz[0]*_sz[1];
+    _slab[0].resize(_slice_dimension);
+    _slab[1].resize(_slice_dimension);
+    _x_cs.assign(_slice_dimension,-1);
+    _y_cs.assign(_slice_dimension,-1);
+    _x_ns.assign(_slice_dimension,-1);
+    _y_ns.assign(_slice_dimension,-1);
+    _z_cs.assign(_slice_dimension,-1);
+    _gid.clear();
+
+    extractor.Initialize();
+    if(_sz[0]>1 && _sz[1]>1 && _sz[2]>1)
+    {
+      source.GetSlice(0,&_slab[0][0]);
+      vcg::Point3i p1, p2;
+      for(_current_slice=0; _current_slice<_sz[2]-1; ++_current_slice)
+      {
+        if(cb && ((_current_slice%16)==0) ) cb(_current_slice*100/_sz[2],"Marching volume");
+        source.GetSlice(_current_slice+1,&_slab[1][0]);
+        for(int y=0;y<_sz[1]-1;++y)
+          for(int x=0;x<_sz[0]-1;++x)
+          {
+            p1.X()=x;   p1.Y()=y;   p1.Z()=_current_slice;
+            p2.X()=x+1; p2.Y()=y+1; p2.Z()=_current_slice+1;
+            extractor.ProcessCell(p1, p2);
+          }
+        Flush(sink);
+        NextSlice();
+      }
+    }
+    extractor.Finalize();
+    _mesh->Clear();
+    _mesh=NULL;
+  }
+
+  float V(int pi, int pj, int pk) const
+  {
+    return Slab(pk)[pi+pj*_sz[0]]-_thr;
+  }
+
+  bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
+  {
+    const int pos = p0.X()+p0.Y()*_sz[0];
+    int vidx;
+
+    if (p0.X()!=p1.X())
+      vidx = (p0.Z()==_current_slice) ? _x_cs[pos] : _x_ns[pos];
+    else if (p0.Y()!=p1.Y())
+      vidx = (p0.Z()==_current_slice) ? _y_cs[pos] : _y_ns[pos];
+    else
+    {
+      assert(p0.Z()!=p1.Z());
+      vidx = _z_cs[pos];
+    }
+    v = (vidx!=-1)? &_mesh->vert[vidx] : NULL;
+    return v!=NULL;
+  }
+
+  void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    const int pos = p1.X()+p1.Y()*_sz[0];
+    GetIntercept((p1.Z()==_current_slice) ? _x_cs[pos] : _x_ns[pos], p1, p2, v);
+  }
+  void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    const int pos = p1.X()+p1.Y()*_sz[0];
+    GetIntercept((p1.Z()==_current_slice) ? _y_cs[pos] : _y_ns[pos], p1, p2, v);
+  }
+  void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    const int pos = p1.X()+p1.Y()*_sz[0];
+    GetIntercept(_z_cs[pos], p1, p2, v);
+  }
+
+protected:
+  Point3i _sz;
+  int _slice_dimension;
+  int _current_slice;
+  std::vector<float> _slab[2];   // samples of the current and of the next slice
+
+  std::vector<VertexIndex> _x_cs; // indices in the buffer mesh of the intersections along the X edges of the current slice
+  std::vector<VertexIndex> _y_cs; // indices in the buffer mesh of the intersections along the Y edges of the current slice
+  std::vector<VertexIndex> _x_ns; // indices in the buffer mesh of the intersections along the X edges of the next slice
+  std::vector<VertexIndex> _y_ns; // indices in the buffer mesh of the intersections along the Y edges of the next slice
+  std::vector<VertexIndex> _z_cs; // indices in the buffer mesh of the intersections along the Z edges between the two slices
+
+  std::vector<int> _gid;          // global (output) index of the buffer vertices already pushed to the sink
+  int _pushedVertNum;             // number of vertices pushed to the sink
+
+  MeshType *_mesh;
+  float _thr;
+
+  const std::vector<float> &Slab(int z) const { return _slab[z==_current_slice ? 0 : 1]; }
+
+  void GetIntercept(VertexIndex &cache, const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+  {
+    if(cache==-1)
+    {
+      cache = (VertexIndex) _mesh->vert.size();
+      Allocator<MeshType>::AddVertices( *_mesh, 1 );
+      v = &_mesh->vert[cache];
+      const float f1 = V(p1.X(),p1.Y(),p1.Z());
+      const float f2 = V(p2.X(),p2.Y(),p2.Z());
+      const ScalarType u = ScalarType(f1/(f1-f2));
+      for(int a=0;a<3;++a)
+        v->P()[a] = (p1[a]==p2[a]) ? ScalarType(p1[a]) : ScalarType(p1[a])*(1-u) + u*ScalarType(p2[a]);
+      return;
+    }
+    v = &_mesh->vert[cache];
+  }
+
+  /// Push the new vertices and the faces of the buffer to the sink.
+  template <class SINK_TYPE>
+  void Flush(SINK_TYPE &sink)
+  {
+    std::vector<CoordType> pos;
+    pos.reserve(_mesh->vert.size()-_gid.size());
+    for(size_t i=_gid.size();i<_mesh->vert.size();++i)
+    {
+      pos.push_back(_mesh->vert[i].cP());
+      _gid.push_back(_pushedVertNum++);
+    }
+    sink.PushVertices(pos);
+
+    std::vector<Point3i> faces;
+    faces.reserve(_mesh->face.size());
+    for(size_t i=0;i<_mesh->face.size();++i)
+      if(!_mesh->face[i].IsD())
+        faces.push_back(Point3i(_gid[tri::Index(*_mesh,_mesh->face[i].V(0))],
+                              _gid[tri::Index(*_mesh,_mesh->face[i].V(1))],
+                              _gid[tri::Index(*_mesh,_mesh->face[i].V(2))]));
+    sink.PushFaces(faces);
+  }
+
+  /// Keep in the buffer only the vertices of the next slice, that becomes the current one.
+  void NextSlice()
+  {
+    std::vector<CoordType> keptPos;
+    std::vector<int> keptGid;
+    std::vector<VertexIndex> *ns[2] = { &_x_ns, &_y_ns };
+    for(int a=0;a<2;++a)
+      for(int i=0;i<_slice_dimension;++i)
+      {
+        VertexIndex &vi=(*ns[a])[i];
+        if(vi==-1) continue;
+        keptPos.push_back(_mesh->vert[vi].cP());
+        keptGid.push_back(_gid[vi]);
+        vi=VertexIndex(keptPos.size()-1);
+      }
+    _mesh->Clear();
+    if(!keptPos.empty())
+    {
+      Allocator<MeshType>::AddVertices(*_mesh,int(keptPos.size()));
+      for(size_t i=0;i<keptPos.size();++i) _mesh->vert[i].P()=keptPos[i];
+    }
+    _gid.swap(keptGid);
+
+    std::swap(_x_cs,_x_ns);
+    std::swap(_y_cs,_y_ns);
+    std::fill(_x_ns.begin(),_x_ns.end(),-1);
+    std::fill(_y_ns.begin(),_y_ns.end(),-1);
+    std::fill(_z_cs.begin(),_z_cs.end(),-1);
+    _slab[0].swap(_slab[1]);
+  }
+};
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCG_STREAMING_WALKER
@@ -0,0 +1,163 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCG_NARROW_BAND_VOLUME
+#define __VCG_NARROW_BAND_VOLUME
+
+#include <vector>
+#include <algorithm>
+#include <vcg/space/box3.h>
+#include <vcg/space/index/spatial_hashing.h>
+
+namespace vcg {
+
+/** Sparse volume made of bricks of 8x8x8 samples, allocated only where they are needed
+(e.g. in a narrow band around a surface). The bricks are found through a hash table on
+their integer coordinates (the sample coordinates divided by 8); the samples outside the
+allocated bricks have the Background() value.
+
+The bricks are first declared with AddBrick()/AddBox(), then Allocate() sorts them
+(so their order does not depend on how they were added) and creates the samples, of all
+the bricks or, to keep only a part of the band in memory, of the ones later passed to
+AllocateBrick() (FreeBrick() releases them). The samples can be written by different
+threads, one brick each, through BrickKey()/BrickData().
+*/
+template <class VOX_TYPE>
+class NarrowBandVolume
+{
+public:
+  typedef VOX_TYPE VoxelType;
+  enum { BrickShift=3, BrickSide=1<<BrickShift, BrickSize=BrickSide*BrickSide*BrickSide };
+
+  NarrowBandVolume():bg() {}
+
+  /// The volume has sz[i]+1 samples along the i axis (sz cells), as a BasicGrid
+  void Init(const Point3i &sz, const VOX_TYPE &background=VOX_TYPE())
+  {
+    siz=sz;
+    bg=background;
+    Clear();
+  }
+
+  void Clear()
+  {
+    brickMap.clear();
+    keys.clear();
+    data.clear();
+  }
+
+  const Point3i &ISize() const { return siz; }
+  const VOX_TYPE &Background() const { return bg; }
+
+  static Point3i BrickOf(int x, int y, int z) { return Point3i(x>>BrickShift,y>>BrickShift,z>>BrickShift); }
+
+  void AddBrick(const Point3i &b)
+  {
+    if(brickMap.find(b)==brickMap.end())
+    {
+      brickMap[b]=int(keys.size());
+      keys.push_back(b);
+    }
+  }
+
+  /// Add all the bricks with a sample in the (sample coordinates) box, clamped to the volume
+  void AddBox(const Box3i &sb)
+  {
+    const Point3i lo=BrickOf(std::max(0,sb.min[0]),std::max(0,sb.min[1]),std::max(0,sb.min[2]));
+    const Point3i hi=BrickOf(std::min(siz[0],sb.max[0]),std::min(siz[1],sb.max[1]),std::min(siz[2],sb.max[2]));
+    for(int bz=lo[2];bz<=hi[2];++bz)
+      for(int by=lo[1];by<=hi[1];++by)
+        for(int bx=lo[0];bx<=hi[0];++bx)
+          AddBrick(Point3i(bx,by,bz));
+  }
+
+  /// Sort the bricks and allocate the samples of all of them (or of none), set to the background value
+  void Allocate(bool allBricks=true)
+  {
+    std::sort(keys.begin(),keys.end());
+    for(size_t i=0;i<keys.size();++i)
+      brickMap[keys[i]]=int(i);
+    data.clear();
+    data.resize(keys.size());
+    if(allBricks)
+      for(int i=0;i<BrickNum();++i)
+        AllocateBrick(i);
+  }
+
+  void AllocateBrick(int i) { data[i].assign(BrickSize,bg); }
+  void FreeBrick(int i) { std::vector<VOX_TYPE>().swap(data[i]); }
+  bool IsAllocated(int i) const { return !data[i].empty(); }
+
+  int BrickNum() const { return int(keys.size()); }
+  const Point3i &BrickKey(int i) const { return keys[i]; }
+  VOX_TYPE *BrickData(int i) { return &data[i][0]; }
+  const VOX_TYPE *BrickData(int i) const { return &data[i][0]; }
+
+  /// Index of the brick, -1 if it is not in the volume
+  int BrickIndex(const Point3i &b) const
+  {
+    typename BrickMapType::const_iterator bi=brickMap.find(b);
+    return (bi==brickMap.end()) ? -1 : bi->second;
+  }
+
+  /// Offset of a sample inside its brick
+  static int SampleIndex(int x, int y, int z)
+  {
+    return (x&(BrickSide-1)) + ((y&(BrickSide-1))<<BrickShift) + ((z&(BrickSide-1))<<(2*BrickShift));
+  }
+
+  VOX_TYPE Val(int x, int y, int z) const
+  {
+    const int bi=BrickIndex(BrickOf(x,y,z));
+    return (bi<0 || !IsAllocated(bi)) ? bg : BrickData(bi)[SampleIndex(x,y,z)];
+  }
+
+  /// Brick indexes of a whole layer of bricks with the same y (the y of the brick, not of the sample),
+  /// as a (x,z) table with ISize()[0]/8+1 columns; a walker that visits the volume slice by slice
+  /// reads the samples through it without querying the hash table
+  void GetLayer(int by, std::vector<int> &layer) const
+  {
+    const int nx=(siz[0]>>BrickShift)+1, nz=(siz[2]>>BrickShift)+1;
+    layer.assign(nx*nz,-1);
+    for(int bz=0;bz<nz;++bz)
+      for(int bx=0;bx<nx;++bx)
+        layer[bx+bz*nx]=BrickIndex(Point3i(bx,by,bz));
+  }
+
+  int MemUsed() const
+  {
+    size_t mem=sizeof(NarrowBandVolume)+keys.size()*(sizeof(Point3i)*2+sizeof(int)+sizeof(std::vector<VOX_TYPE>));
+    for(size_t i=0;i<data.size();++i) mem+=data[i].size()*sizeof(VOX_TYPE);
+    return int(mem);
+  }
+
+protected:
+  typedef typename STDEXT::hash_map<Point3i,int,HashFunctor> BrickMapType;
+  Point3i siz;
+  VOX_TYPE bg;
+  BrickMapType brickMap;
+  std::vector<Point3i> keys;
+  std::vector<std::vector<VOX_TYPE> > data;
+};
+
+} // end namespace vcg
+#endif
@@ -28,7 +28,10 @@
 #include <vcg/complex/algorithms/update/bounding.h>
 #include <vcg/complex/algorithms/update/component_ep.h>
 #include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <vcg/complex/algorithms/create/mc_parallel_walker.h>
+#include <vcg/complex/algorithms/create/narrow_band_volume.h>
 #include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/index/grid_triangle_soa.h>
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/box3.h>
 
@@ -65,28 +68,18 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 
 	protected:
 
-		int SliceSize;
-		int	CurrentSlice;
-		typedef tri::FaceTmark<Old_Mesh> MarkerFace;
-		MarkerFace markerFunctor;
-
-
-		VertexIndex *_x_cs; // indici dell'intersezioni della superficie lungo gli Xedge della fetta corrente
-		VertexIndex	*_y_cs; // indici dell'intersezioni della superficie lungo gli Yedge della fetta corrente
-		VertexIndex *_z_cs; // indici dell'intersezioni della superficie lungo gli Zedge della fetta corrente
-		VertexIndex *_x_ns; // indici dell'intersezioni della superficie lungo gli Xedge della prossima fetta
-		VertexIndex *_z_ns; // indici dell'intersezioni della superficie lungo gli Zedge della prossima fetta
-
-		//float *_v_cs;///values of distance fields for each direction in current slice
-		//float *_v_ns;///values of distance fields for each direction in next slice
-
 		typedef typename  std::pair<bool,float> field_value;
-		field_value* _v_cs;
-		field_value* _v_ns;
+
+		/// The distance field is computed only in the bricks of samples that are within max_dim from a face
+		/// (where it can be valid); the bricks are looked up through a table of all the brick coordinates.
+		NarrowBandVolume<field_value> _band;
+		std::vector<int> _brickTable;
+		int _brickNX, _brickNZ;
 
 		New_Mesh	*_newM;
 		Old_Mesh	*_oldM;
 		GridType _g;
+		GridTriangleSoA<GridType> _gTri; ///< triangles of _g packed for the vectorized closest point search
 
 	public:
 		float max_dim; // the limit value of the search (that takes into account of the offset)
@@ -100,22 +93,13 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 			this->siz=_siz;
 			ComputeDimAndVoxel();
 
-			SliceSize = (this->siz.X()+1)*(this->siz.Z()+1);
-			CurrentSlice = 0;
 			offset=0;
 			DiscretizeFlag=false;
 			MultiSampleFlag=false;
 			AbsDistFlag=false;
 
-			_x_cs = new VertexIndex[ SliceSize ];
-			_y_cs = new VertexIndex[ SliceSize ];
-			_z_cs = new VertexIndex[ SliceSize ];
-			_x_ns = new VertexIndex[ SliceSize ];
-			_z_ns = new VertexIndex[ SliceSize ];
-
-			_v_cs= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
-			_v_ns= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
-
+			_brickNX=(this->siz.X()>>NarrowBandVolume<field_value>::BrickShift)+1;
+			_brickNZ=(this->siz.Z()>>NarrowBandVolume<field_value>::BrickShift)+1;
 		};
 
 		~Walker()
@@ -130,16 +114,10 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 
 		std::pair<bool,float> VV(int x,int y,int z)
 		{
-			assert ((y==CurrentSlice)||(y==(CurrentSlice+1)));
-
-			//test if it is outside the bb of the mesh
-			//vcg::Point3f test=vcg::Point3f((float)x,(float)y,(float)z);
-			/*if (!_oldM->bbox.IsIn(test))
-				return (1.f);*/
-			int index=GetSliceIndex(x,z);
-
-			if (y==CurrentSlice) return _v_cs[index];
-		                 	else return _v_ns[index];
+			const int shift=NarrowBandVolume<field_value>::BrickShift;
+			const int bi=_brickTable[(x>>shift)+((z>>shift)+(y>>shift)*_brickNZ)*_brickNX];
+			if(bi<0) return _band.Background();
+			return _band.BrickData(bi)[NarrowBandVolume<field_value>::SampleIndex(x,y,z)];
 		}
 
 		float V(int x,int y,int z)
@@ -164,7 +142,7 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 			// while the PointDistanceFunctor requires them.
 
 			DISTFUNCTOR PDistFunct;
-			f = _g.GetClosest(PDistFunct,markerFunctor,testPt,max_dist,dist,closestPt);
+			f = GridClosestSoA(_g,_gTri,PDistFunct,testPt,max_dist,dist,closestPt);
 			if (f==NULL) return field_value(false,0);
 			if(AbsDistFlag) return field_value(true,dist);
 			assert(!f->IsD());
@@ -230,21 +208,57 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 			return field_value(true, distSum/MultiSample);
 		}
 
-		/// compute the values if an entire slice (per y) distances>dig of a cell are signed with double of
-		/// the distance of the bb
-		void ComputeSliceValues(int slice,field_value *slice_values)
+		/// Find the bricks of samples that can be within max_dim from a face: the distance field is
+		/// computed only there.
+		void ComputeBand()
 		{
-			for (int i=0; i<=this->siz.X(); i++)
+			_band.Init(this->siz,field_value(false,0));
+			// the multisampling moves the samples by a fraction of voxel
+			const float bandWidth = max_dim + this->voxel.Norm();
+			Box3i last;
+			for(typename FaceCont::iterator fi=_oldM->face.begin();fi!=_oldM->face.end();++fi)
+				if(!(*fi).IsD())
+				{
+					Box3f fb;
+					for(int i=0;i<3;++i) fb.Add(Point3f::Construct((*fi).cP(i)));
+					fb.Offset(bandWidth);
+					Box3i sb;
+					this->BoxToIBox(fb,sb);
+					sb.max+=Point3i(1,1,1);
+					if(sb==last) continue; // adjacent faces often cover the same samples
+					_band.AddBox(sb);
+					last=sb;
+				}
+			_band.Allocate(false);
+
+			const int brickNY=(this->siz.Y()>>NarrowBandVolume<field_value>::BrickShift)+1;
+			_brickTable.assign(_brickNX*brickNY*_brickNZ,-1);
+			for(int i=0;i<_band.BrickNum();++i)
 			{
-				for (int k=0; k<=this->siz.Z(); k++)
-					{
-						int index=GetSliceIndex(i,k);
-						Point3f pp(i,slice,k);
-						if(this->MultiSampleFlag) slice_values[index] = MultiDistanceFromMesh(pp,_oldM);
-																else	slice_values[index] = DistanceFromMesh(pp,_oldM);
-					}
+				const Point3i &bk=_band.BrickKey(i);
+				_brickTable[bk[0]+(bk[2]+bk[1]*_brickNZ)*_brickNX]=i;
+			}
+		}
+
+		/// compute the distance field in all the bricks of the band; the bricks are independent, so they are computed in parallel.
+		void ComputeField()
+		{
+			const int bs=NarrowBandVolume<field_value>::BrickSide;
+#pragma omp parallel for schedule(dynamic,1)
+			for(int b=0;b<_band.BrickNum();++b)
+			{
+				_band.AllocateBrick(b);
+				const Point3i o=_band.BrickKey(b)*bs;
+				field_value *data=_band.BrickData(b);
+				for(int k=o[2];k<std::min(o[2]+bs,this->siz.Z()+1);++k)
+					for(int j=o[1];j<std::min(o[1]+bs,this->siz.Y()+1);++j)
+						for(int i=o[0];i<std::min(o[0]+bs,this->siz.X()+1);++i)
+						{
+							Point3f pp(i,j,k);
+							if(this->MultiSampleFlag) data[NarrowBandVolume<field_value>::SampleIndex(i,j,k)] = MultiDistanceFromMesh(pp,_oldM);
+							else                      data[NarrowBandVolume<field_value>::SampleIndex(i,j,k)] = DistanceFromMesh(pp,_oldM);
+						}
 			}
-			//ComputeConsensus(slice,slice_values);
 		}
 
 		/*
@@ -299,29 +313,34 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 				qDebug("Flipped %i values in %i times",flippedTot,flippedTimes);
 #endif
 		}
-		template<class EXTRACTOR_TYPE>
-		void ProcessSlice(EXTRACTOR_TYPE &extractor)
+
+		//return the index of a vertex in slide as it was stored
+		int GetSliceIndex(int x,int z)
 		{
-			for (int i=0; i<this->siz.X(); i++)
-			{
-				for (int k=0; k<this->siz.Z(); k++)
-				{
-						bool goodCell=true;
-						Point3i p1(i,CurrentSlice,k);
-						Point3i p2=p1+Point3i(1,1,1);
-					  for(int ii=0;ii<2;++ii)
-							for(int jj=0;jj<2;++jj)
-								for(int kk=0;kk<2;++kk)
-									goodCell &= VV(p1[0]+ii,p1[1]+jj,p1[2]+kk).first;
-
-						if(goodCell) extractor.ProcessCell(p1, p2);
-				}
-			}
+			VertexIndex index = x+z*(this->siz.X()+1);
+			return (index);
 		}
 
+		/// The volume interface used by the ParallelWalker: ISize()+Val() and the Get[XYZ]Intercept() below.
+		/// The samples are the ones of the BasicGrid, siz+1 along each axis.
+		Point3i ISize() const { return this->siz+Point3i(1,1,1); }
 
-		template<class EXTRACTOR_TYPE>
-		void BuildMesh(Old_Mesh &old_mesh,New_Mesh &new_mesh,EXTRACTOR_TYPE &extractor,vcg::CallBackPos *cb)
+		float Val(int x,int y,int z) { return V(x,y,z); }
+
+		/// A cell is extracted only if the field is valid in all its corners
+		bool ValidCell(const Point3i &p1)
+		{
+			if(!VV(p1[0],p1[1],p1[2]).first) return false; // most of the cells are outside the band
+			for(int ii=0;ii<2;++ii)
+				for(int jj=0;jj<2;++jj)
+					for(int kk=0;kk<2;++kk)
+						if(!VV(p1[0]+ii,p1[1]+jj,p1[2]+kk).first) return false;
+			return true;
+		}
+
+		/// The field is computed in the whole band (in parallel over the bricks), then the cells are
+		/// extracted by a ParallelWalker, in blocks of slices processed by different threads.
+		void BuildMesh(Old_Mesh &old_mesh,New_Mesh &new_mesh,vcg::CallBackPos *cb)
 		{
 			_newM=&new_mesh;
 			_oldM=&old_mesh;
@@ -329,22 +348,23 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 			// the following two steps are required to be sure that the point-face distance without precomputed data works well.
 			tri::UpdateNormal<Old_Mesh>::PerFaceNormalized(old_mesh);
 			tri::UpdateNormal<Old_Mesh>::PerVertexAngleWeighted(old_mesh);
-			int _size=(int)old_mesh.fn*100;
+			// The vectorized search tests all the faces of a cell at once, so it prefers
+			// a few faces per cell over the very fine grid needed when faces are marked one by one.
+			int _size=(int)old_mesh.fn;
 
 			_g.Set(_oldM->face.begin(),_oldM->face.end(),_size);
-			markerFunctor.SetMesh(&old_mesh);
+			_gTri.Set(_g);
 
 			_newM->Clear();
 
-			Begin();
-			extractor.Initialize();
-      for (int j=0; j<=this->siz.Y(); j++)
-			{
-                if (cb) cb((100*j)/this->siz.Y(),"Marching ");
-				ProcessSlice<EXTRACTOR_TYPE>(extractor);//find cells where there is the isosurface and examine it
-        NextSlice();
-			}
-			extractor.Finalize();
+			ComputeBand();
+			if (cb) cb(0,"Computing distance field");
+			ComputeField();
+
+			ParallelWalker<New_Mesh,Walker> walker;
+			BandMarchingCubes mc(new_mesh,walker);
+			walker.BuildMesh(new_mesh,*this,mc,0.f,cb);
+			_band.Clear();
 			typename New_Mesh::VertexIterator vi;
 			for(vi=new_mesh.vert.begin();vi!=new_mesh.vert.end();++vi)
 				if(!(*vi).IsD())
@@ -353,132 +373,6 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 					}
 		}
 
-		//return the index of a vertex in slide as it was stored
-		int GetSliceIndex(int x,int z)
-		{
-			VertexIndex index = x+z*(this->siz.X()+1);
-			return (index);
-		}
-
-		//swap slices , the initial value of distance fields ids set as double of bbox of space
-		void NextSlice()
-		{
-
-			memset(_x_cs, -1, SliceSize*sizeof(VertexIndex));
-			memset(_y_cs, -1, SliceSize*sizeof(VertexIndex));
-			memset(_z_cs, -1, SliceSize*sizeof(VertexIndex));
-
-
-			std::swap(_x_cs, _x_ns);
-			std::swap(_z_cs, _z_ns);
-
-			std::swap(_v_cs, _v_ns);
-
-			CurrentSlice ++;
-
-			ComputeSliceValues(CurrentSlice + 1,_v_ns);
-		}
-
-		//initialize data strucures , the initial value of distance fields ids set as double of bbox of space
-		void Begin()
-		{
-
-			CurrentSlice = 0;
-
-			memset(_x_cs, -1, SliceSize*sizeof(VertexIndex));
-			memset(_y_cs, -1, SliceSize*sizeof(VertexIndex));
-			memset(_z_cs, -1, SliceSize*sizeof(VertexIndex));
-			memset(_x_ns, -1, SliceSize*sizeof(VertexIndex));
-			memset(_z_ns, -1, SliceSize*sizeof(VertexIndex));
-
-			ComputeSliceValues(CurrentSlice,_v_cs);
-			ComputeSliceValues(CurrentSlice+1,_v_ns);
-		}
-
-
-
-
-		bool Exist(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
-		{
-			int i = p1.X();// - _bbox.min.X())/_cell_size.X();
-			int z = p1.Z();// - _bbox.min.Z())/_cell_size.Z();
-			VertexIndex index = i+z*this->siz.X();
-
-			//VertexIndex index =GetSliceIndex(//
-			int v_ind = 0;
-			if (p1.X()!=p2.X()) //intersezione della superficie con un Xedge
-			{
-				if (p1.Y()==CurrentSlice)
-				{
-					if (_x_cs[index]!=-1)
-					{
-						v_ind = _x_cs[index];
-						v = &_newM->vert[v_ind];
-						assert(!v->IsD());
-						return true;
-					}
-
-				}
-				else
-				{
-					if (_x_ns[index]!=-1)
-					{
-						v_ind = _x_ns[index];
-						v = &_newM->vert[v_ind];
-						assert(!v->IsD());
-						return true;
-					}
-				}
-				v = NULL;
-				return false;
-			}
-			else if (p1.Y()!=p2.Y()) //intersezione della superficie con un Yedge
-			{
-				if (_y_cs[index]!=-1)
-				{
-					v_ind =_y_cs[index];
-					v = &_newM->vert[v_ind];
-					assert(!v->IsD());
-					return true;
-				}
-				else
-				{
-					v = NULL;
-					return false;
-				}
-
-			}
-			else if (p1.Z()!=p2.Z())
-			//intersezione della superficie con un Zedge
-			{
-				if (p1.Y()==CurrentSlice)
-				{
-					if ( _z_cs[index]!=-1)
-					{
-						v_ind = _z_cs[index];
-						v = &_newM->vert[v_ind];
-						assert(!v->IsD());
-						return true;
-					}
-
-				}
-				else
-				{
-					if (_z_ns[index]!=-1)
-					{
-						v_ind = _z_ns[index];
-						v = &_newM->vert[v_ind];
-						assert(!v->IsD());
-						return true;
-					}
-				}
-				v = NULL;
-				return false;
-			}
-			assert (0);
-			return false;
-		}
-
 		///interpolate
 		NewCoordType Interpolate(const vcg::Point3i &p1, const vcg::Point3i &p2,int dir)
 		{
@@ -490,106 +384,20 @@ template <class OLD_MESH_TYPE,class NEW_MESH_TYPE, class FLT, class DISTFUNCTOR
 			return (ret);
 		}
 
-		///if there is a vertex in z axis of a cell return the vertex or create it
-		void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+		///set the position (in grid coordinates) of the vertex on an edge, created by the ParallelWalker
+		void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v, float /*thr*/)
 		{
-      assert(p1.X()+1 == p2.X());
-			assert(p1.Y()   == p2.Y());
-			assert(p1.Z()   == p2.Z());
-
-			int i = p1.X();// (p1.X() - _bbox.min.X())/_cell_size.X();
-			int z = p1.Z();//(p1.Z() - _bbox.min.Z())/_cell_size.Z();
-			VertexIndex index = i+z*this->siz.X();
-      VertexIndex pos=-1;
-			if (p1.Y()==CurrentSlice)
-			{
-				if ((pos=_x_cs[index])==-1)
-				{
-					_x_cs[index] = (VertexIndex) _newM->vert.size();
-					pos = _x_cs[index];
-					Allocator<New_Mesh>::AddVertices( *_newM, 1 );
-					v = &_newM->vert[pos];
-					v->P()=Interpolate(p1,p2,0);
-					return;
-				}
-			}
-			if (p1.Y()==CurrentSlice+1)
-			{
-				if ((pos=_x_ns[index])==-1)
-				{
-					_x_ns[index] = (VertexIndex) _newM->vert.size();
-					pos = _x_ns[index];
-					Allocator<New_Mesh>::AddVertices( *_newM, 1 );
-					v = &_newM->vert[pos];
-					v->P()=Interpolate(p1,p2,0);
-					return;
-				}
-			}
-      assert(pos>=0);
-			v = &_newM->vert[pos];
+			v->P()=Interpolate(p1,p2,0);
 		}
 
-		///if there is a vertex in y axis of a cell return the vertex or create it
-		void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+		void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v, float /*thr*/)
 		{
-      assert(p1.X()   == p2.X());
-			assert(p1.Y()+1 == p2.Y());
-			assert(p1.Z()   == p2.Z());
-
-			int i = p1.X(); // (p1.X() - _bbox.min.X())/_cell_size.X();
-			int z = p1.Z(); // (p1.Z() - _bbox.min.Z())/_cell_size.Z();
-			VertexIndex index = i+z*this->siz.X();
-      VertexIndex pos=-1;
-			if ((pos=_y_cs[index])==-1)
-			{
-				_y_cs[index] = (VertexIndex) _newM->vert.size();
-				pos = _y_cs[index];
-				Allocator<New_Mesh>::AddVertices( *_newM, 1);
-				v = &_newM->vert[ pos ];
-				v->P()=Interpolate(p1,p2,1);
-			}
-      assert(pos>=0);
-      v = &_newM->vert[pos];
+			v->P()=Interpolate(p1,p2,1);
 		}
 
-		///if there is a vertex in z axis of a cell return the vertex or create it
-		void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+		void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v, float /*thr*/)
 		{
-      assert(p1.X()   == p2.X());
-			assert(p1.Y()   == p2.Y());
-			assert(p1.Z()+1 == p2.Z());
-
-			int i = p1.X(); //(p1.X() - _bbox.min.X())/_cell_size.X();
-			int z = p1.Z(); //(p1.Z() - _bbox.min.Z())/_cell_size.Z();
-			VertexIndex index = i+z*this->siz.X();
-
-      VertexIndex pos=-1;
-			if (p1.Y()==CurrentSlice)
-			{
-				if ((pos=_z_cs[index])==-1)
-				{
-					_z_cs[index] = (VertexIndex) _newM->vert.size();
-					pos = _z_cs[index];
-					Allocator<New_Mesh>::AddVertices( *_newM, 1 );
-					v = &_newM->vert[pos];
-					v->P()=Interpolate(p1,p2,2);
-					return;
-				}
-			}
-			if (p1.Y()==CurrentSlice+1)
-			{
-				if ((pos=_z_ns[index])==-1)
-				{
-					_z_ns[index] = (VertexIndex) _newM->vert.size();
-					pos = _z_ns[index];
-					Allocator<New_Mesh>::AddVertices( *_newM, 1 );
-					v = &_newM->vert[pos];
-					v->P()=Interpolate(p1,p2,2);
-					return;
-				}
-			}
-      assert(pos>=0);
-			v = &_newM->vert[pos];
+			v->P()=Interpolate(p1,p2,2);
 		}
 
 	};//end class walker
@@ -598,7 +406,20 @@ public:
 
 typedef Walker  /*< Old_Mesh,New_Mesh>*/  MyWalker;
 
-typedef vcg::tri::MarchingCubes<New_Mesh, MyWalker> MyMarchingCubes;
+/// Marching cubes on the blocks of the ParallelWalker that skips the cells outside the band
+class BandMarchingCubes : public vcg::tri::MarchingCubes<New_Mesh, ParallelWalker<New_Mesh,Walker> >
+{
+	typedef vcg::tri::MarchingCubes<New_Mesh, ParallelWalker<New_Mesh,Walker> > Base;
+	Walker &_volume;
+public:
+	BandMarchingCubes(New_Mesh &mesh, ParallelWalker<New_Mesh,Walker> &walker):Base(mesh,walker),_volume(walker.Volume()) {}
+	void ProcessCell(const vcg::Point3i &p1, const vcg::Point3i &p2)
+	{
+		if(_volume.ValidCell(p1)) Base::ProcessCell(p1,p2);
+	}
+};
+
+typedef BandMarchingCubes MyMarchingCubes;
 
 ///resample the mesh using marching cube algorithm ,the accuracy is the dimension of one cell the parameter
 static void Resample(Old_Mesh &old_mesh,New_Mesh &new_mesh,  Box3f volumeBox, vcg::Point3<int> accuracy,float max_dist, float thr=0, bool DiscretizeFlag=false, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0 )
@@ -613,8 +434,7 @@ static void Resample(Old_Mesh &old_mesh,New_Mesh &new_mesh,  Box3f volumeBox, vc
 	walker.DiscretizeFlag = DiscretizeFlag;
 	walker.MultiSampleFlag = MultiSampleFlag;
 	walker.AbsDistFlag = AbsDistFlag;
-	MyMarchingCubes mc(new_mesh, walker);
-	walker.BuildMesh(old_mesh,new_mesh,mc,cb);
+	walker.BuildMesh(old_mesh,new_mesh,cb);
 }
 
 
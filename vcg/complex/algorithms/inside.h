@@ -79,7 +79,7 @@ namespace vcg {
 				{
 					ScalarType dist;
 					CoordType Norm, ip, nearest;
-					FaceType *f = vcg::tri::GetClosestFace< TriMeshType, FaceSpatialIndexing >( m, _g_mesh, test, m.bbox.Diag(), dist, nearest, Norm, ip );
+					FaceType *f = vcg::tri::GetClosestFaceEP< TriMeshType, FaceSpatialIndexing >( m, _g_mesh, test, m.bbox.Diag(), dist, nearest, Norm, ip );
 					assert( f != NULL );			/// Check if there is any face in the mesh
 					/// If the point is on the face is considered inside.
 					if( ( test - nearest ).Norm() <= EPSILON ) return true;
@@ -109,7 +109,218 @@ namespace vcg {
 			}
 
 		}; // end class
+
+		/** Inside/outside classification with the generalized winding number.
+
+		The winding number of a point is the sum of the signed solid angles of the faces seen from it,
+		divided by 4*pi: it is 1 inside and 0 outside a closed and coherently oriented mesh, and it
+		degrades gracefully (to values between 0 and 1) when the mesh has holes, cracks or
+		self intersections, where the closest face and ray based tests give random answers.
+		The points with a winding number greater than 0.5 are considered inside.
+
+		The faces are stored in a bounding volume hierarchy; every node keeps the area weighted
+		center and the sum of the area weighted normals (the dipole) of its faces, so that a node far
+		from the query point (farther than Beta times its radius) is evaluated as a single dipole
+		instead of visiting its faces (the fast winding numbers of Barill et al., SIGGRAPH 2018).
+		The mesh is copied by Init(), so it can change after that; the queries are const and
+		WindingNumbers() evaluates a batch of points in parallel.
+		\code
+		tri::WindingNumber<MyMesh> wn;
+		wn.Init(m);
+		wn.WindingNumbers(points,w);   // or wn.IsInside(p)
+		\endcode
+		*/
+		template <class TriMeshType>
+		class WindingNumber
+		{
+		public:
+			typedef typename TriMeshType::ScalarType ScalarType;
+			typedef typename TriMeshType::CoordType CoordType;
+			typedef typename TriMeshType::FaceIterator FaceIterator;
+
+			/// Accuracy parameter: a node is approximated when the query point is farther than Beta times
+			/// its radius. Greater values are more accurate and slower; with 2 the error is a few hundredths,
+			/// far from the 0.5 threshold of IsInside(); 4 keeps it below 0.01.
+			ScalarType Beta;
+
+			WindingNumber():Beta(2) {}
+
+			void Init(TriMeshType &m, int leafSize=8)
+			{
+				tri.clear();
+				for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+					if(!(*fi).IsD())
+					{
+						tri.push_back((*fi).cP(0));
+						tri.push_back((*fi).cP(1));
+						tri.push_back((*fi).cP(2));
+					}
+				const int fn=int(tri.size()/3);
+				std::vector<CoordType> center(fn);
+				std::vector<int> order(fn);
+				for(int i=0;i<fn;++i)
+				{
+					center[i]=(tri[3*i]+tri[3*i+1]+tri[3*i+2])/ScalarType(3);
+					order[i]=i;
+				}
+				node.clear();
+				node.reserve(4*(fn/std::max(1,leafSize)+1));
+				if(fn>0)
+				{
+					node.resize(1);
+					BuildNode(order,center,0,0,fn,std::max(1,leafSize));
+				}
+				// triangles in leaf order, so the leaves read consecutive memory
+				std::vector<CoordType> sorted(tri.size());
+				for(int i=0;i<fn;++i)
+					for(int j=0;j<3;++j)
+						sorted[3*i+j]=tri[3*order[i]+j];
+				tri.swap(sorted);
+			}
+
+			/// Generalized winding number of a point
+			ScalarType WindingNumberOf(const CoordType &q) const
+			{
+				if(node.empty()) return 0;
+				double w=0;
+				int stack[64];
+				int top=0;
+				stack[top++]=0;
+				while(top>0)
+				{
+					const Node &n=node[stack[--top]];
+					const CoordType d=n.center-q;
+					const ScalarType dist2=d.SquaredNorm();
+					if(dist2 > Beta*Beta*n.radius*n.radius)
+					{
+						const double dist=sqrt(double(dist2));
+						w+= double(n.dipole.dot(d))/(dist*dist*dist);
+					}
+					else if(n.count>0)
+					{
+						for(int i=n.first;i<n.first+n.count;++i)
+							w+=SolidAngle(tri[3*i],tri[3*i+1],tri[3*i+2],q);
+					}
+					else
+					{
+						stack[top++]=n.first;
+						stack[top++]=n.first+1;
+					}
+				}
+				return ScalarType(w/(4.0*M_PI));
+			}
+
+			bool IsInside(const CoordType &q) const { return WindingNumberOf(q)>0.5; }
+
+			/// Winding numbers of a batch of points, computed in parallel
+			void WindingNumbers(const std::vector<CoordType> &pts, std::vector<ScalarType> &w) const
+			{
+				w.resize(pts.size());
+#pragma omp parallel for schedule(dynamic,256)
+				for(int i=0;i<int(pts.size());++i)
+					w[i]=WindingNumberOf(pts[i]);
+			}
+
+			/// Inside (1) or outside (0) flags of a batch of points, computed in parallel
+			void Classify(const std::vector<CoordType> &pts, std::vector<char> &inside) const
+			{
+				inside.resize(pts.size());
+#pragma omp parallel for schedule(dynamic,256)
+				for(int i=0;i<int(pts.size());++i)
+					inside[i]=IsInside(pts[i]) ? 1 : 0;
+			}
+
+		protected:
+			// Internal nodes have count==0 and the two children in first and first+1;
+			// leaves have the triangles [first,first+count).
+			struct Node
+			{
+				CoordType center;  // area weighted center of the faces
+				CoordType dipole;  // sum of the area weighted normals
+				ScalarType area;
+				ScalarType radius; // max distance of a face vertex from center
+				int first;
+				int count;
+			};
+			std::vector<CoordType> tri;
+			std::vector<Node> node;
+
+			// Signed solid angle of a triangle seen from q (Van Oosterom and Strackee)
+			static double SolidAngle(const CoordType &p0, const CoordType &p1, const CoordType &p2, const CoordType &q)
+			{
+				const Point3<double> a=Point3<double>::Construct(p0-q), b=Point3<double>::Construct(p1-q), c=Point3<double>::Construct(p2-q);
+				const double la=a.Norm(), lb=b.Norm(), lc=c.Norm();
+				const double num=a.dot(b^c);
+				const double den=la*lb*lc + a.dot(b)*lc + b.dot(c)*la + c.dot(a)*lb;
+				return 2.0*atan2(num,den);
+			}
+
+			// Fill node ni (already allocated) with the faces order[begin,end)
+			void BuildNode(std::vector<int> &order, const std::vector<CoordType> &center, int ni, int begin, int end, int leafSize)
+			{
+				if(end-begin<=leafSize)
+				{
+					double area=0;
+					Point3<double> c(0,0,0), dp(0,0,0);
+					for(int i=begin;i<end;++i)
+					{
+						const int t=order[i];
+						const CoordType an=((tri[3*t+1]-tri[3*t])^(tri[3*t+2]-tri[3*t]))/ScalarType(2);
+						const double a=an.Norm();
+						area+=a;
+						c+=Point3<double>::Construct(center[t])*a;
+						dp+=Point3<double>::Construct(an);
+					}
+					if(area>0) c/=area;
+					else
+					{
+						for(int i=begin;i<end;++i) c+=Point3<double>::Construct(center[order[i]]);
+						c/=double(end-begin);
+					}
+					Node &n=node[ni];
+					n.first=begin;
+					n.count=end-begin;
+					n.area=ScalarType(area);
+					n.center=CoordType::Construct(c);
+					n.dipole=CoordType::Construct(dp);
+					n.radius=0;
+					for(int i=begin;i<end;++i)
+						for(int j=0;j<3;++j)
+							n.radius=std::max(n.radius,Distance(n.center,tri[3*order[i]+j]));
+					return;
+				}
+				// split at the median of the centers along the longest side of their box
+				Box3<ScalarType> cb;
+				for(int i=begin;i<end;++i) cb.Add(center[order[i]]);
+				const int axis=cb.MaxDim();
+				const int mid=(begin+end)/2;
+				std::nth_element(order.begin()+begin,order.begin()+mid,order.begin()+end,CenterLess(center,axis));
+				const int c0=int(node.size());
+				node.resize(c0+2);
+				BuildNode(order,center,c0,begin,mid,leafSize);
+				BuildNode(order,center,c0+1,mid,end,leafSize);
+				// the dipole of the node is the sum of the children ones, the center their area weighted mean
+				const Node &n0=node[c0], &n1=node[c0+1];
+				Node &n=node[ni];
+				n.first=c0;
+				n.count=0;
+				n.area=n0.area+n1.area;
+				n.dipole=n0.dipole+n1.dipole;
+				n.center=(n.area>0) ? (n0.center*n0.area+n1.center*n1.area)/n.area : (n0.center+n1.center)/ScalarType(2);
+				n.radius=std::max(Distance(n.center,n0.center)+n0.radius,Distance(n.center,n1.center)+n1.radius);
+			}
+
+			class CenterLess
+			{
+			public:
+				CenterLess(const std::vector<CoordType> &_c, int _axis):c(_c),axis(_axis) {}
+				bool operator()(int a, int b) const { return c[a][axis]<c[b][axis]; }
+			private:
+				const std::vector<CoordType> &c;
+				int axis;
+			};
+		}; // end class WindingNumber
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
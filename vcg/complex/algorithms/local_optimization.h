@@ -119,8 +119,12 @@ class LocalModification
         typedef typename MeshType::ScalarType ScalarType;
 
 
-  inline LocalModification(){}
+  inline LocalModification(){heapPos=-1;}
   virtual ~LocalModification(){}
+
+  /// Position of the operation in the heap.
+  /// It is kept up to date only when the addressable heap is used (see UseAddressableHeap())
+  int heapPos;
   
 	/// return the type of operation
 	virtual ModifierType IsOfType() = 0 ;
@@ -150,9 +154,21 @@ class LocalModification
     /// while for non symmetric edge collapse a larger number like 9 is a better choice
   static float HeapSimplexRatio(BaseParameterClass *) {return 6.0f;}
 
+  /// Return true if the modification keeps the heap as an addressable heap.
+  /// In this case, instead of pushing new operations and leaving the out of date ones in the heap, UpdateHeap() must
+  /// remove, re-evaluate and insert operations with LocalOptimization::HeapRemove/HeapUpdate/HeapInsert, so
+  /// that the heap contains only valid operations and no ClearHeap() is ever needed.
+  static bool UseAddressableHeap(BaseParameterClass *) {return false;}
+
   virtual const char *Info(MeshType &) {return 0;}
 	/// Update the heap as a consequence of this operation
   virtual void UpdateHeap(HeapType&, BaseParameterClass *pp)=0;
+
+  /// Used by the batched optimization to find operations that can be processed concurrently.
+  /// Fill rv with the vertices read and wv with the vertices written by Execute() and UpdateHeap().
+  /// Two operations are put in the same batch only if the written vertices of each one are not touched by the other.
+  /// Return false (the default) if the operation must always be performed alone.
+  virtual bool BatchSupport(std::vector<typename MeshType::VertexPointer> &/*rv*/, std::vector<typename MeshType::VertexPointer> &/*wv*/) {return false;}
 };	//end class local modification
 
 
@@ -167,7 +183,7 @@ template<class MeshType>
 class LocalOptimization
 {
 public:
-  LocalOptimization(MeshType &mm, BaseParameterClass *_pp): m(mm){ ClearTermination();e=0.0;HeapSimplexRatio=5; pp=_pp;}
+  LocalOptimization(MeshType &mm, BaseParameterClass *_pp): m(mm){ ClearTermination();e=0.0;HeapSimplexRatio=5; pp=_pp; batchSize=0; addressable=false;}
 
 	struct  HeapElem;
 	// scalar type
@@ -208,6 +224,14 @@ public:
 
   float HeapSimplexRatio; 
 
+  // The max number of independent operations extracted from the heap at each step of the batched optimization.
+  // When zero (the default) the operations are performed one at a time.
+  int batchSize;
+
+  // True if the heap is kept as an addressable heap (decided at Init() by the local modification type).
+  // Addressable heap updates are not batched: the operations are performed one at a time.
+  bool addressable;
+
 	void SetTerminationFlag		(int v){tf |= v;}
 	void ClearTerminationFlag	(int v){tf &= ~v;}
 	bool IsTerminationFlag		(int v){return ((tf & v)!=0);}
@@ -219,6 +243,8 @@ public:
 	void SetTargetMetric	(ScalarType tm	){targetMetric		= tm;	SetTerminationFlag(LOMetric);		} 
 	void SetTimeBudget		(float tb		){timeBudget		= tb;	SetTerminationFlag(LOTime);			} 
 
+	void SetBatchSize			(int bs			){batchSize			= bs;	}
+
   void ClearTermination()
   {
     tf=0;
@@ -285,6 +311,8 @@ public:
   /// main cycle of optimization
   bool DoOptimization()
   {
+    if(addressable) return DoOptimizationAddressable();
+    if(batchSize>0) return DoOptimizationBatched();
     start=clock();
 		nPerfmormedOps =0;
 		while( !GoalReached() && !h.empty())
@@ -311,6 +339,133 @@ public:
 			}
 		return !(h.empty());
   }
+
+  /// main cycle of optimization when the heap is addressable
+  // the heap contains only up to date operations, so there is no heap clearing
+  bool DoOptimizationAddressable()
+  {
+    start=clock();
+    nPerfmormedOps =0;
+    while( !GoalReached() && !h.empty())
+    {
+      LocModPtrType  locMod = h.front().locModPtr;
+      currMetric=h.front().pri;
+      HeapRemove(h,locMod);
+      if( locMod->IsUpToDate() && locMod->IsFeasible(this->pp) )
+      {
+        nPerfmormedOps++;
+        locMod->Execute(m,this->pp);
+        locMod->UpdateHeap(h,this->pp);
+      }
+      delete locMod;
+    }
+    return !(h.empty());
+  }
+
+  /// batched cycle of optimization
+  // At each step up to batchSize operations with non overlapping supports (see LocalModification::BatchSupport)
+  // are extracted from the heap in priority order and performed; then the heap updates of the touched
+  // neighbourhoods, that are the costly part (e.g. the evaluation of the priorities of the new collapses),
+  // are computed concurrently when OpenMP is available and merged in the extraction order.
+  // Termination conditions are tested before each single operation as in the plain cycle.
+  bool DoOptimizationBatched()
+  {
+    typedef typename MeshType::VertexPointer VertexPointer;
+    start=clock();
+    nPerfmormedOps =0;
+
+    std::vector<int> readStamp(m.vert.size(),0);
+    std::vector<int> writeStamp(m.vert.size(),0);
+    std::vector<HeapElem> batch,deferred;
+    std::vector<HeapType> batchHeap;
+    std::vector<VertexPointer> rv,wv;
+    int stamp=0;
+
+    while( !GoalReached() && !h.empty())
+    {
+      if(h.size()> m.SimplexNumber()*HeapSimplexRatio )  ClearHeap();
+      ++stamp;
+      batch.clear();
+      deferred.clear();
+
+      // 1) Selection of a set of independent operations.
+      // The conflicting ones are put back in the heap; the selection stops when they become too many
+      // with respect to the selected ones, to avoid to scan the heap for nothing.
+      while( int(batch.size())<batchSize && deferred.size()<=batch.size()/4 && !h.empty())
+      {
+        std::pop_heap(h.begin(),h.end());
+        HeapElem he=h.back();
+        h.pop_back();
+        if( !he.locModPtr->IsUpToDate() || !he.locModPtr->IsFeasible(this->pp) )
+        {
+          delete he.locModPtr;
+          continue;
+        }
+        rv.clear(); wv.clear();
+        if(!he.locModPtr->BatchSupport(rv,wv))
+        { // an operation that cannot be batched is performed alone
+          if(batch.empty()) batch.push_back(he);
+                       else deferred.push_back(he);
+          break;
+        }
+        bool conflict=false;
+        for(size_t i=0;i<rv.size() && !conflict;++i)
+          if(writeStamp[tri::Index(m,rv[i])]==stamp) conflict=true;
+        for(size_t i=0;i<wv.size() && !conflict;++i)
+          if(readStamp[tri::Index(m,wv[i])]==stamp || writeStamp[tri::Index(m,wv[i])]==stamp) conflict=true;
+        if(conflict)
+        {
+          deferred.push_back(he);
+          continue;
+        }
+        for(size_t i=0;i<rv.size();++i) readStamp[tri::Index(m,rv[i])]=stamp;
+        for(size_t i=0;i<wv.size();++i) writeStamp[tri::Index(m,wv[i])]=stamp;
+        batch.push_back(he);
+        if(IsTerminationFlag(LOMetric) && he.pri > targetMetric) break;
+      }
+
+      // 2) Execution, in extraction order, checking the termination conditions before each operation
+      size_t ne=0;
+      while(ne<batch.size() && !GoalReached())
+      {
+        currMetric=batch[ne].pri;
+        nPerfmormedOps++;
+        batch[ne].locModPtr->Execute(m,this->pp);
+        ++ne;
+      }
+
+      // 3) Heap update of the touched neighbourhoods; it is done concurrently on separate heaps
+      if(batchHeap.size()<ne) batchHeap.resize(ne);
+#pragma omp parallel for schedule(dynamic,16)
+      for(int i=0;i<int(ne);++i)
+      {
+        batchHeap[i].clear();
+        batch[i].locModPtr->UpdateHeap(batchHeap[i],this->pp);
+      }
+      for(size_t i=0;i<ne;++i)
+      {
+        for(size_t j=0;j<batchHeap[i].size();++j)
+        {
+          h.push_back(batchHeap[i][j]);
+          std::push_heap(h.begin(),h.end());
+        }
+        delete batch[i].locModPtr;
+      }
+
+      // 4) the operations that have not been performed go back in the heap
+      for(size_t i=ne;i<batch.size();++i)
+      {
+        h.push_back(batch[i]);
+        std::push_heap(h.begin(),h.end());
+      }
+      for(size_t i=0;i<deferred.size();++i)
+      {
+        h.push_back(deferred[i]);
+        std::push_heap(h.begin(),h.end());
+      }
+    }
+    return !(h.empty());
+  }
  
 // It removes from the heap all the operations that are no more 'uptodate' 
 // (e.g. collapses that have some recently modified vertices)
@@ -350,8 +505,11 @@ void ClearHeap()
     // The expected size of heap depends on the type of the local modification we are using..
     HeapSimplexRatio = LocalModificationType::HeapSimplexRatio(pp);
 		
+    addressable = LocalModificationType::UseAddressableHeap(pp);
+
     LocalModificationType::Init(m,h,pp);
-    std::make_heap(h.begin(),h.end());
+    if(addressable) HeapMake(h);
+               else std::make_heap(h.begin(),h.end());
     if(!h.empty()) currMetric=h.front().pri;
 	}
 
@@ -362,6 +520,86 @@ void ClearHeap()
 	}
 
 
+  /// Addressable heap management.
+  // The heap has the same layout of the std heap (the first element is the one with the lowest priority) but
+  // each operation knows its position (heapPos), so it can be removed or re-sorted when its priority changes.
+
+  /// build the addressable heap from an unordered vector of operations
+  static void HeapMake(HeapType &h)
+  {
+    for(size_t i=0;i<h.size();++i)
+      h[i].locModPtr->heapPos=int(i);
+    for(int i=int(h.size())/2-1;i>=0;--i)
+      HeapSiftDown(h,i);
+  }
+
+  /// insert a new operation in the addressable heap
+  static void HeapInsert(HeapType &h, LocModPtrType lm)
+  {
+    h.push_back(HeapElem(lm));
+    lm->heapPos=int(h.size())-1;
+    HeapSiftUp(h,lm->heapPos);
+  }
+
+  /// update the position of an operation whose priority has been re-computed (increase/decrease key)
+  static void HeapUpdate(HeapType &h, LocModPtrType lm)
+  {
+    int i=lm->heapPos;
+    assert(i>=0 && i<int(h.size()) && h[i].locModPtr==lm);
+    h[i].pri=float(lm->Priority());
+    HeapSiftUp(h,i);
+    HeapSiftDown(h,lm->heapPos);
+  }
+
+  /// remove an operation from the addressable heap (it does not delete it)
+  static void HeapRemove(HeapType &h, LocModPtrType lm)
+  {
+    int i=lm->heapPos;
+    assert(i>=0 && i<int(h.size()) && h[i].locModPtr==lm);
+    lm->heapPos=-1;
+    if(i==int(h.size())-1) { h.pop_back(); return; }
+    LocModPtrType moved=h.back().locModPtr;
+    h[i]=h.back();
+    h.pop_back();
+    moved->heapPos=i;
+    HeapSiftUp(h,i);
+    HeapSiftDown(h,moved->heapPos);
+  }
+
+private:
+  static void HeapSiftUp(HeapType &h, int i)
+  {
+    HeapElem he=h[i];
+    while(i>0)
+    {
+      int parent=(i-1)/2;
+      if(!(h[parent] < he)) break;
+      h[i]=h[parent];
+      h[i].locModPtr->heapPos=i;
+      i=parent;
+    }
+    h[i]=he;
+    he.locModPtr->heapPos=i;
+  }
+
+  static void HeapSiftDown(HeapType &h, int i)
+  {
+    HeapElem he=h[i];
+    int n=int(h.size());
+    while(2*i+1<n)
+    {
+      int child=2*i+1;
+      if(child+1<n && h[child] < h[child+1]) ++child;
+      if(!(he < h[child])) break;
+      h[i]=h[child];
+      h[i].locModPtr->heapPos=i;
+      i=child;
+    }
+    h[i]=he;
+    he.locModPtr->heapPos=i;
+  }
+
+public:
 	/// say if the process is to end or not: the process ends when any of the termination conditions is verified
 	/// override this function to implemetn other tests
 	bool GoalReached(){
@@ -87,10 +87,71 @@ protected:
 	/// priority in the heap
 	ScalarType _priority;
 
+  /// Addressable heap support.
+  /// When the heap is addressable each collapse is referenced by the faces sharing its edge, in a temporary
+  /// per face-edge table (one slot per edge, two when the collapse is not symmetric, one for each direction),
+  /// so that after a collapse the ones around the involved vertices can be found and updated in place.
+  static std::vector<TriEdgeCollapse *> &EdgeOps(){ static std::vector<TriEdgeCollapse *> eo; return eo;}
+  static FaceType *&EdgeOpsBase(){ static FaceType *fb=0; return fb;}
+  static int &EdgeOpsStride(){ static int st=3; return st;}
+  static bool HasEdgeOps(){ return !EdgeOps().empty();}
+
+  static void InitEdgeOps(TriMeshType &m, bool symmetric)
+  {
+    EdgeOpsStride() = symmetric ? 3 : 6;
+    EdgeOps().assign(m.face.size()*EdgeOpsStride(),(TriEdgeCollapse *)0);
+    EdgeOpsBase() = m.face.empty() ? 0 : &m.face[0];
+  }
+
+  static void ClearEdgeOps()
+  {
+    std::vector<TriEdgeCollapse *>().swap(EdgeOps());
+    EdgeOpsBase()=0;
+  }
+
+  /// the slot of the face f for the collapse along its edge z; dir is 1 if it goes from V1(z) to V(z)
+  static TriEdgeCollapse *&EdgeOp(FaceType *f, int z, int dir)
+  {
+    const int st=EdgeOpsStride();
+    return EdgeOps()[(f-EdgeOpsBase())*st + z*(st/3) + (st==6?dir:0)];
+  }
+
+  /// return the collapse a->b (or b->a if the collapse is symmetric) or zero if it has not been found
+  static TriEdgeCollapse *FindOp(VertexType *a, VertexType *b)
+  {
+    for(vcg::face::VFIterator<FaceType> vfi(a);!vfi.End();++vfi)
+    {
+      if(vfi.V1()==b && EdgeOp(vfi.F(),vfi.I(),0)!=0)         return EdgeOp(vfi.F(),vfi.I(),0);
+      if(vfi.V2()==b && EdgeOp(vfi.F(),(vfi.I()+2)%3,1)!=0)   return EdgeOp(vfi.F(),(vfi.I()+2)%3,1);
+    }
+    return 0;
+  }
+
+  /// set all the slots of the collapse a->b to op
+  static void SetOp(VertexType *a, VertexType *b, TriEdgeCollapse *op)
+  {
+    for(vcg::face::VFIterator<FaceType> vfi(a);!vfi.End();++vfi)
+    {
+      if(vfi.V1()==b) EdgeOp(vfi.F(),vfi.I(),0)=op;
+      if(vfi.V2()==b) EdgeOp(vfi.F(),(vfi.I()+2)%3,1)=op;
+    }
+  }
+
+  void LinkOp() { SetOp(pos.V(0),pos.V(1),this); }
+
+  // the collapses with a deleted vertex have already been removed from the table (see the quadric UpdateHeap)
+  void UnlinkOp()
+  {
+    if(pos.V(0)->IsD() || pos.V(1)->IsD()) return;
+    if(FindOp(pos.V(0),pos.V(1))==this) SetOp(pos.V(0),pos.V(1),0);
+  }
+
 	public:
 	/// Default Constructor
 	inline	TriEdgeCollapse()
-			{}
+			{
+        pos.V(0)=0; pos.V(1)=0;
+      }
 	///Constructor with postype
    inline TriEdgeCollapse(const VertexPair &p, int mark, BaseParameterClass *pp)
 			{    
@@ -100,7 +161,9 @@ protected:
 			}
 
 		~TriEdgeCollapse()
-			{}
+			{
+        if(HasEdgeOps() && pos.V(0)!=0) UnlinkOp();
+      }
 
 private:
 
@@ -134,10 +197,12 @@ public:
 
   inline  void UpdateHeap(HeapType & h_ret, BaseParameterClass *pp)
   {
-    GlobalMark()++;
+    int mark;
+#pragma omp critical (TriEdgeCollapseGlobalMark)
+    mark = ++GlobalMark();
     VertexType *v[2];
     v[0]= pos.V(0);v[1]=pos.V(1);
-    v[1]->IMark() = GlobalMark();
+    v[1]->IMark() = mark;
 
     // First loop around the remaining vertex to unmark visited flags
     vcg::face::VFIterator<FaceType> vfi(v[1]);
@@ -156,20 +221,20 @@ public:
       if( !(vfi.V1()->IsV()) && (vfi.V1()->IsRW()))
       {
         vfi.V1()->SetV();
-        h_ret.push_back(HeapElem(new MYTYPE(VertexPair( vfi.V(),vfi.V1() ),GlobalMark(),pp)));
+        h_ret.push_back(HeapElem(new MYTYPE(VertexPair( vfi.V(),vfi.V1() ),mark,pp)));
         std::push_heap(h_ret.begin(),h_ret.end());
         if(! this->IsSymmetric(pp)){
-          h_ret.push_back(HeapElem(new MYTYPE(VertexPair( vfi.V1(),vfi.V()),GlobalMark(),pp)));
+          h_ret.push_back(HeapElem(new MYTYPE(VertexPair( vfi.V1(),vfi.V()),mark,pp)));
           std::push_heap(h_ret.begin(),h_ret.end());
         }
       }
       if(  !(vfi.V2()->IsV()) && (vfi.V2()->IsRW()))
       {
         vfi.V2()->SetV();
-        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.F()->V(vfi.I()),vfi.F()->V2(vfi.I())),GlobalMark(),pp)));
+        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.F()->V(vfi.I()),vfi.F()->V2(vfi.I())),mark,pp)));
         std::push_heap(h_ret.begin(),h_ret.end());
         if(! this->IsSymmetric(pp)){
-          h_ret.push_back(HeapElem(new MYTYPE(VertexPair (vfi.F()->V1(vfi.I()),vfi.F()->V(vfi.I())),GlobalMark(),pp)));
+          h_ret.push_back(HeapElem(new MYTYPE(VertexPair (vfi.F()->V1(vfi.I()),vfi.F()->V(vfi.I())),mark,pp)));
           std::push_heap(h_ret.begin(),h_ret.end());
         }
       }
@@ -186,6 +251,29 @@ public:
     } // end while
   }
 
+  // The collapse and the re-evaluation of the new collapses in UpdateHeap() move (temporarily) and flag
+  // the vertices of the one ring of the edge and read the vertices up to its two ring.
+  virtual bool BatchSupport(std::vector<VertexType *> &rv, std::vector<VertexType *> &wv)
+  {
+    for(int i=0;i<2;++i)
+      for(vcg::face::VFIterator<FaceType> vfi(pos.V(i));!vfi.End();++vfi)
+      {
+        wv.push_back(vfi.V());
+        wv.push_back(vfi.V1());
+        wv.push_back(vfi.V2());
+      }
+    std::sort(wv.begin(),wv.end());
+    wv.erase(std::unique(wv.begin(),wv.end()),wv.end());
+    for(size_t i=0;i<wv.size();++i)
+      for(vcg::face::VFIterator<FaceType> vfi(wv[i]);!vfi.End();++vfi)
+      {
+        rv.push_back(vfi.V1());
+        rv.push_back(vfi.V2());
+      }
+    rv.insert(rv.end(),wv.begin(),wv.end());
+    return true;
+  }
+
   ModifierType IsOfType(){ return TriEdgeCollapseOp;}
 
   inline bool IsFeasible(BaseParameterClass *){
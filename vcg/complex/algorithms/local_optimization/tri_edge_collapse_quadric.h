@@ -136,6 +136,7 @@ namespace tri{
 class TriEdgeCollapseQuadricParameter : public BaseParameterClass
 {
 public:
+  bool      AddressableHeap; // Keep the heap as an addressable heap: collapses are updated in place instead of being re-inserted (less memory, no stale collapses)
   double    BoundaryWeight;
   double    CosineThr;
   bool      FastPreserveBoundary;
@@ -157,6 +158,7 @@ public:
 
   void SetDefaultParams()
   {
+    AddressableHeap=false;
     BoundaryWeight=.5;
     CosineThr=cos(M_PI/2);
     FastPreserveBoundary=false;
@@ -235,9 +237,15 @@ public:
     else newPos=this->pos.V(1)->P();
 
     QH::Qd(this->pos.V(1))+=QH::Qd(this->pos.V(0));
+    // with an addressable heap, the reverse collapse must be found before its faces are deleted
+    if(pp->AddressableHeap && !IsSymmetric(pp))
+      ReverseOp() = TEC::FindOp(this->pos.V(1),this->pos.V(0));
     EdgeCollapser<TriMeshType,VertexPair>::Do(m, this->pos, newPos); // v0 is deleted and v1 take the new position
   }
 
+  /// the reverse of the last collapse performed (only for not symmetric collapses with an addressable heap)
+  static TEC *&ReverseOp(){ static TEC *rop=0; return rop;}
+
   
     
     // Final Clean up after the end of the simplification process
@@ -258,6 +266,7 @@ public:
         for(wvi=WV().begin();wvi!=WV().end();++wvi)
           if(!(*wvi)->IsD()) (*wvi)->SetW();
       }
+      TEC::ClearEdgeOps();
     }
 
   static void Init(TriMeshType &m, HeapType &h_ret, BaseParameterClass *_pp)
@@ -268,6 +277,8 @@ public:
   typename 	TriMeshType::FaceIterator  pf;
 
   pp->CosineThr=cos(pp->NormalThrRad);
+  if(pp->AddressableHeap) TEC::InitEdgeOps(m,IsSymmetric(pp));
+                     else TEC::ClearEdgeOps();
 
   vcg::tri::UpdateTopology<TriMeshType>::VertexFace(m);
   vcg::tri::UpdateFlags<TriMeshType>::FaceBorderFromVF(m);
@@ -343,9 +354,25 @@ public:
 						}
 					}	
 	  }
+    if(pp->AddressableHeap)
+    { // link the collapses to their edges, discarding the duplicated ones
+      size_t cnt=0;
+      for(size_t i=0;i<h_ret.size();++i)
+      {
+        MYTYPE *op=static_cast<MYTYPE *>(h_ret[i].locModPtr);
+        if(TEC::FindOp(op->pos.V(0),op->pos.V(1))!=0) delete op;
+        else
+        {
+          op->LinkOp();
+          h_ret[cnt++]=h_ret[i];
+        }
+      }
+      h_ret.resize(cnt);
+    }
 }
   static float HeapSimplexRatio(BaseParameterClass *_pp) {return IsSymmetric(_pp)?5.0f:9.0f;}
   static bool IsSymmetric(BaseParameterClass *_pp) {return ((QParameter *)_pp)->OptimalPlacement;}
+  static bool UseAddressableHeap(BaseParameterClass *_pp) {return ((QParameter *)_pp)->AddressableHeap;}
   static bool IsVertexStable(BaseParameterClass *_pp) {return !((QParameter *)_pp)->OptimalPlacement;}
 
 	
@@ -453,11 +480,19 @@ public:
   inline  void UpdateHeap(HeapType & h_ret,BaseParameterClass *_pp)
   {
     QParameter *pp=(QParameter *)_pp;
-    this->GlobalMark()++;
+    int mark;
+#pragma omp critical (TriEdgeCollapseGlobalMark)
+    mark = ++this->GlobalMark();
     VertexType *v[2];
     v[0]= this->pos.V(0);
     v[1]= this->pos.V(1);
-    v[1]->IMark() = this->GlobalMark();
+    v[1]->IMark() = mark;
+
+    if(pp->AddressableHeap)
+    {
+      UpdateAddressableHeap(h_ret,mark,_pp);
+      return;
+    }
 
     // First loop around the remaining vertex to unmark visited flags
     vcg::face::VFIterator<FaceType> vfi(v[1]);
@@ -475,29 +510,29 @@ public:
       if( !(vfi.V1()->IsV()) && vfi.V1()->IsRW())
       {
         vfi.V1()->SetV();
-        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V0(),vfi.V1()), this->GlobalMark(),_pp)));
+        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V0(),vfi.V1()), mark,_pp)));
         std::push_heap(h_ret.begin(),h_ret.end());
         if(!IsSymmetric(pp)){
-          h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V1(),vfi.V0()), this->GlobalMark(),_pp)));
+          h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V1(),vfi.V0()), mark,_pp)));
           std::push_heap(h_ret.begin(),h_ret.end());
         }
       }
       if(  !(vfi.V2()->IsV()) && vfi.V2()->IsRW())
       {
         vfi.V2()->SetV();
-        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V0(),vfi.V2()),this->GlobalMark(),_pp)));
+        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V0(),vfi.V2()),mark,_pp)));
         std::push_heap(h_ret.begin(),h_ret.end());
         if(!IsSymmetric(pp)){
-          h_ret.push_back( HeapElem(new MYTYPE(VertexPair(vfi.V2(),vfi.V0()), this->GlobalMark(),_pp) )  );
+          h_ret.push_back( HeapElem(new MYTYPE(VertexPair(vfi.V2(),vfi.V0()), mark,_pp) )  );
           std::push_heap(h_ret.begin(),h_ret.end());
         }
       }
       if(pp->SafeHeapUpdate && vfi.V1()->IsRW() && vfi.V2()->IsRW() )
       {
-        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V1(),vfi.V2()),this->GlobalMark(),_pp)));
+        h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V1(),vfi.V2()),mark,_pp)));
         std::push_heap(h_ret.begin(),h_ret.end());
         if(!IsSymmetric(pp)){
-          h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V2(),vfi.V1()), this->GlobalMark(),_pp)));
+          h_ret.push_back(HeapElem(new MYTYPE(VertexPair(vfi.V2(),vfi.V1()), mark,_pp)));
           std::push_heap(h_ret.begin(),h_ret.end());
         }
       }
@@ -507,6 +542,89 @@ public:
 
   }
 
+  // Addressable heap version of the UpdateHeap: the same collapses of the plain version are re-evaluated, but the
+  // ones already in the heap are updated in place (increase/decrease key) and the ones involving the deleted
+  // vertex are removed, so that the heap contains only up to date collapses.
+  void UpdateAddressableHeap(HeapType & h_ret, int mark, BaseParameterClass *_pp)
+  {
+    QParameter *pp=(QParameter *)_pp;
+    VertexType *v0= this->pos.V(0);
+    VertexType *v1= this->pos.V(1);
+
+    // First loop: the faces of v0 are now around v1, remove from the table and from the heap the collapses
+    // of v0 that they reference and unmark visited flags
+    std::vector<TEC *> deadOps;
+    vcg::face::VFIterator<FaceType> vfi(v1);
+    while (!vfi.End()){
+      vfi.V1()->ClearV();
+      vfi.V2()->ClearV();
+      for(int z=0;z<3;++z)
+        for(int dir=0;dir<2;++dir)
+        {
+          TEC *&op=TEC::EdgeOp(vfi.F(),z,dir);
+          if(op!=0 && op!=this && (static_cast<MYTYPE *>(op)->pos.V(0)==v0 || static_cast<MYTYPE *>(op)->pos.V(1)==v0))
+          {
+            deadOps.push_back(op);
+            op=0;
+          }
+        }
+      ++vfi;
+    }
+    if(ReverseOp()!=0)
+    {
+      deadOps.push_back(ReverseOp());
+      ReverseOp()=0;
+    }
+    std::sort(deadOps.begin(),deadOps.end());
+    deadOps.erase(std::unique(deadOps.begin(),deadOps.end()),deadOps.end());
+    for(size_t i=0;i<deadOps.size();++i)
+    {
+      LocalOptimization<TriMeshType>::HeapRemove(h_ret,deadOps[i]);
+      delete deadOps[i];
+    }
+
+    // Second Loop
+    vfi = face::VFIterator<FaceType>(v1);
+    while (!vfi.End())
+    {
+      assert(!vfi.F()->IsD());
+      for(int i=0;i<2;++i)
+      {
+        VertexType *vn = (i==0)?vfi.V1():vfi.V2();
+        if( !(vn->IsV()) && vn->IsRW())
+        {
+          vn->SetV();
+          RefreshCollapse(h_ret,v1,vn,mark,_pp);
+          if(!IsSymmetric(pp)) RefreshCollapse(h_ret,vn,v1,mark,_pp);
+        }
+      }
+      if(pp->SafeHeapUpdate && vfi.V1()->IsRW() && vfi.V2()->IsRW() )
+      {
+        RefreshCollapse(h_ret,vfi.V1(),vfi.V2(),mark,_pp);
+        if(!IsSymmetric(pp)) RefreshCollapse(h_ret,vfi.V2(),vfi.V1(),mark,_pp);
+      }
+      ++vfi;
+    }
+  }
+
+  // Re-evaluate the collapse a->b if it is in the heap, otherwise add it.
+  void RefreshCollapse(HeapType & h_ret, VertexType *a, VertexType *b, int mark, BaseParameterClass *_pp)
+  {
+    MYTYPE *op = static_cast<MYTYPE *>(TEC::FindOp(a,b));
+    if(op==0)
+    {
+      op = new MYTYPE(VertexPair(a,b),mark,_pp);
+      LocalOptimization<TriMeshType>::HeapInsert(h_ret,op);
+    }
+    else
+    {
+      op->localMark=mark;
+      op->ComputePriority(_pp);
+      LocalOptimization<TriMeshType>::HeapUpdate(h_ret,op);
+    }
+    TEC::SetOp(a,b,op);
+  }
+
   static void InitQuadric(TriMeshType &m,BaseParameterClass *_pp)
 {
   QParameter *pp=(QParameter *)_pp;
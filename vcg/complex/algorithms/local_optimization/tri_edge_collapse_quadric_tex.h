@@ -637,6 +637,10 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
     make_heap(h_ret.begin(),h_ret.end());
   }
 
+  // the texture quadrics of the helper and the global mark are updated without synchronization,
+  // so these collapses cannot be batched
+  virtual bool BatchSupport(std::vector<VertexPointer> &, std::vector<VertexPointer> &) {return false;}
+
   inline  void UpdateHeap(HeapType & h_ret,BaseParameterClass *_pp)
   {
     tri::TriEdgeCollapseQuadricTexParameter *pp =(tri::TriEdgeCollapseQuadricTexParameter *)_pp;
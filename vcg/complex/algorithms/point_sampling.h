@@ -621,6 +621,154 @@ static void WeightedMontecarlo(MetroMesh & m, VertexSampler &ps, int sampleNum)
 }
 
 
+// Parallel versions of Montecarlo, StratifiedMontecarlo and WeightedMontecarlo.
+// The samples are generated in blocks (of samples or of faces), each one with its own random
+// generator seeded with the pair (seed, block index), so the result depends only on the seed
+// and not on the number of threads. The blocks are generated in parallel in rounds, and the
+// samples of each round are passed to the sampler, in block order, by a single thread:
+// the sampler does not need to be thread safe.
+
+struct FaceSample
+{
+  FacePointer f;
+  CoordType bary;
+};
+enum { ParallelSampleBlock = 1<<16, ParallelFaceBlock = 1<<12, ParallelBlockRound = 64 };
+
+static void InitBlockRandomGenerator(math::MarsenneTwisterRNG &rnd, unsigned int seed, int block)
+{
+  unsigned int key[2] = { seed, (unsigned int)block };
+  rnd.initializeByArray(key,2);
+}
+
+// Same as RandomBarycentric, with the given generator.
+static CoordType RandomBarycentric(math::MarsenneTwisterRNG &rnd)
+{
+  CoordType interp;
+  interp[1] = rnd.generate01();
+  interp[2] = rnd.generate01();
+  if(interp[1] + interp[2] > 1.0)
+  {
+    interp[1] = 1.0 - interp[1];
+    interp[2] = 1.0 - interp[2];
+  }
+  interp[0]=1.0-(interp[1] + interp[2]);
+  return interp;
+}
+
+// The not deleted faces and the prefix sum of their (weighted) areas: face i spans [cum[i],cum[i+1]).
+static void FaceAreaPrefixSum(MetroMesh & m, bool weighted, std::vector<FacePointer> &faces, std::vector<double> &cum)
+{
+  faces.clear();
+  faces.reserve(m.fn);
+  for(FaceIterator fi=m.face.begin(); fi != m.face.end(); fi++)
+    if(!(*fi).IsD()) faces.push_back(&*fi);
+  cum.resize(faces.size()+1);
+  cum[0]=0;
+  #pragma omp parallel for schedule(static)
+  for(int i=0;i<int(faces.size());++i)
+    cum[i+1] = weighted ? WeightedArea(*faces[i]) : 0.5*DoubleArea(*faces[i]);
+  for(size_t i=0;i<faces.size();++i)
+    cum[i+1]+=cum[i];
+}
+
+static void EmitFaceSamples(VertexSampler &ps, std::vector<std::vector<FaceSample> > &buf, int bn)
+{
+  for(int b=0;b<bn;++b)
+  {
+    for(size_t i=0;i<buf[b].size();++i)
+      ps.AddFace(*buf[b][i].f,buf[b][i].bary);
+    buf[b].clear();
+  }
+}
+
+/// Parallel Montecarlo: EXACT number of samples, uniformly distributed over the surface.
+static void MontecarloParallel(MetroMesh & m, VertexSampler &ps, int sampleNum, unsigned int seed=0)
+{
+  std::vector<FacePointer> faces;
+  std::vector<double> cum;
+  FaceAreaPrefixSum(m,false,faces,cum);
+  if(faces.empty() || cum.back()<=0) return;
+  const double meshArea = cum.back();
+  const int blockNum = (sampleNum+ParallelSampleBlock-1)/ParallelSampleBlock;
+  std::vector<std::vector<FaceSample> > buf(ParallelBlockRound);
+  for(int b0=0;b0<blockNum;b0+=ParallelBlockRound)
+  {
+    const int bn=std::min(int(ParallelBlockRound),blockNum-b0);
+    #pragma omp parallel for schedule(dynamic,1)
+    for(int b=0;b<bn;++b)
+    {
+      math::MarsenneTwisterRNG rnd;
+      InitBlockRandomGenerator(rnd,seed,b0+b);
+      const int n=std::min(int(ParallelSampleBlock),sampleNum-(b0+b)*ParallelSampleBlock);
+      buf[b].resize(n);
+      for(int i=0;i<n;++i)
+      {
+        const double val = meshArea * rnd.generate01();
+        // the face with cum[k] <= val < cum[k+1] (it has not zero area)
+        size_t k = std::upper_bound(cum.begin(),cum.end(),val) - cum.begin() - 1;
+        if(k>=faces.size()) k=faces.size()-1;
+        buf[b][i].f = faces[k];
+        buf[b][i].bary = RandomBarycentric(rnd);
+      }
+    }
+    EmitFaceSamples(ps,buf,bn);
+  }
+}
+
+// Parallel stratified sampling: face i gets floor(cum[i+1]*d)-floor(cum[i]*d) samples, where d is the
+// number of samples per unit of (weighted) area; it is the same distribution of the sequential
+// versions, that carry the remainder from a face to the next one.
+static void StratifiedParallel(MetroMesh & m, VertexSampler &ps, int sampleNum, unsigned int seed, bool weighted)
+{
+  std::vector<FacePointer> faces;
+  std::vector<double> cum;
+  FaceAreaPrefixSum(m,weighted,faces,cum);
+  if(faces.empty() || cum.back()<=0) return;
+  const double samplePerAreaUnit = sampleNum/cum.back();
+  const int faceNum=int(faces.size());
+  const int blockNum = (faceNum+ParallelFaceBlock-1)/ParallelFaceBlock;
+  std::vector<std::vector<FaceSample> > buf(ParallelBlockRound);
+  for(int b0=0;b0<blockNum;b0+=ParallelBlockRound)
+  {
+    const int bn=std::min(int(ParallelBlockRound),blockNum-b0);
+    #pragma omp parallel for schedule(dynamic,1)
+    for(int b=0;b<bn;++b)
+    {
+      math::MarsenneTwisterRNG rnd;
+      InitBlockRandomGenerator(rnd,seed,b0+b);
+      const int fBegin=(b0+b)*ParallelFaceBlock;
+      const int fEnd=std::min(faceNum,fBegin+ParallelFaceBlock);
+      for(int f=fBegin;f<fEnd;++f)
+      {
+        const int faceSampleNum = int(floor(cum[f+1]*samplePerAreaUnit)) - int(floor(cum[f]*samplePerAreaUnit));
+        for(int i=0; i < faceSampleNum; i++)
+        {
+          FaceSample s;
+          s.f=faces[f];
+          s.bary=RandomBarycentric(rnd);
+          buf[b].push_back(s);
+        }
+      }
+    }
+    EmitFaceSamples(ps,buf,bn);
+  }
+}
+
+/// Parallel version of StratifiedMontecarlo
+static void StratifiedMontecarloParallel(MetroMesh & m, VertexSampler &ps, int sampleNum, unsigned int seed=0)
+{
+  StratifiedParallel(m,ps,sampleNum,seed,false);
+}
+
+/// Parallel version of WeightedMontecarlo
+static void WeightedMontecarloParallel(MetroMesh & m, VertexSampler &ps, int sampleNum, unsigned int seed=0)
+{
+  assert(tri::HasPerVertexQuality(m));
+  StratifiedParallel(m,ps,sampleNum,seed,true);
+}
+
+
 // Subdivision sampling of a single face.
 // return number of added samples
 
@@ -1113,6 +1261,7 @@ struct PoissonDiskParam
     preGenFlag = false;
     preGenMesh = NULL;
     geodesicDistanceFlag = false;
+    randomSeed = 0;
     pds=NULL;
   }
 
@@ -1135,6 +1284,7 @@ struct PoissonDiskParam
   bool preGenFlag;   // when generating a poisson distribution, you can initialize the set of computed points with ALL the vertices of another mesh. Useful for building progressive refinements.
   MetroMesh *preGenMesh;
   int MAXLEVELS;
+  unsigned int randomSeed; // seed of the processing order of PoissonDiskPruningParallel
 
   Stat *pds;
 };
@@ -1252,6 +1402,197 @@ static void PoissonDiskPruning(VertexSampler &ps, MetroMesh &montecarloMesh,
     }
 }
 
+// Grid of the montecarlo samples used by PoissonDiskPruningParallel.
+// The samples are sorted by cell; only the not empty cells exist (found through a hash table)
+// and the removed samples are just marked as not alive.
+class PoissonPruningGrid
+{
+public:
+  void Init(MetroMesh &montecarloMesh, const BoxType &_bb, ScalarType _cellsize)
+  {
+    bb=_bb;
+    cellsize=_cellsize;
+    std::vector<std::pair<Point3i,int> > cellOf;
+    cellOf.reserve(montecarloMesh.vert.size());
+    for(size_t i=0;i<montecarloMesh.vert.size();++i)
+      if(!montecarloMesh.vert[i].IsD())
+        cellOf.push_back(std::make_pair(CellOf(montecarloMesh.vert[i].cP()),int(i)));
+    std::sort(cellOf.begin(),cellOf.end());
+
+    sample.resize(cellOf.size());
+    alive.assign(cellOf.size(),1);
+    cellKey.clear();
+    cellStart.clear();
+    cellMap.clear();
+    for(size_t i=0;i<cellOf.size();++i)
+    {
+      sample[i]=&montecarloMesh.vert[cellOf[i].second];
+      if(i==0 || cellOf[i].first!=cellOf[i-1].first)
+      {
+        cellMap[cellOf[i].first]=int(cellKey.size());
+        cellKey.push_back(cellOf[i].first);
+        cellStart.push_back(int(i));
+      }
+    }
+    cellStart.push_back(int(cellOf.size()));
+    firstAlive.assign(cellStart.begin(),cellStart.end()-1);
+  }
+
+  Point3i CellOf(const CoordType &p) const
+  {
+    return Point3i(int(floor((p[0]-bb.min[0])/cellsize)),
+                   int(floor((p[1]-bb.min[1])/cellsize)),
+                   int(floor((p[2]-bb.min[2])/cellsize)));
+  }
+
+  int CellNum() const { return int(cellKey.size()); }
+  const Point3i &CellKey(int c) const { return cellKey[c]; }
+
+  // The first sample of the cell still alive, or NULL. Called only by the thread that owns the cell.
+  VertexPointer FirstAlive(int c)
+  {
+    int &fa=firstAlive[c];
+    while(fa<cellStart[c+1] && !alive[fa]) ++fa;
+    return (fa<cellStart[c+1]) ? sample[fa] : 0;
+  }
+
+  // Remove the samples within the radius from a point; with a radius not bigger than the cell size
+  // only the cell of the point and its neighbours are touched.
+  int RemoveInSphere(const CoordType &p, const CoordType &n, ScalarType radius, bool geodesic)
+  {
+    vertex::ApproximateGeodesicDistanceFunctor<VertexType> GDF;
+    const Point3i lo=CellOf(p-CoordType(radius,radius,radius));
+    const Point3i hi=CellOf(p+CoordType(radius,radius,radius));
+    const ScalarType r2=radius*radius;
+    int cnt=0;
+    for(int i=lo[0];i<=hi[0];++i)
+      for(int j=lo[1];j<=hi[1];++j)
+        for(int k=lo[2];k<=hi[2];++k)
+        {
+          typename CellMapType::const_iterator ci=cellMap.find(Point3i(i,j,k));
+          if(ci==cellMap.end()) continue;
+          for(int s=cellStart[ci->second];s<cellStart[ci->second+1];++s)
+          {
+            if(!alive[s]) continue;
+            const bool inside = geodesic ? (GDF(p,n,sample[s]->cP(),sample[s]->cN()) <= radius)
+                                         : (SquaredDistance(p,sample[s]->cP()) <= r2);
+            if(inside) { alive[s]=0; ++cnt; }
+          }
+        }
+    return cnt;
+  }
+
+protected:
+  typedef typename STDEXT::hash_map<Point3i,int,HashFunctor> CellMapType;
+  BoxType bb;
+  ScalarType cellsize;
+  std::vector<VertexPointer> sample;  // sorted by cell
+  std::vector<char> alive;
+  std::vector<Point3i> cellKey;
+  std::vector<int> cellStart;         // the samples of cell c are [cellStart[c],cellStart[c+1])
+  std::vector<int> firstAlive;
+  CellMapType cellMap;
+};
+
+/** Parallel version of PoissonDiskPruning, for very large sets of montecarlo samples.
+
+The montecarlo samples are put in a grid whose cells are not smaller than the biggest disk, so the
+removal of the samples around a chosen one touches only its cell and the 26 neighbours. The cells are
+split in 27 phase groups according to their coordinates modulo 3: two cells of the same group are at least
+two cells apart along some axis, so all the cells of a group can be processed at the same time (choose the
+first surviving sample of the cell, remove the samples inside its disk) and the groups are processed one
+after the other, until no sample survives.
+As in PoissonDiskPruning, no sample is closer than its radius to a previously chosen one.
+The result depends only on the montecarlo samples (their order too) and on pp.randomSeed, that shuffles
+the order of the groups at each pass; it does not depend on the number of threads.
+The sampler is always called by a single thread.
+*/
+static void PoissonDiskPruningParallel(VertexSampler &ps, MetroMesh &montecarloMesh,
+                                       ScalarType diskRadius, const struct PoissonDiskParam pp=PoissonDiskParam())
+{
+    int t0 = clock();
+    // if we are doing variable density sampling we have to prepare the random samples quality with the correct expected radii.
+    if(pp.adaptiveRadiusFlag)
+        ComputePoissonSampleRadii(montecarloMesh, diskRadius, pp.radiusVariance, pp.invertQuality);
+    ScalarType cellsize = diskRadius;
+    if(pp.adaptiveRadiusFlag)
+      for (VertexIterator vi = montecarloMesh.vert.begin(); vi != montecarloMesh.vert.end(); vi++)
+        if(!(*vi).IsD()) cellsize = std::max(cellsize,ScalarType((*vi).Q()));
+
+    BoxType bb=montecarloMesh.bbox;
+    assert(!bb.IsNull());
+    bb.Offset(cellsize);
+    PoissonPruningGrid grid;
+    grid.Init(montecarloMesh,bb,cellsize);
+
+    std::vector<int> group[27];
+    for(int c=0;c<grid.CellNum();++c)
+    {
+      const Point3i &k=grid.CellKey(c);
+      group[(k[0]%3)+3*(k[1]%3)+9*(k[2]%3)].push_back(c);
+    }
+    int t1 = clock();
+    if(pp.pds) {
+      pp.pds->gridSize = Point3i::Construct(bb.Dim()/cellsize);
+      pp.pds->gridCellNum = grid.CellNum();
+      pp.pds->montecarloSampleNum = montecarloMesh.vn;
+    }
+
+    if(pp.preGenFlag)
+    {
+      // Initial pass for pruning the grid with the an eventual pre initialized set of samples
+      for(VertexIterator vi =pp.preGenMesh->vert.begin(); vi!=pp.preGenMesh->vert.end();++vi)
+      {
+        ps.AddVert(*vi);
+        grid.RemoveInSphere(vi->cP(),vi->cN(),diskRadius,pp.geodesicDistanceFlag);
+      }
+    }
+
+    math::MarsenneTwisterRNG rnd(pp.randomSeed);
+    int order[27];
+    for(int g=0;g<27;++g) order[g]=g;
+    int sampleCnt=0;
+    bool active=true;
+    while(active)
+    {
+      active=false;
+      for(int g=26;g>0;--g) std::swap(order[g],order[rnd.generate(0)%(g+1)]);
+      for(int g=0;g<27;++g)
+      {
+        std::vector<int> &cells=group[order[g]];
+        std::vector<VertexPointer> chosen(cells.size(),VertexPointer(0));
+        #pragma omp parallel for schedule(dynamic,256)
+        for(int i=0;i<int(cells.size());++i)
+        {
+          VertexPointer sp=grid.FirstAlive(cells[i]);
+          if(sp==0) continue;
+          chosen[i]=sp;
+          ScalarType sampleRadius = diskRadius;
+          if(pp.adaptiveRadiusFlag)  sampleRadius = sp->Q();
+          grid.RemoveInSphere(sp->cP(),sp->cN(),sampleRadius,pp.geodesicDistanceFlag);
+        }
+        // emit the samples in cell order; the cells without samples are done for good
+        size_t kept=0;
+        for(size_t i=0;i<cells.size();++i)
+          if(chosen[i])
+          {
+            ps.AddVert(*chosen[i]);
+            cells[kept++]=cells[i];
+          }
+        sampleCnt+=int(kept);
+        cells.resize(kept);
+        if(kept) active=true;
+      }
+    }
+    int t2 = clock();
+    if(pp.pds)
+    {
+      pp.pds->sampleNum = sampleCnt;
+      pp.pds->gridTime = t1-t0;
+      pp.pds->pruneTime = t2-t1;
+    }
+}
+
 /** Compute a Poisson-disk sampling of the surface.
  *  The radius of the disk is computed according to the estimated sampling density.
  *
@@ -35,32 +35,31 @@ public:
     bool operator< (const WArc &a) const {return w<a.w;}
   };
 
-  static void ComputeUndirectedNormal(MeshType &m, int nn, float maxDist, KdTree<float> &tree,vcg::CallBackPos * cb=0)
+  static void ComputeUndirectedNormal(MeshType &m, int nn, ScalarType maxDist, KdTree<ScalarType> &tree,vcg::CallBackPos * cb=0)
   {
-    tree.setMaxNofNeighbors(nn);
-    int cnt=0;
-    int step=m.vn/100;
-    for (VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+    if(cb) cb(1,"Searching neighbours");
+    std::vector<int> nnId;
+    std::vector<ScalarType> nnSqDist;
+    tree.queryKBatch(VertexConstDataWrapper<MeshType>(m), nn, nnId, nnSqDist);
+
+    if(cb) cb(50,"Fitting planes");
+#pragma omp parallel for schedule(dynamic,1024)
+    for (int vi=0;vi<int(m.vert.size());++vi)
     {
-        tree.doQueryK(vi->cP());
-        if(cb && (++cnt%step)==0) cb(cnt/step,"Fitting planes");
-
-        int neighbours = tree.getNofFoundNeighbors();
         std::vector<CoordType> ptVec;
-
-        for (int i = 0; i < neighbours; i++)
+        for (int i = 0; i < nn; i++)
         {
-            int neightId = tree.getNeighborId(i);
-            if(Distance(vi->cP(),m.vert[neightId].cP())<maxDist)
+            int neightId = nnId[size_t(vi)*nn+i];
+            if(neightId>=0 && Distance(m.vert[vi].cP(),m.vert[neightId].cP())<maxDist)
             ptVec.push_back(m.vert[neightId].cP());
         }
-        Plane3f plane;
+        Plane3<ScalarType> plane;
         FitPlaneToPointSet(ptVec,plane);
-        vi->N()=plane.Direction();
+        m.vert[vi].N().Import(plane.Direction());
     }
   }
 
-  static void AddNeighboursToHeap( MeshType &m, VertexPointer vp, KdTree<float> &tree, std::vector<WArc> &heap)
+  static void AddNeighboursToHeap( MeshType &m, VertexPointer vp, KdTree<ScalarType> &tree, std::vector<WArc> &heap)
   {
     tree.doQueryK(vp->cP());
 
@@ -94,7 +93,7 @@ public:
     int fittingAdjNum; /// number of adjacent nodes used for computing the fitting plane
     int smoothingIterNum; /// number of itaration of a simple normal smoothing (use the same number of ajdacent of fittingAdjNjm)
     int coherentAdjNum; /// number of nodes used in the coherency pass
-    Point3f viewPoint;  /// position of a viewpoint used to disambiguate direction
+    CoordType viewPoint;  /// position of a viewpoint used to disambiguate direction
     bool useViewPoint;  /// if the position of the viewpoint has to be used.
   };
 
@@ -103,7 +102,7 @@ public:
     tri::Allocator<MeshType>::CompactVertexVector(m);
     if(cb) cb(1,"Building KdTree...");
     VertexConstDataWrapper<MeshType> DW(m);
-    KdTree<float> tree(DW);
+    KdTree<ScalarType> tree(DW);
 
     ComputeUndirectedNormal(m, p.fittingAdjNum, std::numeric_limits<ScalarType>::max(), tree,cb);
 
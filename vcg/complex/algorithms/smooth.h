@@ -261,6 +261,12 @@ static void AccumulateLaplacianInfo(MeshType &m, SimpleTempData<typename MeshTyp
 }
 
 static void VertexCoordLaplacian(MeshType &m, int step, bool SmoothSelected=false, bool cotangentWeight=false, vcg::CallBackPos * cb=0)
+{
+	VertexCoordLaplacian(m,m.vert,step,SmoothSelected,cotangentWeight,cb);
+}
+
+template <class VertContainer>
+static void VertexCoordLaplacian(MeshType &m, VertContainer &/*vert*/, int step, bool SmoothSelected, bool cotangentWeight, vcg::CallBackPos * cb)
 {
   VertexIterator vi;
 	LaplacianInfo lpz(CoordType(0,0,0),0);
@@ -279,6 +285,86 @@ static void VertexCoordLaplacian(MeshType &m, int step, bool SmoothSelected=fals
 		}
 }
 
+// Structure of arrays version of the above: the vertex indices and the border bits of the live faces
+// are collected once, then every step works on the position array and on two plain accumulators
+// (the same sums of AccumulateLaplacianInfo, in the same order).
+template <class SoaVertexType>
+static void VertexCoordLaplacian(MeshType &m, vertex::vector_soa<SoaVertexType> &vert, int step, bool SmoothSelected, bool cotangentWeight, vcg::CallBackPos * cb)
+{
+	if(!SoaVertexType::HasCoordSoa() || !SoaVertexType::HasFlagsSoa())
+	{
+		VertexCoordLaplacian(m,static_cast<std::vector<SoaVertexType> &>(vert),step,SmoothSelected,cotangentWeight,cb);
+		return;
+	}
+	const int vn=int(vert.size());
+	if(vn==0) return;
+	VertexPointer vBase=&vert[0];
+	std::vector<int> corner;
+	std::vector<char> border;
+	corner.reserve(3*m.fn);
+	border.reserve(3*m.fn);
+	for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+		if(!(*fi).IsD())
+			for(int j=0;j<3;++j)
+			{
+				corner.push_back(int((*fi).V(j)-vBase));
+				border.push_back((*fi).IsB(j));
+			}
+	const int cn=int(corner.size());
+	CoordType *p=&vert.PV[0];
+	const int *flags=&vert.FV[0];
+	std::vector<CoordType> sum(vn);
+	std::vector<ScalarType> cnt(vn);
+	for(int i=0;i<step;++i)
+	{
+		if(cb)cb(100*i/step, "Classic Laplacian Smoothing");
+		std::fill(sum.begin(),sum.end(),CoordType(0,0,0));
+		std::fill(cnt.begin(),cnt.end(),ScalarType(0));
+		float weight =1.0f;
+		for(int c=0;c<cn;c+=3)
+			for(int j=0;j<3;++j)
+				if(!border[c+j])
+				{
+					const int a=corner[c+j], b=corner[c+(j+1)%3];
+					if(cotangentWeight) {
+						const int o=corner[c+(j+2)%3];
+						float angle = Angle(p[b]-p[o],p[a]-p[o]);
+						weight = tan(M_PI_2 - angle);
+					}
+					sum[a]+=p[b]*weight;
+					sum[b]+=p[a]*weight;
+					cnt[a]+=weight;
+					cnt[b]+=weight;
+				}
+		for(int c=0;c<cn;c+=3)
+			for(int j=0;j<3;++j)
+				if(border[c+j])
+				{
+					const int a=corner[c+j], b=corner[c+(j+1)%3];
+					sum[a]=p[a];
+					sum[b]=p[b];
+					cnt[a]=1;
+					cnt[b]=1;
+				}
+		for(int c=0;c<cn;c+=3)
+			for(int j=0;j<3;++j)
+				if(border[c+j])
+				{
+					const int a=corner[c+j], b=corner[c+(j+1)%3];
+					sum[a]+=p[b];
+					sum[b]+=p[a];
+					++cnt[a];
+					++cnt[b];
+				}
+		for(int k=0;k<vn;++k)
+			if((flags[k] & SoaVertexType::DELETED)==0 && cnt[k]>0 )
+			{
+				if(!SmoothSelected || (flags[k] & SoaVertexType::SELECTED))
+					p[k] = ( p[k] + sum[k])/(cnt[k]+1);
+			}
+	}
+}
+
 // Same of above but moves only the vertices that do not change FaceOrientation more that the given threshold
 static void VertexCoordPlanarLaplacian(MeshType &m, int step, float AngleThrRad = math::ToRad(1.0), bool SmoothSelected=false, vcg::CallBackPos * cb=0)
 {
@@ -1233,25 +1319,29 @@ static void VertexCoordPasoDobleFast(MeshType &m, int NormalSmoothStep, typename
 }
 
 
-static void VertexNormalPointCloud(MeshType &m, int neighborNum, int iterNum, KdTree<float> *tp=0)
+static void VertexNormalPointCloud(MeshType &m, int neighborNum, int iterNum, KdTree<ScalarType> *tp=0)
 {
-  SimpleTempData<typename MeshType::VertContainer,Point3f > TD(m.vert,Point3f(0,0,0));
+  typedef typename VertexType::NormalType NormalType;
+  SimpleTempData<typename MeshType::VertContainer,NormalType > TD(m.vert,NormalType(0,0,0));
   VertexConstDataWrapper<MeshType> ww(m);
-  KdTree<float> *tree=0;
-  if(tp==0) tree = new KdTree<float>(ww);
+  KdTree<ScalarType> *tree=0;
+  if(tp==0) tree = new KdTree<ScalarType>(ww);
   else tree=tp;
 
-  tree->setMaxNofNeighbors(neighborNum);
+  // the neighbours do not change between iterations: query them once
+  std::vector<int> nnId;
+  std::vector<ScalarType> nnSqDist;
+  if(iterNum>0) tree->queryKBatch(ww,neighborNum,nnId,nnSqDist);
   for(int ii=0;ii<iterNum;++ii)
   {
-    for (VertexIterator vi = m.vert.begin();vi!=m.vert.end();++vi)
+#pragma omp parallel for schedule(static)
+    for (int vi=0;vi<int(m.vert.size());++vi)
     {
-      tree->doQueryK(vi->cP());
-      int neighbours = tree->getNofFoundNeighbors();
-      for (int i = 0; i < neighbours; i++)
+      for (int i = 0; i < neighborNum; i++)
       {
-        int neightId = tree->getNeighborId(i);
-        if(m.vert[neightId].cN()*vi->cN()>0)
+        int neightId = nnId[size_t(vi)*neighborNum+i];
+        if(neightId<0) continue;
+        if(m.vert[neightId].cN()*m.vert[vi].cN()>0)
           TD[vi]+= m.vert[neightId].cN();
         else
           TD[vi]-= m.vert[neightId].cN();
@@ -1260,7 +1350,7 @@ static void VertexNormalPointCloud(MeshType &m, int neighborNum, int iterNum, Kd
     for (VertexIterator vi = m.vert.begin();vi!=m.vert.end();++vi)
     {
       vi->N()=TD[vi];
-      TD[vi]=Point3f(0,0,0);
+      TD[vi]=NormalType(0,0,0);
     }
     tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
   }
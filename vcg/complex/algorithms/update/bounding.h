@@ -23,6 +23,9 @@
 #ifndef __VCG_TRI_UPDATE_BOUNDING
 #define __VCG_TRI_UPDATE_BOUNDING
 
+#include <limits>
+#include <algorithm>
+
 namespace vcg {
 namespace tri {
 
@@ -39,14 +42,77 @@ typedef ComputeMeshType MeshType;
 typedef typename MeshType::VertexType     VertexType;
 typedef typename MeshType::VertexPointer  VertexPointer;
 typedef typename MeshType::VertexIterator VertexIterator;
+typedef typename MeshType::ScalarType     ScalarType;
+typedef typename MeshType::BoxType        BoxType;
 
 /// \brief Calculates the bounding box of the given mesh m
 
 static void Box(ComputeMeshType &m)
 {
 	m.bbox.SetNull();
-	for(VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-		if( !(*vi).IsD() )	m.bbox.Add((*vi).cP());
+	VertexBox(m.vert,m.bbox);
+}
+
+/// Below this number of vertices the box is always computed serially.
+enum { ParallelMinVertNum = 50000 };
+
+/// \brief Adds the non deleted vertices of the container to the box
+/**
+ Each thread computes the box of a range of vertices, the partial boxes are then merged.
+ */
+template <class VertContainer>
+static void VertexBox(const VertContainer &vert, BoxType &bb)
+{
+	const int n=int(vert.size());
+#pragma omp parallel if(n>=ParallelMinVertNum)
+	{
+		BoxType localBox;
+#pragma omp for schedule(static) nowait
+		for(int i=0;i<n;++i)
+			if( !vert[i].IsD() )	localBox.Add(vert[i].cP());
+#pragma omp critical (UpdateBoundingBox)
+		bb.Add(localBox);
+	}
+}
+
+/// \brief Structure of arrays version: scans directly the position and flag arrays
+
+template <class SoaVertexType>
+static void VertexBox(const vertex::vector_soa<SoaVertexType> &vert, BoxType &bb)
+{
+	if(!SoaVertexType::HasCoordSoa() || !SoaVertexType::HasFlagsSoa())
+	{
+		for(size_t i=0;i<vert.size();++i)
+			if( !vert[i].IsD() )	bb.Add(vert[i].cP());
+		return;
+	}
+	const int n=int(vert.PV.size());
+	const ScalarType *p=n>0 ? &vert.PV[0][0] : 0;
+	const int *flags=n>0 ? &vert.FV[0] : 0;
+#pragma omp parallel if(n>=ParallelMinVertNum)
+	{
+		// branch free min/max on separate variables, so that the loop does not stall on the flags
+		ScalarType x0=std::numeric_limits<ScalarType>::max(), y0=x0, z0=x0;
+		ScalarType x1=-x0, y1=x1, z1=x1;
+#pragma omp for schedule(static) nowait
+		for(int i=0;i<n;++i)
+		{
+			const bool live = (flags[i] & SoaVertexType::DELETED)==0;
+			const ScalarType x=p[3*i], y=p[3*i+1], z=p[3*i+2];
+			const ScalarType lx=live?x:x0, ly=live?y:y0, lz=live?z:z0;
+			const ScalarType hx=live?x:x1, hy=live?y:y1, hz=live?z:z1;
+			x0=std::min(x0,lx); y0=std::min(y0,ly); z0=std::min(z0,lz);
+			x1=std::max(x1,hx); y1=std::max(y1,hy); z1=std::max(z1,hz);
+		}
+		if(x0<=x1)
+		{
+#pragma omp critical (UpdateBoundingBox)
+			{
+				bb.Add(Point3<ScalarType>(x0,y0,z0));
+				bb.Add(Point3<ScalarType>(x1,y1,z1));
+			}
+		}
+	}
 }
 
 
@@ -24,6 +24,7 @@
 #ifndef __VCG_TRI_UPDATE_NORMALS
 #define __VCG_TRI_UPDATE_NORMALS
 
+#include <algorithm>
 #include <vcg/complex/algorithms/update/flag.h>
 #include <vcg/math/matrix44.h>
 #include <vcg/complex/exception.h>
@@ -58,6 +59,168 @@ typedef typename MeshType::FaceType       FaceType;
 typedef typename MeshType::FacePointer    FacePointer;
 typedef typename MeshType::FaceIterator   FaceIterator;
 
+/// Below this number of faces the per vertex normals are always computed serially.
+enum { ParallelMinFaceNum = 10000 };
+/// Below this number of vertices the loops over the vertices (e.g. NormalizePerVertex) are serial.
+enum { ParallelMinVertNum = 10000 };
+
+/// \brief Wedge weights of the per vertex normal schemes: contribution of the triangle p0,p1,p2 to the normals of its three vertices.
+struct AreaWeight
+{
+  static void Compute(const CoordType &p0, const CoordType &p1, const CoordType &p2, typename FaceType::NormalType w[3])
+  {
+    w[0] = w[1] = w[2] = vcg::Normal(p0,p1,p2);
+  }
+};
+
+struct AngleWeight
+{
+  static void Compute(const CoordType &p0, const CoordType &p1, const CoordType &p2, typename FaceType::NormalType w[3])
+  {
+    typename FaceType::NormalType t = vcg::NormalizedNormal(p0,p1,p2);
+    NormalType e0 = (p1-p0).Normalize();
+    NormalType e1 = (p2-p1).Normalize();
+    NormalType e2 = (p0-p2).Normalize();
+    w[0] = t*AngleN(e0,-e2);
+    w[1] = t*AngleN(-e0,e1);
+    w[2] = t*AngleN(-e1,e2);
+  }
+};
+
+struct NelsonMaxWeight
+{
+  static void Compute(const CoordType &p0, const CoordType &p1, const CoordType &p2, typename FaceType::NormalType w[3])
+  {
+    typename FaceType::NormalType t = vcg::Normal(p0,p1,p2);
+    ScalarType e0 = SquaredDistance(p0,p1);
+    ScalarType e1 = SquaredDistance(p1,p2);
+    ScalarType e2 = SquaredDistance(p2,p0);
+    w[0] = t/(e0*e2);
+    w[1] = t/(e0*e1);
+    w[2] = t/(e1*e2);
+  }
+};
+
+/// Access to the position, normal and flags of the i-th vertex through the vertex accessors.
+struct VertexArrays
+{
+  VertexPointer v;
+  VertexArrays(VertexPointer _v):v(_v) {}
+  const CoordType &cP(int i) const { return v[i].P(); }
+  NormalType &N(int i) const { return v[i].N(); }
+  bool Writable(int i) const { return !v[i].IsD() && v[i].IsRW(); }
+};
+
+/// Access to the position, normal and flags of the i-th vertex of a vertex::vector_soa directly on its arrays.
+template <class SoaVertexType>
+struct SoaVertexArrays
+{
+  const CoordType *p;
+  NormalType *n;
+  const int *flags;
+  SoaVertexArrays(vertex::vector_soa<SoaVertexType> &vert):p(&vert.PV[0]),n(&vert.NV[0]),flags(&vert.FV[0]) {}
+  const CoordType &cP(int i) const { return p[i]; }
+  NormalType &N(int i) const { return n[i]; }
+  bool Writable(int i) const { return (flags[i] & (SoaVertexType::DELETED | SoaVertexType::NOTREAD | SoaVertexType::NOTWRITE))==0; }
+};
+
+/// Per thread accumulation buffer of PerVertexParallel(); it covers only [lo,hi), the range of the
+/// vertices referenced by the faces of the thread.
+struct LocalNormalBuffer
+{
+  std::vector<NormalType> n;
+  std::vector<char> used;
+  int lo,hi;
+  LocalNormalBuffer(int vn):lo(vn),hi(0) {}
+  void Extend(int vi)
+  {
+    if(vi<lo) lo=vi;
+    if(vi>=hi) hi=vi+1;
+  }
+  void Init()
+  {
+    if(hi<=lo) return;
+    n.resize(hi-lo,NormalType((ScalarType)0,(ScalarType)0,(ScalarType)0));
+    used.resize(hi-lo,0);
+  }
+};
+
+/// \brief Multithreaded accumulation of the per vertex normals with the given wedge weights.
+/**
+ Each thread scans a contiguous range of faces and accumulates the wedge weights in its own
+ buffer, so that shared vertices are never written concurrently; then the vertices are
+ processed in parallel summing the buffers in face order, so the result does not depend
+ on the scheduling (only on the number of threads).
+ Each buffer spans the range of the vertex indices referenced by the faces of its thread:
+ on meshes with a coherent vertex and face order (e.g. the output of most generators and
+ scanners) that is a fraction of the vertices, but in the worst case (a random order) the
+ extra memory is a normal and a byte per vertex for each thread.
+ As with PerVertexClear(), only the normals of the vertices referenced by some face are reset.
+ The vertex data is read and written through \c va (a VertexArrays or a SoaVertexArrays).
+ */
+template <class WedgeWeight, class VertexAccess>
+static void PerVertexParallel(ComputeMeshType &m, const VertexAccess &va)
+{
+  const int fn=int(m.face.size());
+  const int vn=int(m.vert.size());
+  if(vn==0) return;
+  VertexPointer vBase=&m.vert[0];
+  std::vector<std::pair<int, LocalNormalBuffer*> > buffers;
+#pragma omp parallel
+  {
+    LocalNormalBuffer buf(vn);
+    int first=fn;
+    // the two loops have the same static schedule, so they visit the same faces
+#pragma omp for schedule(static)
+    for(int i=0;i<fn;++i)
+    {
+      FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      if(first==fn) first=i;
+      for(int j=0;j<3;++j)
+        buf.Extend(int(f.V(j)-vBase));
+    }
+    buf.Init();
+#pragma omp for schedule(static)
+    for(int i=0;i<fn;++i)
+    {
+      FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      const int v0=int(f.V(0)-vBase), v1=int(f.V(1)-vBase), v2=int(f.V(2)-vBase);
+      const int vi[3]={v0,v1,v2};
+      typename FaceType::NormalType w[3];
+      const bool r=f.IsR();
+      if(r) WedgeWeight::Compute(va.cP(v0),va.cP(v1),va.cP(v2),w);
+      for(int j=0;j<3;++j)
+      {
+        buf.used[vi[j]-buf.lo]=1;
+        if(r && va.Writable(vi[j]))
+          buf.n[vi[j]-buf.lo]+=w[j];
+      }
+    }
+#pragma omp critical (UpdateNormalBuffers)
+    buffers.push_back(std::make_pair(first,&buf));
+#pragma omp barrier
+#pragma omp single
+    std::sort(buffers.begin(),buffers.end());
+#pragma omp for schedule(static)
+    for(int i=0;i<vn;++i)
+    {
+      if(!va.Writable(i)) continue;
+      bool used=false;
+      NormalType n((ScalarType)0,(ScalarType)0,(ScalarType)0);
+      for(size_t k=0;k<buffers.size();++k)
+      {
+        const LocalNormalBuffer &b=*buffers[k].second;
+        if(i<b.lo || i>=b.hi || !b.used[i-b.lo]) continue;
+        used=true;
+        n+=b.n[i-b.lo];
+      }
+      if(used) va.N(i)=n;
+    }
+  }
+}
+
 /// \brief Set to zero all the PerVertex normals
 /**
  Set to zero all the PerVertex normals. Used by all the face averaging algorithms.
@@ -81,24 +244,75 @@ static void PerVertexClear(ComputeMeshType &m, bool ClearAllVertNormal=false)
          (*vi).N() = NormalType((ScalarType)0,(ScalarType)0,(ScalarType)0);
 }
 
+/// \brief Accumulates the wedge weights of the faces on the normals of their vertices.
+template <class WedgeWeight, class VertContainer>
+static void PerVertexWeighted(ComputeMeshType &m, VertContainer &vert)
+{
+  tri::RequirePerVertexNormal(m);
+#ifdef _OPENMP
+  if(m.fn>=ParallelMinFaceNum && !vert.empty()) { PerVertexParallel<WedgeWeight>(m,VertexArrays(&vert[0])); return; }
+#endif
+  PerVertexClear(m);
+  for(FaceIterator f=m.face.begin();f!=m.face.end();++f)
+    if( !(*f).IsD() && (*f).IsR() )
+    {
+      typename FaceType::NormalType w[3];
+      WedgeWeight::Compute((*f).cP(0),(*f).cP(1),(*f).cP(2),w);
+      for(int j=0; j<3; ++j)
+        if( !(*f).V(j)->IsD() && (*f).V(j)->IsRW() )
+          (*f).V(j)->N() += w[j];
+    }
+}
+
+/// \brief Structure of arrays version: reads the positions and accumulates the normals directly on the arrays
+/**
+ The faces are visited once: the normal of a vertex is reset when it is first met, so, as with
+ PerVertexClear(), only the normals of the vertices referenced by some face are reset.
+ */
+template <class WedgeWeight, class SoaVertexType>
+static void PerVertexWeighted(ComputeMeshType &m, vertex::vector_soa<SoaVertexType> &vert)
+{
+  if(!SoaVertexType::HasCoordSoa() || !SoaVertexType::HasNormalSoa() || !SoaVertexType::HasFlagsSoa())
+  {
+    PerVertexWeighted<WedgeWeight>(m,static_cast<std::vector<SoaVertexType> &>(vert));
+    return;
+  }
+  tri::RequirePerVertexNormal(m);
+  const int vn=int(vert.size());
+  if(vn==0) return;
+  const SoaVertexArrays<SoaVertexType> va(vert);
+#ifdef _OPENMP
+  if(m.fn>=ParallelMinFaceNum) { PerVertexParallel<WedgeWeight>(m,va); return; }
+#endif
+  VertexPointer vBase=&vert[0];
+  std::vector<char> used(vn,0);
+  for(FaceIterator f=m.face.begin();f!=m.face.end();++f)
+    if( !(*f).IsD() )
+    {
+      const int vi[3]={int((*f).V(0)-vBase),int((*f).V(1)-vBase),int((*f).V(2)-vBase)};
+      const bool r=(*f).IsR();
+      typename FaceType::NormalType w[3];
+      if(r) WedgeWeight::Compute(va.cP(vi[0]),va.cP(vi[1]),va.cP(vi[2]),w);
+      for(int j=0; j<3; ++j)
+      {
+        const bool writable=va.Writable(vi[j]);
+        if(!used[vi[j]])
+        {
+          used[vi[j]]=1;
+          if(writable) va.N(vi[j])=NormalType((ScalarType)0,(ScalarType)0,(ScalarType)0);
+        }
+        if(r && writable) va.N(vi[j]) += w[j];
+      }
+    }
+}
+
 ///  \brief Calculates the vertex normal as the classic area weighted average. It does not need or exploit current face normals.
 /**
  The normal of a vertex v is the classical area-weigthed average of the normals of the faces incident on v.
  */
  static void PerVertex(ComputeMeshType &m)
 {
- PerVertexClear(m);
- FaceIterator f;
- for(f=m.face.begin();f!=m.face.end();++f)
-   if( !(*f).IsD() && (*f).IsR() )
-   {
-    //typename FaceType::NormalType t = (*f).Normal();
-    typename FaceType::NormalType t = vcg::Normal(*f);
-
-    for(int j=0; j<3; ++j)
-     if( !(*f).V(j)->IsD() && (*f).V(j)->IsRW() )
-      (*f).V(j)->N() += t;
-   }
+ PerVertexWeighted<AreaWeight>(m,m.vert);
 }
 
 ///  \brief Calculates the vertex normal as an angle weighted average. It does not need or exploit current face normals.
@@ -112,20 +326,7 @@ Journal of Graphics Tools, 1998
  */
  static void PerVertexAngleWeighted(ComputeMeshType &m)
 {
-  PerVertexClear(m);
-  FaceIterator f;
-  for(f=m.face.begin();f!=m.face.end();++f)
-   if( !(*f).IsD() && (*f).IsR() )
-   {
-    typename FaceType::NormalType t = vcg::NormalizedNormal(*f);
-		NormalType e0 = ((*f).V1(0)->cP()-(*f).V0(0)->cP()).Normalize();
-		NormalType e1 = ((*f).V1(1)->cP()-(*f).V0(1)->cP()).Normalize();
-		NormalType e2 = ((*f).V1(2)->cP()-(*f).V0(2)->cP()).Normalize();
-		
-		(*f).V(0)->N() += t*AngleN(e0,-e2);
-		(*f).V(1)->N() += t*AngleN(-e0,e1);
-		(*f).V(2)->N() += t*AngleN(-e1,e2);
-   }
+  PerVertexWeighted<AngleWeight>(m,m.vert);
 }
 
 ///  \brief Calculates the vertex normal using the Max et al. weighting scheme. It does not need or exploit current face normals.
@@ -138,20 +339,7 @@ Journal of Graphics Tools, 1998
  */
 static void PerVertexNelsonMaxWeighted(ComputeMeshType &m)
 {
- PerVertexClear(m);
- FaceIterator f;
- for(f=m.face.begin();f!=m.face.end();++f)
-   if( !(*f).IsD() && (*f).IsR() )
-   {
-    typename FaceType::NormalType t = vcg::Normal(*f);
-		ScalarType e0 = SquaredDistance((*f).V0(0)->cP(),(*f).V1(0)->cP());
-		ScalarType e1 = SquaredDistance((*f).V0(1)->cP(),(*f).V1(1)->cP());
-		ScalarType e2 = SquaredDistance((*f).V0(2)->cP(),(*f).V1(2)->cP());
-		
-		(*f).V(0)->N() += t/(e0*e2);
-		(*f).V(1)->N() += t/(e0*e1);
-		(*f).V(2)->N() += t/(e1*e2);
-   }
+  PerVertexWeighted<NelsonMaxWeight>(m,m.vert);
 }
 
 /// \brief Calculates the face normal
@@ -160,9 +348,11 @@ static void PerVertexNelsonMaxWeighted(ComputeMeshType &m)
 static void PerFace(ComputeMeshType &m)
 {
   if(!HasPerFaceNormal(m)) throw vcg::MissingComponentException("PerFaceNormal");
-  for(FaceIterator f=m.face.begin();f!=m.face.end();++f)
-            if( !(*f).IsD() )
-                face::ComputeNormal(*f);
+  const int n=int(m.face.size());
+#pragma omp parallel for schedule(static) if(n>=ParallelMinFaceNum)
+  for(int i=0;i<n;++i)
+            if( !m.face[i].IsD() )
+                face::ComputeNormal(m.face[i]);
 }
 
 /// \brief Calculates the vertex normal by averaging the current per-face normals.
@@ -212,17 +402,47 @@ static void PerFaceFromCurrentVertexNormal(ComputeMeshType &m)
 static void NormalizePerVertex(ComputeMeshType &m)
 {
   tri::RequirePerVertexNormal(m);
-  for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
-		if( !(*vi).IsD() && (*vi).IsRW() ) 
-			(*vi).N().Normalize();
+  NormalizeVertex(m.vert);
+}
+
+template <class VertContainer>
+static void NormalizeVertex(VertContainer &vert)
+{
+  const int n=int(vert.size());
+#pragma omp parallel for schedule(static) if(n>=ParallelMinVertNum)
+  for(int i=0;i<n;++i)
+		if( !vert[i].IsD() && vert[i].IsRW() )
+			vert[i].N().Normalize();
+}
+
+/// \brief Structure of arrays version: scans directly the normal and flag arrays
+template <class SoaVertexType>
+static void NormalizeVertex(vertex::vector_soa<SoaVertexType> &vert)
+{
+  if(!SoaVertexType::HasNormalSoa() || !SoaVertexType::HasFlagsSoa())
+  {
+    NormalizeVertex(static_cast<std::vector<SoaVertexType> &>(vert));
+    return;
+  }
+  const int n=int(vert.size());
+  if(n==0) return;
+  NormalType *nv=&vert.NV[0];
+  const int *flags=&vert.FV[0];
+  const int skip=SoaVertexType::DELETED | SoaVertexType::NOTREAD | SoaVertexType::NOTWRITE;
+#pragma omp parallel for schedule(static) if(n>=ParallelMinVertNum)
+  for(int i=0;i<n;++i)
+    if( (flags[i] & skip)==0 )
+      nv[i].Normalize();
 }
 
 /// \brief Normalize the length of the face normals.
 static void NormalizePerFace(ComputeMeshType &m)
 {
   tri::RequirePerFaceNormal(m);
-  for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
-      if( !(*fi).IsD() )	(*fi).N().Normalize();
+  const int n=int(m.face.size());
+#pragma omp parallel for schedule(static) if(n>=ParallelMinFaceNum)
+  for(int i=0;i<n;++i)
+      if( !m.face[i].IsD() )	m.face[i].N().Normalize();
 }
 
 /// \brief Set the length of the face normals to their area (without recomputing their directions).
@@ -255,6 +255,152 @@ static void FaceFace(MeshType &m)
   } while(true);
 }
 
+/// \brief Auxiliairy data structure of the bucketed topology builders.
+/**
+A counting sort of the edges (or corners) of the mesh by vertex index: bucket i holds the entries
+[start[i],start[i+1]) of entry. Each entry stores the other vertex of the edge (if any),
+the index of the face (or edge) and the index of the edge (or vertex) inside it.
+Entries are counted in parallel and scattered serially in the order of the faces,
+so each bucket is in face order whatever the number of threads.
+*/
+class VertexBuckets
+{
+public:
+  struct Entry
+  {
+    int v;  // the other vertex of the edge
+    int s;  // index of the face or edge
+    int z;  // index of the edge or vertex inside it
+    inline bool operator < ( const Entry & e ) const
+    {
+      if(v!=e.v) return v<e.v;
+      if(s!=e.s) return s<e.s;
+      return z<e.z;
+    }
+  };
+
+  std::vector<int> start;
+  std::vector<Entry> entry;
+  std::vector<int> cursor;
+
+  VertexBuckets(int vn): start(vn+1,0) {}
+  int BucketNum() const { return int(start.size())-1; }
+
+  /// To be called (possibly in parallel) once for each entry, before Allocate().
+  void Count(int b)
+  {
+#pragma omp atomic
+    ++start[b+1];
+  }
+  void Allocate()
+  {
+    for(size_t i=1;i<start.size();++i) start[i]+=start[i-1];
+    entry.resize(start.back());
+    cursor.assign(start.begin(),start.end()-1);
+  }
+  /// To be called serially, after Allocate().
+  void Put(int b, int v, int s, int z)
+  {
+    Entry &e=entry[cursor[b]++];
+    e.v=v; e.s=s; e.z=z;
+  }
+  /// Sort each bucket by (v,s,z); buckets are small, so this is cheap.
+  void SortBuckets()
+  {
+    const int bn=BucketNum();
+#pragma omp parallel for schedule(dynamic,4096)
+    for(int b=0;b<bn;++b)
+      if(start[b+1]-start[b]>1)
+        std::sort(entry.begin()+start[b],entry.begin()+start[b+1]);
+  }
+};
+
+/// Fill the buckets with the (non faux) edges of the faces, by the lower vertex index, and sort them.
+static void FillEdgeBuckets(MeshType &m, VertexBuckets &vb, bool includeFauxEdge=true)
+{
+  const int fn=int(m.face.size());
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<fn;++i)
+    if( ! m.face[i].IsD() )
+      for(int j=0;j<m.face[i].VN();++j)
+        if(includeFauxEdge || !m.face[i].IsF(j))
+          vb.Count(std::min(int(tri::Index(m,m.face[i].V(j))),int(tri::Index(m,m.face[i].V(m.face[i].Next(j))))));
+  vb.Allocate();
+  for(int i=0;i<fn;++i)
+    if( ! m.face[i].IsD() )
+      for(int j=0;j<m.face[i].VN();++j)
+        if(includeFauxEdge || !m.face[i].IsF(j))
+        {
+          int v0=tri::Index(m,m.face[i].V(j));
+          int v1=tri::Index(m,m.face[i].V(m.face[i].Next(j)));
+          if(v0>v1) std::swap(v0,v1);
+          vb.Put(v0,v1,i,j);
+        }
+  vb.SortBuckets();
+}
+
+/// \brief Same as FillUniqueEdgeVector(), but the edges are matched by vertex buckets instead of a global sort.
+/**
+The resulting vector is the same, sorted by vertices; for an edge shared by many faces the
+stored face is the first one in the face vector.
+*/
+static void FillUniqueEdgeVectorBucketed(MeshType &m, std::vector<PEdge> &Edges, bool includeFauxEdge=true)
+{
+  VertexBuckets vb(int(m.vert.size()));
+  FillEdgeBuckets(m,vb,includeFauxEdge);
+  const int bn=vb.BucketNum();
+  std::vector<int> uniqueStart(bn+1,0);
+#pragma omp parallel for schedule(dynamic,4096)
+  for(int b=0;b<bn;++b)
+    for(int k=vb.start[b];k<vb.start[b+1];++k)
+      if(k==vb.start[b] || vb.entry[k].v!=vb.entry[k-1].v)
+        ++uniqueStart[b+1];
+  for(int b=0;b<bn;++b) uniqueStart[b+1]+=uniqueStart[b];
+  Edges.resize(uniqueStart[bn]);
+#pragma omp parallel for schedule(dynamic,4096)
+  for(int b=0;b<bn;++b)
+  {
+    int pos=uniqueStart[b];
+    for(int k=vb.start[b];k<vb.start[b+1];++k)
+      if(k==vb.start[b] || vb.entry[k].v!=vb.entry[k-1].v)
+        Edges[pos++].Set(&m.face[vb.entry[k].s],vb.entry[k].z);
+  }
+}
+
+/// \brief Same as FaceFace(), but the edges are matched by vertex buckets instead of a global sort, in parallel.
+/**
+Edges are bucketed by their lower vertex index with a counting sort and matched inside each bucket.
+Manifold edges get the same adjacency computed by FaceFace(); the faces around a non manifold edge
+are linked in a circular list in the order of the face vector.
+*/
+static void FaceFaceBucketed(MeshType &m)
+{
+  RequireFFAdjacency(m);
+  if( m.fn == 0 ) return;
+
+  VertexBuckets vb(int(m.vert.size()));
+  FillEdgeBuckets(m,vb);
+  const int bn=vb.BucketNum();
+#pragma omp parallel for schedule(dynamic,4096)
+  for(int b=0;b<bn;++b)
+  {
+    int ps=vb.start[b];
+    const int end=vb.start[b+1];
+    while(ps<end)
+    {
+      int pe=ps+1;
+      while(pe<end && vb.entry[pe].v==vb.entry[ps].v) ++pe;
+      for(int q=ps;q<pe;++q)
+      {
+        const typename VertexBuckets::Entry &next=vb.entry[q+1<pe ? q+1 : ps];
+        m.face[vb.entry[q].s].FFp(vb.entry[q].z) = &m.face[next.s];
+        m.face[vb.entry[q].s].FFi(vb.entry[q].z) = next.z;
+      }
+      ps=pe;
+    }
+  }
+}
+
 /// \brief Update the Vertex-Face topological relation.
 /**
 The function allows to retrieve for each vertex the list of faces sharing this vertex.
@@ -287,6 +433,75 @@ static void VertexFace(MeshType &m)
 }
 
 
+/// \brief Per thread partial VF lists of VertexFaceParallel(): first and last corner (face index and vertex index in the face) of the list of each vertex.
+struct LocalVFList
+{
+  std::vector<int> headF,tailF;
+  std::vector<char> headZ,tailZ;
+  void Init(int vn)
+  {
+    headF.resize(vn,-1); tailF.resize(vn,-1);
+    headZ.resize(vn,0);  tailZ.resize(vn,0);
+  }
+};
+
+/// \brief Same as VertexFace(), computed in parallel.
+/**
+Each thread builds the VF lists of a contiguous range of faces, then the partial lists of each
+vertex are joined in face order, so the resulting VF lists are exactly the ones built by VertexFace().
+*/
+static void VertexFaceParallel(MeshType &m)
+{
+  RequireVFAdjacency(m);
+
+  const int fn=int(m.face.size());
+  const int vn=int(m.vert.size());
+  std::vector<std::pair<int, LocalVFList*> > lists;
+#pragma omp parallel
+  {
+    LocalVFList l;
+    int first=fn;
+#pragma omp for schedule(static)
+    for(int i=0;i<fn;++i)
+    {
+      FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      if(first==fn) { first=i; l.Init(vn); }
+      for(int j=0;j<f.VN();++j)
+      {
+        const int v=tri::Index(m,f.V(j));
+        f.VFp(j) = (l.headF[v]<0) ? 0 : &m.face[l.headF[v]];
+        f.VFi(j) = l.headZ[v];
+        if(l.headF[v]<0) { l.tailF[v]=i; l.tailZ[v]=j; }
+        l.headF[v]=i; l.headZ[v]=j;
+      }
+    }
+#pragma omp critical (UpdateTopologyVFLists)
+    lists.push_back(std::make_pair(first,&l));
+#pragma omp barrier
+#pragma omp single
+    std::sort(lists.begin(),lists.end());
+#pragma omp for schedule(static)
+    for(int v=0;v<vn;++v)
+    {
+      FacePointer hp=0;
+      int hz=0;
+      for(size_t t=0;t<lists.size();++t)
+      {
+        if(lists[t].first==fn) continue;
+        const LocalVFList &lt=*lists[t].second;
+        if(lt.headF[v]<0) continue;
+        m.face[lt.tailF[v]].VFp(lt.tailZ[v]) = hp;
+        m.face[lt.tailF[v]].VFi(lt.tailZ[v]) = hz;
+        hp=&m.face[lt.headF[v]];
+        hz=lt.headZ[v];
+      }
+      m.vert[v].VFp() = hp;
+      m.vert[v].VFi() = hz;
+    }
+  }
+}
+
 /// \headerfile topology.h vcg/complex/algorithms/update/topology.h
 
 /// \brief Auxiliairy data structure for computing face face adjacency information.
@@ -571,6 +786,43 @@ static void EdgeEdge(MeshType &m)
    } while(true);
 }
 
+/// \brief Same as EdgeEdge(), computed in parallel by vertex buckets.
+/**
+The edges incident on a vertex are linked in a circular list in the order of the edge vector.
+*/
+static void EdgeEdgeBucketed(MeshType &m)
+{
+  RequireEEAdjacency(m);
+  if( m.en == 0 ) return;
+
+  const int en=int(m.edge.size());
+  VertexBuckets vb(int(m.vert.size()));
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<en;++i)
+    if( ! m.edge[i].IsD() )
+      for(int j=0;j<2;++j)
+        vb.Count(tri::Index(m,m.edge[i].V(j)));
+  vb.Allocate();
+  for(int i=0;i<en;++i)
+    if( ! m.edge[i].IsD() )
+      for(int j=0;j<2;++j)
+        vb.Put(tri::Index(m,m.edge[i].V(j)),-1,i,j);
+
+  const int bn=vb.BucketNum();
+#pragma omp parallel for schedule(dynamic,4096)
+  for(int b=0;b<bn;++b)
+  {
+    const int ps=vb.start[b];
+    const int pe=vb.start[b+1];
+    for(int q=ps;q<pe;++q)
+    {
+      const typename VertexBuckets::Entry &next=vb.entry[q+1<pe ? q+1 : ps];
+      m.edge[vb.entry[q].s].EEp(vb.entry[q].z) = &m.edge[next.s];
+      m.edge[vb.entry[q].s].EEi(vb.entry[q].z) = next.z;
+    }
+  }
+}
+
 static void VertexEdge(MeshType &m)
 {
   RequireVEAdjacency(m);
@@ -12,6 +12,7 @@
 #include <vcg/complex/all_types.h>
 #include <vcg/simplex/vertex/component.h>
 #include <vcg/simplex/vertex/component_ocf.h>
+#include <vcg/simplex/vertex/component_soa.h>
 #include <vcg/simplex/vertex/base.h>
 #include <vcg/simplex/face/component.h>
 #include <vcg/simplex/face/component_ocf.h>
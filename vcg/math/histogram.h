@@ -239,6 +239,14 @@ public:
 	 */
   void Add(ScalarType v, ScalarType increment=ScalarType(1.0));
 
+	/** 
+	 * Add all the values accumulated in another histogram.
+	 *
+	 * The two histograms must have been initialized with the same SetRange() call;
+	 * it is used to sum up the partial histograms built by different threads.
+	 */
+  void Merge(const Histogram &h);
+
   ScalarType MaxCount() const;
   int BinNum() const {return n;};
   ScalarType BinCount(ScalarType v);
@@ -380,6 +388,19 @@ void Histogram<ScalarType>::Add(ScalarType v, ScalarType increment)
 	}
 }
 
+template <class ScalarType> 
+void Histogram<ScalarType>::Merge(const Histogram &h)
+{
+  assert(n==h.n && H.size()==h.H.size());
+  for(size_t i=0;i<H.size();++i)
+    H[i]+=h.H[i];
+  if(h.minElem<minElem) minElem=h.minElem;
+  if(h.maxElem>maxElem) maxElem=h.maxElem;
+  cnt+=h.cnt;
+  avg+=h.avg;
+  rms+=h.rms;
+}
+
 template <class ScalarType> 
 ScalarType Histogram<ScalarType>::BinCount(ScalarType v)
 {
@@ -0,0 +1,246 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+/*
+SOA = Structure Of Arrays
+The data of the Soa components is not stored in the vertex but in a separate
+array of the container (one array for each component), like for the OCF
+components, but the arrays are always allocated.
+*/
+#ifndef __VCG_MESH
+#error "This file should not be included alone. It is automatically included by complex.h"
+#endif
+#ifndef __VCG_VERTEX_PLUS_COMPONENT_SOA
+#define __VCG_VERTEX_PLUS_COMPONENT_SOA
+
+namespace vcg {
+  namespace vertex {
+
+/** Vertex container that stores the Soa components in contiguous arrays.
+
+The vertex type must have InfoSoa as its first component; the components with
+the Soa suffix (Coord3fSoa, Normal3fSoa, BitFlagsSoa, VFAdjSoa...) keep the usual
+accessors (P(), N(), Flags(), VFp()...) so every algorithm works unchanged, but
+a kernel that touches only the positions streams only the PV array instead of
+whole vertices. The arrays are public, for kernels that want to use them directly:
+going through the accessors costs an index computation per access, so the
+generic code is usually slower than on a std::vector. UpdateBounding::Box,
+UpdateNormal::PerVertex* / NormalizePerVertex and Smooth::VertexCoordLaplacian
+have overloads that work on the arrays.
+
+As for vector_ocf, a vertex must not be copied outside its container: the
+copy would still refer to the data of the original slot. Use ImportData.
+*/
+template <class VALUE_TYPE>
+class vector_soa: public std::vector<VALUE_TYPE> {
+  typedef std::vector<VALUE_TYPE> BaseType;
+  typedef typename vector_soa<VALUE_TYPE>::iterator ThisTypeIterator;
+
+public:
+  struct VFAdjType {
+    typename VALUE_TYPE::FacePointer _fp ;
+    int _zp ;
+  };
+
+  vector_soa():std::vector<VALUE_TYPE>() {}
+
+////////////////////////////////////////
+// All the standard methods of std::vector that can change the size are
+// redefined in order to manage the arrays. The new entries are default
+// initialized (i.e. the data of the vertex passed to push_back is not copied).
+  void push_back(const VALUE_TYPE & v)
+  {
+    BaseType::push_back(v);
+    BaseType::back()._svp = this;
+    if (VALUE_TYPE::HasCoordSoa())         PV.push_back(typename VALUE_TYPE::CoordType());
+    if (VALUE_TYPE::HasNormalSoa())        NV.push_back(typename VALUE_TYPE::NormalType());
+    if (VALUE_TYPE::HasFlagsSoa())         FV.push_back(0);
+    if (VALUE_TYPE::HasVFAdjacencySoa())   AV.push_back(ZeroVFAdj());
+  }
+
+  void pop_back()
+  {
+    BaseType::pop_back();
+    if (VALUE_TYPE::HasCoordSoa())         PV.pop_back();
+    if (VALUE_TYPE::HasNormalSoa())        NV.pop_back();
+    if (VALUE_TYPE::HasFlagsSoa())         FV.pop_back();
+    if (VALUE_TYPE::HasVFAdjacencySoa())   AV.pop_back();
+  }
+
+  void resize(const unsigned int & _size)
+  {
+    const unsigned int oldsize = BaseType::size();
+    BaseType::resize(_size);
+    if(oldsize<_size){
+      ThisTypeIterator firstnew = BaseType::begin();
+      advance(firstnew,oldsize);
+      _updateSVP(firstnew,(*this).end());
+    }
+    if (VALUE_TYPE::HasCoordSoa())         PV.resize(_size);
+    if (VALUE_TYPE::HasNormalSoa())        NV.resize(_size);
+    if (VALUE_TYPE::HasFlagsSoa())         FV.resize(_size,0);
+    if (VALUE_TYPE::HasVFAdjacencySoa())   AV.resize(_size,ZeroVFAdj());
+  }
+
+  void reserve(const unsigned int & _size)
+  {
+    BaseType::reserve(_size);
+    if (VALUE_TYPE::HasCoordSoa())         PV.reserve(_size);
+    if (VALUE_TYPE::HasNormalSoa())        NV.reserve(_size);
+    if (VALUE_TYPE::HasFlagsSoa())         FV.reserve(_size);
+    if (VALUE_TYPE::HasVFAdjacencySoa())   AV.reserve(_size);
+  }
+
+  void clear()
+  {
+    BaseType::clear();
+    PV.clear();
+    NV.clear();
+    FV.clear();
+    AV.clear();
+  }
+
+  void _updateSVP(ThisTypeIterator lbegin, ThisTypeIterator lend)
+  {
+    ThisTypeIterator vi;
+    for(vi=lbegin;vi!=lend;++vi)
+        (*vi)._svp=this;
+  }
+
+  static VFAdjType ZeroVFAdj() { VFAdjType zero; zero._fp=0; zero._zp=-1; return zero; }
+
+public:
+  std::vector<typename VALUE_TYPE::CoordType> PV;
+  std::vector<typename VALUE_TYPE::NormalType> NV;
+  std::vector<int> FV;
+  std::vector<VFAdjType> AV;
+};
+
+/*-------------------------- COORD ----------------------------------------*/
+
+template <class A, class T> class CoordSoa: public T {
+public:
+  typedef A CoordType;
+  typedef typename A::ScalarType      ScalarType;
+  inline const CoordType &P() const { return (*this).Base().PV[(*this).Index()]; }
+  inline       CoordType &P()       { return (*this).Base().PV[(*this).Index()]; }
+  inline       CoordType cP() const { return (*this).Base().PV[(*this).Index()]; }
+
+  template < class RightValueType>
+  void ImportData(const RightValueType  & rVert ) { if(rVert.IsCoordEnabled()) P().Import(rVert.cP()); T::ImportData( rVert); }
+  static bool HasCoord()   { return true; }
+  static bool HasCoordSoa()   { return true; }
+};
+template <class T> class Coord3fSoa: public CoordSoa<vcg::Point3f, T> {
+public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Coord3fSoa"));T::Name(name);}
+};
+template <class T> class Coord3dSoa: public CoordSoa<vcg::Point3d, T> {
+public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Coord3dSoa"));T::Name(name);}
+};
+
+/*-------------------------- NORMAL ----------------------------------------*/
+
+template <class A, class T> class NormalSoa: public T {
+public:
+  typedef A NormalType;
+  inline const NormalType &N() const { return (*this).Base().NV[(*this).Index()]; }
+  inline       NormalType &N()       { return (*this).Base().NV[(*this).Index()]; }
+  inline       NormalType cN() const { return (*this).Base().NV[(*this).Index()]; }
+
+  template < class RightValueType>
+  void ImportData(const RightValueType  & rVert ){
+    if(rVert.IsNormalEnabled())  N().Import(rVert.cN());
+    T::ImportData( rVert);
+  }
+  static bool HasNormal()   { return true; }
+  static bool HasNormalSoa()   { return true; }
+};
+template <class T> class Normal3fSoa: public NormalSoa<vcg::Point3f, T> {
+public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Normal3fSoa"));T::Name(name);}
+};
+template <class T> class Normal3dSoa: public NormalSoa<vcg::Point3d, T> {
+public: static void Name(std::vector<std::string> & name){name.push_back(std::string("Normal3dSoa"));T::Name(name);}
+};
+
+/*-------------------------- FLAGS ----------------------------------------*/
+
+template <class T> class BitFlagsSoa:  public T {
+public:
+  typedef int FlagType;
+  inline const int &Flags() const { return (*this).Base().FV[(*this).Index()]; }
+  inline       int &Flags()       { return (*this).Base().FV[(*this).Index()]; }
+  inline       int cFlags() const { return (*this).Base().FV[(*this).Index()]; }
+  template < class RightValueType>
+  void ImportData(const RightValueType  & rVert ) { if(RightValueType::HasFlags()) Flags() = rVert.cFlags(); T::ImportData( rVert); }
+  static bool HasFlags()   { return true; }
+  static bool HasFlagsSoa()   { return true; }
+  static void Name(std::vector<std::string> & name){name.push_back(std::string("BitFlagsSoa"));T::Name(name);}
+};
+
+/*----------------------------- VFADJ ------------------------------*/
+
+template <class T> class VFAdjSoa: public T {
+public:
+  typename T::FacePointer &VFp()       { return (*this).Base().AV[(*this).Index()]._fp; }
+  typename T::FacePointer cVFp() const { return (*this).Base().AV[(*this).Index()]._fp; }
+  int &VFi()       { return (*this).Base().AV[(*this).Index()]._zp; }
+  int cVFi() const { return (*this).Base().AV[(*this).Index()]._zp; }
+  template < class RightValueType>
+  void ImportData(const RightValueType  & rVert ) { T::ImportData( rVert); }
+  static bool HasVFAdjacency()   {   return true; }
+  static bool HasVFAdjacencySoa()   {   return true; }
+  static void Name(std::vector<std::string> & name){name.push_back(std::string("VFAdjSoa"));T::Name(name);}
+};
+
+///*-------------------------- InfoSoa  ----------------------------------*/
+
+template < class T> class InfoSoa: public T {
+public:
+  InfoSoa():_svp(0) {}
+
+  // You should never ever try to copy a vertex that has SOA stuff.
+  // use ImportData function.
+  inline InfoSoa &operator=(const InfoSoa & /*other*/) {
+    assert(0); return *this;
+  }
+
+  vector_soa<typename T::VertexType> &Base() const { return *_svp;}
+
+  inline int Index() const {
+    typename  T::VertexType const *tp=static_cast<typename T::VertexType const*>(this);
+    int tt2=tp- &*(_svp->begin());
+    return tt2;
+  }
+public:
+  vector_soa<typename T::VertexType> *_svp;
+
+  static bool HasCoordSoa()   { return false; }
+  static bool HasNormalSoa()   { return false; }
+  static bool HasFlagsSoa()   { return false; }
+  static bool HasVFAdjacencySoa()   { return false; }
+  static void Name(std::vector<std::string> & name){name.push_back(std::string("InfoSoa"));T::Name(name);}
+};
+
+  } // end namespace vertex
+}// end namespace vcg
+#endif
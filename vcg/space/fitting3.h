@@ -49,7 +49,7 @@ void ComputeCovarianceMatrix(const std::vector<Point3<S> > &pointVec, Point3<S>
 
   // second cycle: compute the covariance matrix
   m.setZero();
-  Eigen::Vector3f p;
+  Eigen::Matrix<S,3,1> p;
   for(pit = pointVec.begin(); pit != pointVec.end(); ++pit) {
     ((*pit)-barycenter).ToEigenVector(p);
     m+= p*p.transpose(); // outer product
@@ -64,13 +64,13 @@ The algorithm used is the classical Covariance matrix eigenvector approach.
 template <class S>
 void FitPlaneToPointSet(const std::vector< Point3<S> > & pointVec, Plane3<S> & plane)
 {
-  Eigen::Matrix3f covMat=Eigen::Matrix3f::Zero();
+  Eigen::Matrix<S,3,3> covMat=Eigen::Matrix<S,3,3>::Zero();
   Point3<S> b;
   ComputeCovarianceMatrix(pointVec,b,covMat);
 
-  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eig(covMat);
-  Eigen::Vector3f eval = eig.eigenvalues();
-  Eigen::Matrix3f evec = eig.eigenvectors();
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<S,3,3> > eig(covMat);
+  Eigen::Matrix<S,3,1> eval = eig.eigenvalues();
+  Eigen::Matrix<S,3,3> evec = eig.eigenvectors();
   eval = eval.cwiseAbs();
   int minInd;
   eval.minCoeff(&minInd);
@@ -57,11 +57,12 @@ public:
 	typedef typename TreeType::NodeType NodeType;
 	typedef typename TreeType::ObjPtr ObjPtr;
 
+	// The squared distances of the nodes from the query point are kept in local vectors
+	// (not in the nodes), so that many threads can query the same tree at the same time.
 	template <class OBJPOINTDISTANCEFUNCT>
 	static inline ObjPtr Closest(TreeType & tree, OBJPOINTDISTANCEFUNCT & getPointDistance, const CoordType & p, const ScalarType & maxDist, ScalarType & minDist, CoordType & q) {
 		typedef OBJPOINTDISTANCEFUNCT ObjPointDistanceFunct;
 		typedef std::vector<NodeType *> NodePtrVector;
-		typedef typename NodePtrVector::const_iterator NodePtrVector_ci;
 
 		NodeType * pRoot = tree.pRoot;
 
@@ -72,17 +73,17 @@ public:
 		NodePtrVector clist1;
 		NodePtrVector clist2;
 		NodePtrVector leaves;
+		std::vector<ScalarType> cdist;
+		std::vector<ScalarType> leavesDist;
 
 		NodePtrVector * candidates = &clist1;
 		NodePtrVector * newCandidates = &clist2;
 
-		clist1.reserve(tree.pObjects.size());
-		clist2.reserve(tree.pObjects.size());
-		leaves.reserve(tree.pObjects.size());
-
-		clist1.resize(0);
-		clist2.resize(0);
-		leaves.resize(0);
+		clist1.reserve(256);
+		clist2.reserve(256);
+		cdist.reserve(256);
+		leaves.reserve(256);
+		leavesDist.reserve(256);
 
 		ScalarType minMaxDist = maxDist * maxDist;
 
@@ -90,27 +91,32 @@ public:
 
 		while (!candidates->empty()) {
 			newCandidates->resize(0);
-
-			for (NodePtrVector_ci bv=candidates->begin(); bv!=candidates->end(); ++bv) {
-				const CoordType dc = Abs(p - (*bv)->boxCenter);
-				const ScalarType maxDist = (dc + (*bv)->boxHalfDims).SquaredNorm();
-				(*bv)->ScalarValue() = LowClampToZero(dc - (*bv)->boxHalfDims).SquaredNorm();
+			const size_t cn = candidates->size();
+			cdist.resize(cn);
+
+			for (size_t i=0; i<cn; ++i) {
+				const NodeType * bv = (*candidates)[i];
+				const CoordType dc = Abs(p - bv->boxCenter);
+				const ScalarType maxDist = (dc + bv->boxHalfDims).SquaredNorm();
+				cdist[i] = LowClampToZero(dc - bv->boxHalfDims).SquaredNorm();
 				if (maxDist < minMaxDist) {
 					minMaxDist = maxDist;
 				}
 			}
 
-			for (NodePtrVector_ci ci=candidates->begin(); ci!=candidates->end(); ++ci) {
-				if ((*ci)->ScalarValue() < minMaxDist) {
-					if ((*ci)->IsLeaf()) {
-						leaves.push_back(*ci);
+			for (size_t i=0; i<cn; ++i) {
+				NodeType * ci = (*candidates)[i];
+				if (cdist[i] < minMaxDist) {
+					if (ci->IsLeaf()) {
+						leaves.push_back(ci);
+						leavesDist.push_back(cdist[i]);
 					}
 					else {
-						if ((*ci)->children[0] != 0) {
-							newCandidates->push_back((*ci)->children[0]);
+						if (ci->children[0] != 0) {
+							newCandidates->push_back(ci->children[0]);
 						}
-						if ((*ci)->children[1] != 0) {
-							newCandidates->push_back((*ci)->children[1]);
+						if (ci->children[1] != 0) {
+							newCandidates->push_back(ci->children[1]);
 						}
 					}
 				}
@@ -120,18 +126,15 @@ public:
 			newCandidates = cSwap;
 		}
 
-		clist1.clear();
-		clist2.clear();
-
 		ObjPtr closestObject = 0;
 		CoordType closestPoint;
 		ScalarType closestDist = math::Sqrt(minMaxDist) + std::numeric_limits<ScalarType>::epsilon();
 		ScalarType closestDistSq = closestDist * closestDist;
 
 
-		for (NodePtrVector_ci ci=leaves.begin(); ci!=leaves.end(); ++ci) {
-			if ((*ci)->ScalarValue() < closestDistSq) {
-				for (typename TreeType::ObjPtrVectorConstIterator si=(*ci)->oBegin; si!=(*ci)->oEnd; ++si) {
+		for (size_t i=0; i<leaves.size(); ++i) {
+			if (leavesDist[i] < closestDistSq) {
+				for (typename TreeType::ObjPtrVectorConstIterator si=leaves[i]->oBegin; si!=leaves[i]->oEnd; ++si) {
 					if (getPointDistance(*(*si), p, closestDist, closestPoint)) {
 						closestDistSq = closestDist * closestDist;
 						closestObject = (*si);
@@ -142,8 +145,6 @@ public:
 			}
 		}
 
-		leaves.clear();
-
 		return (closestObject);
 	}
 
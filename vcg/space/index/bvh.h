@@ -0,0 +1,803 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_BVH_INDEX_H
+#define __VCGLIB_BVH_INDEX_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <cmath>
+
+#include <vcg/space/index/base.h>
+#include <vcg/space/box3.h>
+#include <vcg/space/ray3.h>
+
+namespace vcg {
+
+/** Bounding Volume Hierarchy of axis aligned boxes.
+
+The tree is built with the binned Surface Area Heuristic and it is stored as
+a single array of 32 bytes nodes in depth first order: the first child of an
+inner node is the node that follows it, the second child is at Node::offset.
+A leaf refers to Node::count consecutive entries of the (reordered) array of
+object pointers. Node boxes are always single precision, rounded outward.
+
+Each object is referenced by exactly one leaf, so the marker passed to the
+queries is ignored and concurrent queries on the same index are safe.
+
+It exposes the usual SpatialIndex interface, so it can be used everywhere a
+GridStaticPtr is used, e.g. tri::DoRay() and tri::GetClosestFaceBase().
+Objects must expose GetBBox() and IsD(); deleted objects are not indexed.
+*/
+template <class OBJTYPE, class SCALARTYPE>
+class BVHIndex : public SpatialIndex<OBJTYPE, SCALARTYPE>
+{
+public:
+  typedef BVHIndex<OBJTYPE, SCALARTYPE> ClassType;
+  typedef OBJTYPE ObjType;
+  typedef SCALARTYPE ScalarType;
+  typedef ObjType * ObjPtr;
+  typedef Point3<ScalarType> CoordType;
+  typedef Box3<ScalarType> Box3x;
+
+  class Node
+  {
+  public:
+    float bmin[3];
+    float bmax[3];
+    int offset;            ///< second child for inner nodes, first object for leaves
+    unsigned short count;  ///< number of objects of a leaf, 0 for inner nodes
+    unsigned short axis;   ///< split axis of inner nodes, used to order the traversal
+    bool IsLeaf() const { return count>0; }
+  };
+
+  std::vector<Node>   nodes;
+  std::vector<ObjPtr> objs;
+
+  /// Leaves with at most this number of objects are made when the SAH says it is convenient.
+  int maxObjPerLeaf;
+
+  BVHIndex():maxObjPerLeaf(4){}
+
+  bool Empty() const { return nodes.empty(); }
+
+  int MemUsed() const
+  {
+    return int(sizeof(ClassType)+sizeof(Node)*nodes.size()+sizeof(ObjPtr)*objs.size());
+  }
+
+  Box3x BBox() const
+  {
+    Box3x b;
+    if(!nodes.empty())
+    {
+      b.min=CoordType(nodes[0].bmin[0],nodes[0].bmin[1],nodes[0].bmin[2]);
+      b.max=CoordType(nodes[0].bmax[0],nodes[0].bmax[1],nodes[0].bmax[2]);
+    }
+    return b;
+  }
+
+  template <class OBJITER>
+  void Set(const OBJITER & _oBegin, const OBJITER & _oEnd)
+  {
+    nodes.clear();
+    objs.clear();
+    for(OBJITER i=_oBegin; i!=_oEnd; ++i)
+      if(!(*i).IsD()) objs.push_back(&(*i));
+    const int n=int(objs.size());
+    if(n==0) return;
+
+    BuildData bd;
+    bd.box.resize(n);
+    bd.center.resize(n);
+    bd.index.resize(n);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<n;++i)
+    {
+      objs[i]->GetBBox(bd.box[i]);
+      bd.center[i]=bd.box[i].Center();
+      bd.index[i]=i;
+    }
+    nodes.reserve(2*n/std::max(1,maxObjPerLeaf)+1);
+    Build(bd,0,n,0);
+
+    std::vector<ObjPtr> sorted(n);
+    for(int i=0;i<n;++i) sorted[i]=objs[bd.index[i]];
+    objs.swap(sorted);
+  }
+
+  /**************************************************************************
+  Queries. They follow the SpatialIndex interface; see vcg/space/index/base.h.
+  **************************************************************************/
+
+  template <class OBJPOINTDISTFUNCTOR, class OBJMARKER>
+  ObjPtr GetClosest(OBJPOINTDISTFUNCTOR & _getPointDistance, OBJMARKER & /*_marker*/,
+                    const typename OBJPOINTDISTFUNCTOR::QueryType & _p_obj, const ScalarType & _maxDist,
+                    ScalarType & _minDist, CoordType & _closestPt)
+  {
+    _minDist=_maxDist;
+    if(nodes.empty()) return 0;
+    const CoordType p=OBJPOINTDISTFUNCTOR::Pos(_p_obj);
+    ObjPtr winner=0;
+    CoordType q;
+
+    StackEntry stack[MaxStackSize];
+    int sp=0;
+    stack[sp].node=0; stack[sp].dist2=0; ++sp;
+    while(sp>0)
+    {
+      --sp;
+      if(stack[sp].dist2>_minDist*_minDist) continue;
+      const Node &nd=nodes[stack[sp].node];
+      if(nd.IsLeaf())
+      {
+        for(int k=nd.offset;k<nd.offset+nd.count;++k)
+          if(_getPointDistance(*objs[k],_p_obj,_minDist,q))
+          {
+            winner=objs[k];
+            _closestPt=q;
+          }
+        continue;
+      }
+      PushChildren(stack,sp,nd,stack[sp].node,p,_minDist*_minDist);
+    }
+    return winner;
+  }
+
+  template <class OBJPOINTDISTFUNCTOR, class OBJMARKER, class OBJPTRCONTAINER, class DISTCONTAINER, class POINTCONTAINER>
+  unsigned int GetKClosest(OBJPOINTDISTFUNCTOR & _getPointDistance, OBJMARKER & /*_marker*/,
+                           const unsigned int _k, const CoordType & _p, const ScalarType & _maxDist,
+                           OBJPTRCONTAINER & _objectPtrs, DISTCONTAINER & _distances, POINTCONTAINER & _points)
+  {
+    _objectPtrs.clear();
+    _distances.clear();
+    _points.clear();
+    if(nodes.empty() || _k==0) return 0;
+    // the current k best, sorted by increasing distance
+    std::vector<Candidate> best;
+    best.reserve(_k+1);
+    StackEntry stack[MaxStackSize];
+    int sp=0;
+    stack[sp].node=0; stack[sp].dist2=0; ++sp;
+    while(sp>0)
+    {
+      --sp;
+      ScalarType r = (best.size()==_k) ? best.back().dist : _maxDist;
+      if(stack[sp].dist2>r*r) continue;
+      const Node &nd=nodes[stack[sp].node];
+      if(nd.IsLeaf())
+      {
+        for(int k=nd.offset;k<nd.offset+nd.count;++k)
+        {
+          Candidate c;
+          c.dist=r;
+          if(_getPointDistance(*objs[k],_p,c.dist,c.point))
+          {
+            c.obj=objs[k];
+            best.insert(std::upper_bound(best.begin(),best.end(),c),c);
+            if(best.size()>_k) best.pop_back();
+            r = (best.size()==_k) ? best.back().dist : _maxDist;
+          }
+        }
+        continue;
+      }
+      PushChildren(stack,sp,nd,stack[sp].node,_p,r*r);
+    }
+    for(size_t i=0;i<best.size();++i)
+    {
+      _objectPtrs.push_back(best[i].obj);
+      _distances.push_back(best[i].dist);
+      _points.push_back(best[i].point);
+    }
+    return (unsigned int)(best.size());
+  }
+
+  template <class OBJPOINTDISTFUNCTOR, class OBJMARKER, class OBJPTRCONTAINER, class DISTCONTAINER, class POINTCONTAINER>
+  unsigned int GetInSphere(OBJPOINTDISTFUNCTOR & _getPointDistance, OBJMARKER & /*_marker*/,
+                           const CoordType & _p, const ScalarType & _r,
+                           OBJPTRCONTAINER & _objectPtrs, DISTCONTAINER & _distances, POINTCONTAINER & _points)
+  {
+    _objectPtrs.clear();
+    _distances.clear();
+    _points.clear();
+    if(nodes.empty()) return 0;
+    std::vector<Candidate> found;
+    StackEntry stack[MaxStackSize];
+    int sp=0;
+    stack[sp].node=0; stack[sp].dist2=0; ++sp;
+    while(sp>0)
+    {
+      --sp;
+      const Node &nd=nodes[stack[sp].node];
+      if(nd.IsLeaf())
+      {
+        for(int k=nd.offset;k<nd.offset+nd.count;++k)
+        {
+          Candidate c;
+          c.dist=_r;
+          if(_getPointDistance(*objs[k],_p,c.dist,c.point))
+          {
+            c.obj=objs[k];
+            found.push_back(c);
+          }
+        }
+        continue;
+      }
+      PushChildren(stack,sp,nd,stack[sp].node,_p,_r*_r);
+    }
+    // same order of the other indexes: by increasing distance
+    std::sort(found.begin(),found.end());
+    for(size_t i=0;i<found.size();++i)
+    {
+      _objectPtrs.push_back(found[i].obj);
+      _distances.push_back(found[i].dist);
+      _points.push_back(found[i].point);
+    }
+    return (unsigned int)(found.size());
+  }
+
+  template <class OBJMARKER, class OBJPTRCONTAINER>
+  unsigned int GetInBox(OBJMARKER & /*_marker*/, const Box3x _bbox, OBJPTRCONTAINER & _objectPtrs)
+  {
+    _objectPtrs.clear();
+    if(nodes.empty()) return 0;
+    int stack[MaxStackSize];
+    int sp=0;
+    stack[sp++]=0;
+    while(sp>0)
+    {
+      const int ni=stack[--sp];
+      const Node &nd=nodes[ni];
+      if(!BoxCollide(nd,_bbox)) continue;
+      if(nd.IsLeaf())
+      {
+        for(int k=nd.offset;k<nd.offset+nd.count;++k)
+        {
+          Box3x b;
+          objs[k]->GetBBox(b);
+          if(b.Collide(_bbox)) _objectPtrs.push_back(objs[k]);
+        }
+        continue;
+      }
+      stack[sp++]=nd.offset;
+      stack[sp++]=ni+1;
+    }
+    return (unsigned int)(_objectPtrs.size());
+  }
+
+  /// First intersection along the ray. As for AABBBinaryTreeIndex, _maxDist is measured along the ray direction.
+  template <class OBJRAYISECTFUNCTOR, class OBJMARKER>
+  ObjPtr DoRay(OBJRAYISECTFUNCTOR & _rayIntersector, OBJMARKER & /*_marker*/,
+               const Ray3<ScalarType> & _ray, const ScalarType & _maxDist, ScalarType & _t)
+  {
+    if(nodes.empty()) return 0;
+    RayEx rx(_ray);
+    ScalarType tMax=_maxDist/_ray.Direction().Norm();
+    ObjPtr winner=0;
+    int stack[MaxStackSize];
+    int sp=0;
+    int ni=0;
+    for(;;)
+    {
+      const Node &nd=nodes[ni];
+      if(RayBox(nd,rx,tMax))
+      {
+        if(nd.IsLeaf())
+        {
+          for(int k=nd.offset;k<nd.offset+nd.count;++k)
+          {
+            ScalarType t;
+            if(_rayIntersector(*objs[k],_ray,t) && t<tMax)
+            {
+              tMax=t;
+              winner=objs[k];
+            }
+          }
+        }
+        else
+        {
+          // visit first the child on the side the ray comes from
+          if(rx.neg[nd.axis]) { stack[sp++]=ni+1; ni=nd.offset; }
+          else                { stack[sp++]=nd.offset; ni=ni+1; }
+          continue;
+        }
+      }
+      if(sp==0) break;
+      ni=stack[--sp];
+    }
+    if(winner) _t=tMax;
+    return winner;
+  }
+
+  /** Packet version of DoRay for coherent rays (e.g. primary rays of a camera, or
+  rays shot from neighbouring points). Rays are traversed PacketSize at a time with
+  a shared stack: a node is visited if at least one ray of the packet hits its box.
+  For each ray it returns the hit object (0 if none) in _hits and its parameter in _t.
+  */
+  template <class OBJRAYISECTFUNCTOR>
+  void DoRayPacket(OBJRAYISECTFUNCTOR & _rayIntersector, const Ray3<ScalarType> *_rays, const int _n,
+                   const ScalarType & _maxDist, ObjPtr *_hits, ScalarType *_t)
+  {
+    for(int i=0;i<_n;++i) _hits[i]=0;
+    if(nodes.empty()) return;
+    for(int start=0;start<_n;start+=PacketSize)
+    {
+      const int cnt=std::min(int(PacketSize),_n-start);
+      RayEx rx[PacketSize];
+      ScalarType tMax[PacketSize];
+      RayPacket pk;
+      for(int r=0;r<PacketSize;++r)
+      {
+        rx[r]=RayEx(_rays[start+std::min(r,cnt-1)]);
+        tMax[r]=_maxDist/_rays[start+std::min(r,cnt-1)].Direction().Norm();
+        pk.Set(r,rx[r],tMax[r]);
+      }
+      // Each stack entry keeps the rays that hit the parent box, so that a ray that
+      // misses a node is not tested against its subtree. The near-far order of the
+      // children is decided by the first ray of the packet.
+      int stackNode[MaxStackSize];
+      unsigned int stackMask[MaxStackSize];
+      int sp=0;
+      int ni=0;
+      unsigned int mask=(1u<<cnt)-1;
+      for(;;)
+      {
+        const Node &nd=nodes[ni];
+        const unsigned int active=PacketBox(nd,pk)&mask;
+        if(active)
+        {
+          if(nd.IsLeaf())
+          {
+            for(int k=nd.offset;k<nd.offset+nd.count;++k)
+              for(int r=0;r<cnt;++r)
+                if(active&(1u<<r))
+                {
+                  ScalarType t;
+                  if(_rayIntersector(*objs[k],_rays[start+r],t) && t<tMax[r])
+                  {
+                    tMax[r]=t;
+                    pk.tMax[r]=t;
+                    _hits[start+r]=objs[k];
+                  }
+                }
+          }
+          else
+          {
+            stackMask[sp]=active;
+            if(rx[0].neg[nd.axis]) { stackNode[sp++]=ni+1; ni=nd.offset; }
+            else                   { stackNode[sp++]=nd.offset; ni=ni+1; }
+            mask=active;
+            continue;
+          }
+        }
+        if(sp==0) break;
+        --sp;
+        ni=stackNode[sp];
+        mask=stackMask[sp];
+      }
+      for(int r=0;r<cnt;++r)
+        if(_hits[start+r]) _t[start+r]=tMax[r];
+    }
+  }
+
+  /** Self traversal: all the pairs of distinct objects whose bounding boxes overlap (closed
+  boxes, so flat objects lying on the same plane are found) are passed to _pairTest(a,b), and
+  the pairs for which it returns true are appended to _pairs, each pair once, in an unspecified
+  order and with the two objects in an unspecified order.
+  The hierarchy is traversed against itself; the first levels of the traversal are expanded
+  into independent pairs of subtrees that are processed in parallel, so _pairTest must be safe
+  to call from different threads.
+  */
+  template <class OBJPAIRTESTFUNCTOR>
+  void GetOverlappingPairs(OBJPAIRTESTFUNCTOR & _pairTest, std::vector<std::pair<ObjPtr,ObjPtr> > & _pairs)
+  {
+    if(nodes.empty()) return;
+    const int n=int(objs.size());
+    std::vector<Box3x> obox(n);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<n;++i)
+      objs[i]->GetBBox(obox[i]);
+
+    // breadth first expansion of the pairs of subtrees, until there are enough of them
+    std::vector<std::pair<int,int> > task(1,std::make_pair(0,0)), next;
+    while(task.size()<SelfTaskNum)
+    {
+      bool split=false;
+      next.clear();
+      for(size_t i=0;i<task.size();++i)
+        split|=ExpandPair(task[i].first,task[i].second,next);
+      task.swap(next);
+      if(!split) break;
+    }
+
+    const int taskNum=int(task.size());
+#pragma omp parallel
+    {
+      std::vector<std::pair<ObjPtr,ObjPtr> > localPairs;
+      std::vector<std::pair<int,int> > stack, children;
+#pragma omp for schedule(dynamic,1) nowait
+      for(int t=0;t<taskNum;++t)
+      {
+        stack.push_back(task[t]);
+        while(!stack.empty())
+        {
+          const std::pair<int,int> np=stack.back();
+          stack.pop_back();
+          const Node &na=nodes[np.first], &nb=nodes[np.second];
+          if(na.IsLeaf() && nb.IsLeaf())
+          {
+            for(int a=na.offset;a<na.offset+na.count;++a)
+              for(int b=(np.first==np.second ? a+1 : nb.offset);b<nb.offset+nb.count;++b)
+                if(BoxOverlap(obox[a],obox[b]) && _pairTest(*objs[a],*objs[b]))
+                  localPairs.push_back(std::make_pair(objs[a],objs[b]));
+            continue;
+          }
+          children.clear();
+          ExpandPair(np.first,np.second,children);
+          stack.insert(stack.end(),children.begin(),children.end());
+        }
+      }
+#pragma omp critical (bvhOverlappingPairs)
+      _pairs.insert(_pairs.end(),localPairs.begin(),localPairs.end());
+    }
+  }
+
+protected:
+  enum { MaxStackSize = 128, PacketSize = 8, BinNum = 16, MedianSplitDepth = 48, SelfTaskNum = 1024 };
+
+  class BuildData
+  {
+  public:
+    std::vector<Box3x> box;
+    std::vector<CoordType> center;
+    std::vector<int> index;
+  };
+
+  class StackEntry
+  {
+  public:
+    int node;
+    ScalarType dist2;
+  };
+
+  class Candidate
+  {
+  public:
+    ObjPtr obj;
+    ScalarType dist;
+    CoordType point;
+    bool operator < (const Candidate &c) const { return dist<c.dist; }
+  };
+
+  class RayEx
+  {
+  public:
+    CoordType orig;
+    CoordType invDir;
+    bool neg[3];
+    RayEx(){}
+    RayEx(const Ray3<ScalarType> &r)
+    {
+      orig=r.Origin();
+      for(int i=0;i<3;++i)
+      {
+        invDir[i]=ScalarType(1)/r.Direction()[i];
+        neg[i]=invDir[i]<0;
+      }
+    }
+  };
+
+  /// Structure of arrays copy of a packet of rays, used by the box tests.
+  class RayPacket
+  {
+  public:
+    ScalarType orig[3][PacketSize];
+    ScalarType invDir[3][PacketSize];
+    ScalarType tMax[PacketSize];
+    void Set(const int r, const RayEx &rx, const ScalarType t)
+    {
+      for(int i=0;i<3;++i)
+      {
+        orig[i][r]=rx.orig[i];
+        invDir[i][r]=rx.invDir[i];
+      }
+      tMax[r]=t;
+    }
+  };
+
+  static float RoundDown(const ScalarType v)
+  {
+    float f=float(v);
+    if(ScalarType(f)>v) f-=std::max(std::fabs(f)*std::numeric_limits<float>::epsilon(),std::numeric_limits<float>::min());
+    return f;
+  }
+  static float RoundUp(const ScalarType v)
+  {
+    float f=float(v);
+    if(ScalarType(f)<v) f+=std::max(std::fabs(f)*std::numeric_limits<float>::epsilon(),std::numeric_limits<float>::min());
+    return f;
+  }
+
+  static ScalarType HalfArea(const Box3x &b)
+  {
+    if(b.IsNull()) return 0;
+    const CoordType d=b.Dim();
+    return d[0]*d[1]+d[1]*d[2]+d[2]*d[0];
+  }
+
+  /// Recursively build the subtree of the objects bd.index[begin,end); returns the index of its root.
+  int Build(BuildData &bd, const int begin, const int end, const int depth)
+  {
+    const int ni=int(nodes.size());
+    nodes.push_back(Node());
+    Box3x nodeBox, centerBox;
+    for(int i=begin;i<end;++i)
+    {
+      nodeBox.Add(bd.box[bd.index[i]]);
+      centerBox.Add(bd.center[bd.index[i]]);
+    }
+    for(int i=0;i<3;++i)
+    {
+      nodes[ni].bmin[i]=RoundDown(nodeBox.min[i]);
+      nodes[ni].bmax[i]=RoundUp(nodeBox.max[i]);
+    }
+    const int n=end-begin;
+    if(n<=1)
+    {
+      MakeLeaf(ni,begin,n);
+      return ni;
+    }
+
+    // Binned SAH: try BinNum-1 split planes along each axis of the centers box
+    int bestAxis=-1, bestSplit=-1;
+    ScalarType bestCost=std::numeric_limits<ScalarType>::max();
+    const CoordType cDim=centerBox.Dim();
+    if(depth<MedianSplitDepth)
+      for(int axis=0;axis<3;++axis)
+      {
+        if(!(cDim[axis]>0)) continue;
+        const ScalarType scale=ScalarType(BinNum)/cDim[axis];
+        Box3x binBox[BinNum];
+        int binCnt[BinNum];
+        for(int b=0;b<BinNum;++b) binCnt[b]=0;
+        for(int i=begin;i<end;++i)
+        {
+          const int b=BinOf(bd.center[bd.index[i]][axis],centerBox.min[axis],scale);
+          binCnt[b]++;
+          binBox[b].Add(bd.box[bd.index[i]]);
+        }
+        // sweep from the right to get the cost of the right side of each plane
+        ScalarType rightArea[BinNum];
+        int rightCnt[BinNum];
+        Box3x acc;
+        int cnt=0;
+        for(int b=BinNum-1;b>0;--b)
+        {
+          acc.Add(binBox[b]);
+          cnt+=binCnt[b];
+          rightArea[b]=HalfArea(acc);
+          rightCnt[b]=cnt;
+        }
+        acc.SetNull();
+        cnt=0;
+        for(int b=0;b<BinNum-1;++b)
+        {
+          acc.Add(binBox[b]);
+          cnt+=binCnt[b];
+          if(cnt==0 || rightCnt[b+1]==0) continue;
+          const ScalarType cost=HalfArea(acc)*cnt+rightArea[b+1]*rightCnt[b+1];
+          if(cost<bestCost)
+          {
+            bestCost=cost;
+            bestAxis=axis;
+            bestSplit=b;
+          }
+        }
+      }
+
+    // Leaf if it is not worse than splitting (traversal cost is taken equal to an object test)
+    const ScalarType nodeArea=HalfArea(nodeBox);
+    const ScalarType leafCost=ScalarType(n)*nodeArea;
+    const ScalarType splitCost=nodeArea+bestCost;
+    if(n<=maxObjPerLeaf && (bestAxis<0 || leafCost<=splitCost))
+    {
+      MakeLeaf(ni,begin,n);
+      return ni;
+    }
+
+    int mid;
+    if(bestAxis>=0)
+    {
+      const ScalarType scale=ScalarType(BinNum)/cDim[bestAxis];
+      const ScalarType cmin=centerBox.min[bestAxis];
+      int *first=&bd.index[0]+begin, *last=&bd.index[0]+end;
+      mid=int(std::partition(first,last,BinPredicate(bd,bestAxis,bestSplit,cmin,scale))-&bd.index[0]);
+    }
+    else
+    {
+      // all the centers coincide (or the tree is getting too deep): split at the median of the largest axis
+      bestAxis=int(cDim[1]>cDim[0]);
+      if(cDim[2]>cDim[bestAxis]) bestAxis=2;
+      mid=(begin+end)/2;
+      std::nth_element(&bd.index[0]+begin,&bd.index[0]+mid,&bd.index[0]+end,CenterLess(bd,bestAxis));
+    }
+
+    nodes[ni].count=0;
+    nodes[ni].axis=(unsigned short)(bestAxis);
+    Build(bd,begin,mid,depth+1);
+    const int second=Build(bd,mid,end,depth+1);
+    nodes[ni].offset=second;
+    return ni;
+  }
+
+  void MakeLeaf(const int ni, const int begin, const int n)
+  {
+    assert(n>0 && n<65536);
+    nodes[ni].offset=begin;
+    nodes[ni].count=(unsigned short)(n);
+    nodes[ni].axis=0;
+  }
+
+  static int BinOf(const ScalarType c, const ScalarType cmin, const ScalarType scale)
+  {
+    int b=int((c-cmin)*scale);
+    return std::min(std::max(b,0),int(BinNum)-1);
+  }
+
+  class BinPredicate
+  {
+  public:
+    const BuildData &bd; int axis; int split; ScalarType cmin, scale;
+    BinPredicate(const BuildData &_bd, int _axis, int _split, ScalarType _cmin, ScalarType _scale)
+      :bd(_bd),axis(_axis),split(_split),cmin(_cmin),scale(_scale){}
+    bool operator()(const int i) const { return BinOf(bd.center[i][axis],cmin,scale)<=split; }
+  };
+
+  class CenterLess
+  {
+  public:
+    const BuildData &bd; int axis;
+    CenterLess(const BuildData &_bd, int _axis):bd(_bd),axis(_axis){}
+    bool operator()(const int a, const int b) const { return bd.center[a][axis]<bd.center[b][axis]; }
+  };
+
+  static ScalarType BoxSquaredDistance(const Node &nd, const CoordType &p)
+  {
+    ScalarType d2=0;
+    for(int i=0;i<3;++i)
+    {
+      if(p[i]<nd.bmin[i])      { const ScalarType d=ScalarType(nd.bmin[i])-p[i]; d2+=d*d; }
+      else if(p[i]>nd.bmax[i]) { const ScalarType d=p[i]-ScalarType(nd.bmax[i]); d2+=d*d; }
+    }
+    return d2;
+  }
+
+  static bool BoxCollide(const Node &nd, const Box3x &b)
+  {
+    for(int i=0;i<3;++i)
+      if(b.min[i]>nd.bmax[i] || b.max[i]<nd.bmin[i]) return false;
+    return true;
+  }
+
+  static bool NodeCollide(const Node &a, const Node &b)
+  {
+    for(int i=0;i<3;++i)
+      if(a.bmin[i]>b.bmax[i] || a.bmax[i]<b.bmin[i]) return false;
+    return true;
+  }
+
+  static bool BoxOverlap(const Box3x &a, const Box3x &b)
+  {
+    for(int i=0;i<3;++i)
+      if(a.min[i]>b.max[i] || a.max[i]<b.min[i]) return false;
+    return true;
+  }
+
+  /// Children of a pair of nodes of the self traversal whose boxes overlap; the pair of a node
+  /// with itself gives the pairs of its children, otherwise the inner node with the larger box
+  /// is split. Returns false (and appends the pair itself) when the pair cannot be split.
+  bool ExpandPair(const int a, const int b, std::vector<std::pair<int,int> > &out) const
+  {
+    const Node &na=nodes[a], &nb=nodes[b];
+    if(na.IsLeaf() && nb.IsLeaf())
+    {
+      out.push_back(std::make_pair(a,b));
+      return false;
+    }
+    if(a==b)
+    {
+      const int c0=a+1, c1=na.offset;
+      out.push_back(std::make_pair(c0,c0));
+      out.push_back(std::make_pair(c1,c1));
+      if(NodeCollide(nodes[c0],nodes[c1])) out.push_back(std::make_pair(c0,c1));
+      return true;
+    }
+    const bool splitA = !na.IsLeaf() && (nb.IsLeaf() || NodeDiag2(na)>=NodeDiag2(nb));
+    const int ns = splitA ? a : b, other = splitA ? b : a;
+    const int c0=ns+1, c1=nodes[ns].offset;
+    if(NodeCollide(nodes[c0],nodes[other])) out.push_back(std::make_pair(c0,other));
+    if(NodeCollide(nodes[c1],nodes[other])) out.push_back(std::make_pair(c1,other));
+    return true;
+  }
+
+  static float NodeDiag2(const Node &nd)
+  {
+    float d2=0;
+    for(int i=0;i<3;++i) d2+=(nd.bmax[i]-nd.bmin[i])*(nd.bmax[i]-nd.bmin[i]);
+    return d2;
+  }
+
+  /// Push the children of nd whose box is within sqrt(r2) from p, the nearest on top.
+  void PushChildren(StackEntry *stack, int &sp, const Node &nd, const int ni, const CoordType &p, const ScalarType r2) const
+  {
+    const int c0=ni+1, c1=nd.offset;
+    const ScalarType d0=BoxSquaredDistance(nodes[c0],p), d1=BoxSquaredDistance(nodes[c1],p);
+    const int nearC = (d0<=d1) ? c0 : c1, farC = (d0<=d1) ? c1 : c0;
+    const ScalarType nearD = std::min(d0,d1), farD = std::max(d0,d1);
+    if(farD<=r2)  { stack[sp].node=farC;  stack[sp].dist2=farD;  ++sp; }
+    if(nearD<=r2) { stack[sp].node=nearC; stack[sp].dist2=nearD; ++sp; }
+  }
+
+  /// Slab test of all the rays of a packet; branch free so that the compiler can vectorize it.
+  static unsigned int PacketBox(const Node &nd, const RayPacket &pk)
+  {
+    ScalarType t0[PacketSize], t1[PacketSize];
+    for(int r=0;r<PacketSize;++r) { t0[r]=0; t1[r]=pk.tMax[r]; }
+    for(int i=0;i<3;++i)
+      for(int r=0;r<PacketSize;++r)
+      {
+        const ScalarType ta=(ScalarType(nd.bmin[i])-pk.orig[i][r])*pk.invDir[i][r];
+        const ScalarType tb=(ScalarType(nd.bmax[i])-pk.orig[i][r])*pk.invDir[i][r];
+        // a NaN (ray lying on a slab plane) must reach the comparisons below, that ignore it
+        const ScalarType tNear=(ta<tb || ta!=ta)?ta:tb;
+        const ScalarType tFar =(ta>tb || ta!=ta)?ta:tb;
+        t0[r]=tNear>t0[r]?tNear:t0[r];
+        t1[r]=tFar<t1[r]?tFar:t1[r];
+      }
+    unsigned int hit=0;
+    for(int r=0;r<PacketSize;++r)
+      hit|=(t0[r]<=t1[r]?1u:0u)<<r;
+    return hit;
+  }
+
+  /// Slab test; true if the ray enters the box before tMax.
+  static bool RayBox(const Node &nd, const RayEx &rx, const ScalarType tMax)
+  {
+    ScalarType t0=0, t1=tMax;
+    for(int i=0;i<3;++i)
+    {
+      ScalarType tNear=(ScalarType(rx.neg[i]?nd.bmax[i]:nd.bmin[i])-rx.orig[i])*rx.invDir[i];
+      ScalarType tFar =(ScalarType(rx.neg[i]?nd.bmin[i]:nd.bmax[i])-rx.orig[i])*rx.invDir[i];
+      if(tNear>t0) t0=tNear;
+      if(tFar<t1)  t1=tFar;
+      if(t0>t1) return false;
+    }
+    return true;
+  }
+};
+
+} // end namespace vcg
+
+#endif // #ifndef __VCGLIB_BVH_INDEX_H
@@ -241,16 +241,44 @@ namespace vcg {
 //			//);
 //		}
 
+		/// Collect the pointers to the objects in the range, so that the construction
+		/// passes can be run in parallel whatever is the kind of the iterator.
 		template <class OBJITER>
-		inline void Set(const OBJITER & _oBegin, const OBJITER & _oEnd, int _size=0)
+		static void CollectObjPtrs(const OBJITER & _oBegin, const OBJITER & _oEnd, std::vector<ObjPtr> &objPtrs)
 		{
-			Box3<FLT> _bbox;
-			Box3<FLT> b;
+			objPtrs.clear();
 			for(OBJITER i = _oBegin; i!= _oEnd; ++i)
+				objPtrs.push_back(&(*i));
+		}
+
+		/// Bounding box of a set of objects (computed in parallel when OpenMP is enabled).
+		template <class OBJITER>
+		static Box3<FLT> ComputeObjBBox(const OBJITER & _oBegin, const OBJITER & _oEnd)
+		{
+			std::vector<ObjPtr> objPtrs;
+			CollectObjPtrs(_oBegin,_oEnd,objPtrs);
+			const int n = int(objPtrs.size());
+			Box3<FLT> _bbox;
+#pragma omp parallel
 			{
-				(*i).GetBBox(b);
-				_bbox.Add(b);				
+				Box3<FLT> localBox;
+				Box3<FLT> b;
+#pragma omp for nowait
+				for(int k=0;k<n;++k)
+				{
+					objPtrs[k]->GetBBox(b);
+					localBox.Add(b);
+				}
+#pragma omp critical (GridStaticPtrBBox)
+				_bbox.Add(localBox);
 			}
+			return _bbox;
+		}
+
+		template <class OBJITER>
+		inline void Set(const OBJITER & _oBegin, const OBJITER & _oEnd, int _size=0)
+		{
+			Box3<FLT> _bbox = ComputeObjBBox(_oBegin,_oEnd);
 			if(_size ==0) 
 					_size=(int)std::distance<OBJITER>(_oBegin,_oEnd);
 
@@ -271,13 +299,7 @@ namespace vcg {
 			template <class OBJITER>
 				inline void SetWithRadius(const OBJITER & _oBegin, const OBJITER & _oEnd, FLT _cellRadius)
 			{
-				  Box3<FLT> _bbox;
-				  Box3<FLT> b;
-				  for(OBJITER i = _oBegin; i!= _oEnd; ++i)
-				  {
-					  (*i).GetBBox(b);
-					  _bbox.Add(b);
-				  }
+				  Box3<FLT> _bbox = ComputeObjBBox(_oBegin,_oEnd);
 
 				  _bbox.min-=vcg::Point3<FLT>(_cellRadius,_cellRadius,_cellRadius);
 				  _bbox.max+=vcg::Point3<FLT>(_cellRadius,_cellRadius,_cellRadius);
@@ -317,8 +339,6 @@ namespace vcg {
 		template <class OBJITER>
     inline void Set(const OBJITER & _oBegin, const OBJITER & _oEnd, const Box3x &_bbox, Point3i _siz)
 		{
-			OBJITER i;
-			
 			this->bbox=_bbox;
 			this->siz=_siz;
 			
@@ -329,63 +349,77 @@ namespace vcg {
 			this->voxel[1] = this->dim[1]/this->siz[1];
 			this->voxel[2] = this->dim[2]/this->siz[2];			
 			
-        // Allocate the grid (add one more for the final sentinel)
-				grid.resize( this->siz[0]*this->siz[1]*this->siz[2]+1 );
-
-        // Insert all the objects into the grid
-				links.clear();
-				for(i=_oBegin; i!=_oEnd; ++i)
+			std::vector<ObjPtr> objPtrs;
+			CollectObjPtrs(_oBegin,_oEnd,objPtrs);
+			const int n = int(objPtrs.size());
+			const int cellNum = this->siz[0]*this->siz[1]*this->siz[2];
+
+			// The links are bucketed by cell with a counting sort:
+			// 1) count the links of each cell (in parallel),
+			// 2) prefix sum of the counts,
+			// 3) scatter the links in their cells.
+			// Within a cell the links keep the order of the objects, so the result
+			// is deterministic and does not depend on the number of threads.
+			// grid and links are resized, so re-indexing reuses their allocation.
+			std::vector<Box3i> ibox(n);     // Bounding box in voxels of each object
+			std::vector<int> cellEnd(cellNum+1,0);
+#pragma omp parallel for schedule(dynamic,1024)
+			for(int k=0;k<n;++k)
+			{
+				Box3x bb;			// Boundig box del tetraedro corrente
+				objPtrs[k]->GetBBox(bb);
+				bb.Intersect(this->bbox);
+				if(bb.IsNull())
 				{
-					Box3x bb;			// Boundig box del tetraedro corrente
-					(*i).GetBBox(bb);
-					bb.Intersect(this->bbox);
-					if(! bb.IsNull() )
+					ibox[k].SetNull();
+					continue;
+				}
+				this->BoxToIBox( bb,ibox[k] );
+				const Box3i &ib=ibox[k];
+				for(int z=ib.min[2];z<=ib.max[2];++z)
+				{
+					int bz = z*this->siz[1];
+					for(int y=ib.min[1];y<=ib.max[1];++y)
 					{
-
-						Box3i ib;		// Boundig box in voxels
-						this->BoxToIBox( bb,ib );
-						int x,y,z;
-						for(z=ib.min[2];z<=ib.max[2];++z)
-						{
-							int bz = z*this->siz[1];
-							for(y=ib.min[1];y<=ib.max[1];++y)
-							{
-								int by = (y+bz)*this->siz[0];
-								for(x=ib.min[0];x<=ib.max[0];++x)
-									// Inserire calcolo cella corrente
-									// if( pt->Intersect( ... )
-									links.push_back( Link(&(*i),by+x) );
-							}
-						}
+						int by = (y+bz)*this->siz[0];
+						for(int x=ib.min[0];x<=ib.max[0];++x)
+#pragma omp atomic
+							++cellEnd[by+x];
 					}
 				}
-				// Push della sentinella
-				/*links.push_back( Link((typename ContainerType::iterator)NULL,
-				(grid.size()-1)));*/
-
-				links.push_back( Link( NULL,	int(grid.size())-1) );
+			}
+			// Inclusive prefix sum: cellEnd[c] is one past the last link of cell c.
+			for(int c=1;c<=cellNum;++c)
+				cellEnd[c]+=cellEnd[c-1];
+			const int linkNum = cellEnd[cellNum];
 
-				// Ordinamento dei links
-				sort( links.begin(), links.end() );
+			// Allocate the grid (add one more for the final sentinel)
+			grid.resize( cellNum+1 );
+			links.resize( linkNum+1 );
 
-				// Creazione puntatori ai links
-				typename std::vector<Link>::iterator pl;
-				unsigned int pg;
-				pl = links.begin();
-				for(pg=0;pg<grid.size();++pg)
+			// Scatter the links backward, so that at the end cellEnd[c] is the first link of cell c.
+			for(int k=n-1;k>=0;--k)
+			{
+				const Box3i &ib=ibox[k];
+				for(int z=ib.max[2];z>=ib.min[2];--z)
 				{
-					assert(pl!=links.end());
-					grid[pg] = &*pl;
-					while( (int)pg == pl->Index() )	// Trovato inizio
+					int bz = z*this->siz[1];
+					for(int y=ib.max[1];y>=ib.min[1];--y)
 					{
-						++pl;		// Ricerca prossimo blocco
-						if(pl==links.end())
-							break;
+						int by = (y+bz)*this->siz[0];
+						for(int x=ib.max[0];x>=ib.min[0];--x)
+							links[--cellEnd[by+x]] = Link(objPtrs[k],by+x);
 					}
 				}
+			}
+			// Push della sentinella
+			links[linkNum] = Link( NULL, cellNum );
 
-		}		
-
+			// Creazione puntatori ai links
+#pragma omp parallel for schedule(static)
+			for(int pg=0;pg<=cellNum;++pg)
+				grid[pg] = &links[cellEnd[pg]];
+		}
 
 		int MemUsed()
 		{
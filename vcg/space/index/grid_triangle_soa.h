@@ -0,0 +1,425 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_GRID_TRIANGLE_SOA
+#define __VCGLIB_GRID_TRIANGLE_SOA
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VCG_TRIANGLE_SOA_SSE
+#endif
+
+#include <vcg/space/point3.h>
+#include <vcg/space/box3.h>
+
+namespace vcg {
+
+/** Triangles packed as structure of arrays (single precision) so that the
+squared distance between a point and several triangles can be computed at
+once with SSE (4 triangles) or AVX (8 triangles) instructions.
+Each triangle is stored as its first vertex A and the two edges B-A and C-A.
+The arrays are padded so that a block can always be loaded at full width.
+*/
+class TriangleSoA
+{
+public:
+#if defined(__AVX__)
+  enum { BlockSize = 8 };
+#elif defined(VCG_TRIANGLE_SOA_SSE)
+  enum { BlockSize = 4 };
+#else
+  enum { BlockSize = 1 };
+#endif
+
+  std::vector<float> ax,ay,az;
+  std::vector<float> e0x,e0y,e0z;
+  std::vector<float> e1x,e1y,e1z;
+
+  int Size() const { return n; }
+
+  void Resize(int _n)
+  {
+    n=_n;
+    ax.resize(n+BlockSize);  ay.resize(n+BlockSize);  az.resize(n+BlockSize);
+    e0x.resize(n+BlockSize); e0y.resize(n+BlockSize); e0z.resize(n+BlockSize);
+    e1x.resize(n+BlockSize); e1y.resize(n+BlockSize); e1z.resize(n+BlockSize);
+    for(int i=n;i<n+BlockSize;++i) SetNull(i);
+  }
+
+  template <class CoordType>
+  void Set(int i, const CoordType &a, const CoordType &b, const CoordType &c)
+  {
+    ax[i]=float(a[0]);       ay[i]=float(a[1]);       az[i]=float(a[2]);
+    e0x[i]=float(b[0]-a[0]); e0y[i]=float(b[1]-a[1]); e0z[i]=float(b[2]-a[2]);
+    e1x[i]=float(c[0]-a[0]); e1y[i]=float(c[1]-a[1]); e1z[i]=float(c[2]-a[2]);
+  }
+
+  /// A null entry (used for deleted faces and for padding) is always at infinite distance.
+  void SetNull(int i)
+  {
+    ax[i]=ay[i]=az[i]=std::numeric_limits<float>::max();
+    e0x[i]=e0y[i]=e0z[i]=e1x[i]=e1y[i]=e1z[i]=0;
+  }
+
+  /** Squared distance between p and the triangles [start,start+count).
+  The distances are written in sqDist, that must have room for count rounded up to BlockSize.
+  */
+  void SquaredDistance(const Point3f &p, int start, int count, float *sqDist) const
+  {
+    int i=0;
+#if defined(__AVX__)
+    for(;i<count;i+=8)
+      SquaredDistance8(p,start+i,sqDist+i);
+#elif defined(VCG_TRIANGLE_SOA_SSE)
+    for(;i<count;i+=4)
+      SquaredDistance4(p,start+i,sqDist+i);
+#endif
+    for(;i<count;++i)
+      sqDist[i]=SquaredDistance1(p,start+i);
+  }
+
+  /// Plain scalar version of the kernel, it gives the same values of the vectorized ones.
+  float SquaredDistance1(const Point3f &p, int i) const
+  {
+    const float apx=p[0]-ax[i], apy=p[1]-ay[i], apz=p[2]-az[i];
+    const float d00=e0x[i]*e0x[i]+e0y[i]*e0y[i]+e0z[i]*e0z[i];
+    const float d01=e0x[i]*e1x[i]+e0y[i]*e1y[i]+e0z[i]*e1z[i];
+    const float d11=e1x[i]*e1x[i]+e1y[i]*e1y[i]+e1z[i]*e1z[i];
+    const float d20=apx*e0x[i]+apy*e0y[i]+apz*e0z[i];
+    const float d21=apx*e1x[i]+apy*e1y[i]+apz*e1z[i];
+    // Projection inside the triangle: distance from the plane
+    const float den=d00*d11-d01*d01;
+    const float v=d11*d20-d01*d21;
+    const float w=d00*d21-d01*d20;
+    if(den>0 && v>=0 && w>=0 && v+w<=den)
+    {
+      const float nx=e0y[i]*e1z[i]-e0z[i]*e1y[i];
+      const float ny=e0z[i]*e1x[i]-e0x[i]*e1z[i];
+      const float nz=e0x[i]*e1y[i]-e0y[i]*e1x[i];
+      const float pn=apx*nx+apy*ny+apz*nz;
+      return pn*pn/den;
+    }
+    // Otherwise the closest point is on one of the three edges
+    const float tiny=std::numeric_limits<float>::min();
+    float t,dx,dy,dz;
+    t=std::min(std::max(d20/std::max(d00,tiny),0.f),1.f);
+    dx=apx-t*e0x[i]; dy=apy-t*e0y[i]; dz=apz-t*e0z[i];
+    float best=dx*dx+dy*dy+dz*dz;
+    t=std::min(std::max(d21/std::max(d11,tiny),0.f),1.f);
+    dx=apx-t*e1x[i]; dy=apy-t*e1y[i]; dz=apz-t*e1z[i];
+    best=std::min(best,dx*dx+dy*dy+dz*dz);
+    const float e2x=e1x[i]-e0x[i], e2y=e1y[i]-e0y[i], e2z=e1z[i]-e0z[i];
+    const float bpx=apx-e0x[i], bpy=apy-e0y[i], bpz=apz-e0z[i];
+    const float d22=e2x*e2x+e2y*e2y+e2z*e2z;
+    t=std::min(std::max((bpx*e2x+bpy*e2y+bpz*e2z)/std::max(d22,tiny),0.f),1.f);
+    dx=bpx-t*e2x; dy=bpy-t*e2y; dz=bpz-t*e2z;
+    return std::min(best,dx*dx+dy*dy+dz*dz);
+  }
+
+#if defined(__AVX__)
+  void SquaredDistance8(const Point3f &p, int i, float *sqDist) const
+  {
+    const __m256 zero=_mm256_setzero_ps();
+    const __m256 one=_mm256_set1_ps(1.f);
+    const __m256 tiny=_mm256_set1_ps(std::numeric_limits<float>::min());
+    const __m256 E0x=_mm256_loadu_ps(&e0x[i]), E0y=_mm256_loadu_ps(&e0y[i]), E0z=_mm256_loadu_ps(&e0z[i]);
+    const __m256 E1x=_mm256_loadu_ps(&e1x[i]), E1y=_mm256_loadu_ps(&e1y[i]), E1z=_mm256_loadu_ps(&e1z[i]);
+    const __m256 apx=_mm256_sub_ps(_mm256_set1_ps(p[0]),_mm256_loadu_ps(&ax[i]));
+    const __m256 apy=_mm256_sub_ps(_mm256_set1_ps(p[1]),_mm256_loadu_ps(&ay[i]));
+    const __m256 apz=_mm256_sub_ps(_mm256_set1_ps(p[2]),_mm256_loadu_ps(&az[i]));
+#define VCG_DOT8(x0,y0,z0,x1,y1,z1) _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x0,x1),_mm256_mul_ps(y0,y1)),_mm256_mul_ps(z0,z1))
+#define VCG_CLAMP8(a) _mm256_min_ps(_mm256_max_ps(a,zero),one)
+    const __m256 d00=VCG_DOT8(E0x,E0y,E0z,E0x,E0y,E0z);
+    const __m256 d01=VCG_DOT8(E0x,E0y,E0z,E1x,E1y,E1z);
+    const __m256 d11=VCG_DOT8(E1x,E1y,E1z,E1x,E1y,E1z);
+    const __m256 d20=VCG_DOT8(apx,apy,apz,E0x,E0y,E0z);
+    const __m256 d21=VCG_DOT8(apx,apy,apz,E1x,E1y,E1z);
+    const __m256 den=_mm256_sub_ps(_mm256_mul_ps(d00,d11),_mm256_mul_ps(d01,d01));
+    const __m256 v=_mm256_sub_ps(_mm256_mul_ps(d11,d20),_mm256_mul_ps(d01,d21));
+    const __m256 w=_mm256_sub_ps(_mm256_mul_ps(d00,d21),_mm256_mul_ps(d01,d20));
+    __m256 inside=_mm256_and_ps(_mm256_cmp_ps(den,zero,_CMP_GT_OQ),_mm256_cmp_ps(v,zero,_CMP_GE_OQ));
+    inside=_mm256_and_ps(inside,_mm256_cmp_ps(w,zero,_CMP_GE_OQ));
+    inside=_mm256_and_ps(inside,_mm256_cmp_ps(_mm256_add_ps(v,w),den,_CMP_LE_OQ));
+    const __m256 nx=_mm256_sub_ps(_mm256_mul_ps(E0y,E1z),_mm256_mul_ps(E0z,E1y));
+    const __m256 ny=_mm256_sub_ps(_mm256_mul_ps(E0z,E1x),_mm256_mul_ps(E0x,E1z));
+    const __m256 nz=_mm256_sub_ps(_mm256_mul_ps(E0x,E1y),_mm256_mul_ps(E0y,E1x));
+    const __m256 pn=VCG_DOT8(apx,apy,apz,nx,ny,nz);
+    const __m256 planeDist=_mm256_div_ps(_mm256_mul_ps(pn,pn),_mm256_max_ps(den,tiny));
+    __m256 t,dx,dy,dz,best;
+    t=VCG_CLAMP8(_mm256_div_ps(d20,_mm256_max_ps(d00,tiny)));
+    dx=_mm256_sub_ps(apx,_mm256_mul_ps(t,E0x)); dy=_mm256_sub_ps(apy,_mm256_mul_ps(t,E0y)); dz=_mm256_sub_ps(apz,_mm256_mul_ps(t,E0z));
+    best=VCG_DOT8(dx,dy,dz,dx,dy,dz);
+    t=VCG_CLAMP8(_mm256_div_ps(d21,_mm256_max_ps(d11,tiny)));
+    dx=_mm256_sub_ps(apx,_mm256_mul_ps(t,E1x)); dy=_mm256_sub_ps(apy,_mm256_mul_ps(t,E1y)); dz=_mm256_sub_ps(apz,_mm256_mul_ps(t,E1z));
+    best=_mm256_min_ps(best,VCG_DOT8(dx,dy,dz,dx,dy,dz));
+    const __m256 E2x=_mm256_sub_ps(E1x,E0x), E2y=_mm256_sub_ps(E1y,E0y), E2z=_mm256_sub_ps(E1z,E0z);
+    const __m256 bpx=_mm256_sub_ps(apx,E0x), bpy=_mm256_sub_ps(apy,E0y), bpz=_mm256_sub_ps(apz,E0z);
+    const __m256 d22=VCG_DOT8(E2x,E2y,E2z,E2x,E2y,E2z);
+    t=VCG_CLAMP8(_mm256_div_ps(VCG_DOT8(bpx,bpy,bpz,E2x,E2y,E2z),_mm256_max_ps(d22,tiny)));
+    dx=_mm256_sub_ps(bpx,_mm256_mul_ps(t,E2x)); dy=_mm256_sub_ps(bpy,_mm256_mul_ps(t,E2y)); dz=_mm256_sub_ps(bpz,_mm256_mul_ps(t,E2z));
+    best=_mm256_min_ps(best,VCG_DOT8(dx,dy,dz,dx,dy,dz));
+#undef VCG_DOT8
+#undef VCG_CLAMP8
+    _mm256_storeu_ps(sqDist,_mm256_blendv_ps(best,planeDist,inside));
+  }
+#endif
+
+#if defined(VCG_TRIANGLE_SOA_SSE)
+  void SquaredDistance4(const Point3f &p, int i, float *sqDist) const
+  {
+    const __m128 zero=_mm_setzero_ps();
+    const __m128 one=_mm_set1_ps(1.f);
+    const __m128 tiny=_mm_set1_ps(std::numeric_limits<float>::min());
+    const __m128 E0x=_mm_loadu_ps(&e0x[i]), E0y=_mm_loadu_ps(&e0y[i]), E0z=_mm_loadu_ps(&e0z[i]);
+    const __m128 E1x=_mm_loadu_ps(&e1x[i]), E1y=_mm_loadu_ps(&e1y[i]), E1z=_mm_loadu_ps(&e1z[i]);
+    const __m128 apx=_mm_sub_ps(_mm_set1_ps(p[0]),_mm_loadu_ps(&ax[i]));
+    const __m128 apy=_mm_sub_ps(_mm_set1_ps(p[1]),_mm_loadu_ps(&ay[i]));
+    const __m128 apz=_mm_sub_ps(_mm_set1_ps(p[2]),_mm_loadu_ps(&az[i]));
+#define VCG_DOT4(x0,y0,z0,x1,y1,z1) _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0,x1),_mm_mul_ps(y0,y1)),_mm_mul_ps(z0,z1))
+#define VCG_CLAMP4(a) _mm_min_ps(_mm_max_ps(a,zero),one)
+    const __m128 d00=VCG_DOT4(E0x,E0y,E0z,E0x,E0y,E0z);
+    const __m128 d01=VCG_DOT4(E0x,E0y,E0z,E1x,E1y,E1z);
+    const __m128 d11=VCG_DOT4(E1x,E1y,E1z,E1x,E1y,E1z);
+    const __m128 d20=VCG_DOT4(apx,apy,apz,E0x,E0y,E0z);
+    const __m128 d21=VCG_DOT4(apx,apy,apz,E1x,E1y,E1z);
+    const __m128 den=_mm_sub_ps(_mm_mul_ps(d00,d11),_mm_mul_ps(d01,d01));
+    const __m128 v=_mm_sub_ps(_mm_mul_ps(d11,d20),_mm_mul_ps(d01,d21));
+    const __m128 w=_mm_sub_ps(_mm_mul_ps(d00,d21),_mm_mul_ps(d01,d20));
+    __m128 inside=_mm_and_ps(_mm_cmpgt_ps(den,zero),_mm_cmpge_ps(v,zero));
+    inside=_mm_and_ps(inside,_mm_cmpge_ps(w,zero));
+    inside=_mm_and_ps(inside,_mm_cmple_ps(_mm_add_ps(v,w),den));
+    const __m128 nx=_mm_sub_ps(_mm_mul_ps(E0y,E1z),_mm_mul_ps(E0z,E1y));
+    const __m128 ny=_mm_sub_ps(_mm_mul_ps(E0z,E1x),_mm_mul_ps(E0x,E1z));
+    const __m128 nz=_mm_sub_ps(_mm_mul_ps(E0x,E1y),_mm_mul_ps(E0y,E1x));
+    const __m128 pn=VCG_DOT4(apx,apy,apz,nx,ny,nz);
+    const __m128 planeDist=_mm_div_ps(_mm_mul_ps(pn,pn),_mm_max_ps(den,tiny));
+    __m128 t,dx,dy,dz,best;
+    t=VCG_CLAMP4(_mm_div_ps(d20,_mm_max_ps(d00,tiny)));
+    dx=_mm_sub_ps(apx,_mm_mul_ps(t,E0x)); dy=_mm_sub_ps(apy,_mm_mul_ps(t,E0y)); dz=_mm_sub_ps(apz,_mm_mul_ps(t,E0z));
+    best=VCG_DOT4(dx,dy,dz,dx,dy,dz);
+    t=VCG_CLAMP4(_mm_div_ps(d21,_mm_max_ps(d11,tiny)));
+    dx=_mm_sub_ps(apx,_mm_mul_ps(t,E1x)); dy=_mm_sub_ps(apy,_mm_mul_ps(t,E1y)); dz=_mm_sub_ps(apz,_mm_mul_ps(t,E1z));
+    best=_mm_min_ps(best,VCG_DOT4(dx,dy,dz,dx,dy,dz));
+    const __m128 E2x=_mm_sub_ps(E1x,E0x), E2y=_mm_sub_ps(E1y,E0y), E2z=_mm_sub_ps(E1z,E0z);
+    const __m128 bpx=_mm_sub_ps(apx,E0x), bpy=_mm_sub_ps(apy,E0y), bpz=_mm_sub_ps(apz,E0z);
+    const __m128 d22=VCG_DOT4(E2x,E2y,E2z,E2x,E2y,E2z);
+    t=VCG_CLAMP4(_mm_div_ps(VCG_DOT4(bpx,bpy,bpz,E2x,E2y,E2z),_mm_max_ps(d22,tiny)));
+    dx=_mm_sub_ps(bpx,_mm_mul_ps(t,E2x)); dy=_mm_sub_ps(bpy,_mm_mul_ps(t,E2y)); dz=_mm_sub_ps(bpz,_mm_mul_ps(t,E2z));
+    best=_mm_min_ps(best,VCG_DOT4(dx,dy,dz,dx,dy,dz));
+#undef VCG_DOT4
+#undef VCG_CLAMP4
+    // blend: inside ? planeDist : best
+    _mm_storeu_ps(sqDist,_mm_or_ps(_mm_and_ps(inside,planeDist),_mm_andnot_ps(inside,best)));
+  }
+#endif
+
+private:
+  int n;
+public:
+  TriangleSoA():n(0){}
+};
+
+/** Side buffer of a GridStaticPtr of triangular faces.
+It stores the triangles of the grid links in the same order of the links,
+so the triangles of a cell are contiguous and can be tested a block at a time.
+The coordinates are relative to the center of the grid, so that single precision
+is enough also for (double) meshes far from the origin.
+It must be rebuilt (Set) every time the grid is re-indexed or the mesh is modified.
+*/
+template <class GRID>
+class GridTriangleSoA
+{
+public:
+  typedef typename GRID::ObjPtr ObjPtr;
+  typedef typename GRID::CoordType CoordType;
+
+  TriangleSoA tri;
+  CoordType origin;
+
+  void Set(GRID &gr)
+  {
+    assert(!gr.links.empty());
+    const int n = int(gr.links.size())-1; // skip the sentinel
+    origin = gr.bbox.Center();
+    tri.Resize(n);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<n;++i)
+    {
+      ObjPtr f = gr.links[i].Elem();
+      if(f->IsD()) tri.SetNull(i);
+      else tri.Set(i,f->cP(0)-origin,f->cP(1)-origin,f->cP(2)-origin);
+    }
+  }
+
+  int MemUsed() const { return int(sizeof(GridTriangleSoA)+9*sizeof(float)*(tri.Size()+TriangleSoA::BlockSize)); }
+};
+
+/** Same as GridClosest() but the candidate faces of each cell are first ranked
+with the vectorized kernel of GridTriangleSoA; only the best ones (the winner and
+the ones within the single precision tolerance from it) are evaluated, in order,
+with the given point-face distance functor, which gives the returned face, distance and point.
+If the functor rejects all of them, every face of the visited cells is tried with it.
+It needs no marker, so it can be called by many threads at the same time.
+*/
+template <class GRID, class OBJPOINTDISTFUNCTOR>
+typename GRID::ObjPtr GridClosestSoA(GRID &Si,
+                                     const GridTriangleSoA<GRID> &soa,
+                                     OBJPOINTDISTFUNCTOR _getPointDistance,
+                                     const typename GRID::CoordType & _p,
+                                     const typename GRID::ScalarType & _maxDist,
+                                     typename GRID::ScalarType & _minDist,
+                                     typename GRID::CoordType &_closestPt)
+{
+  typedef typename GRID::ObjPtr ObjPtr;
+  typedef typename GRID::CoordType CoordType;
+  typedef typename GRID::ScalarType ScalarType;
+  typedef typename GRID::Box3x Box3x;
+  typedef typename GRID::CellIterator CellIterator;
+
+  const Point3f pf = Point3f::Construct(_p-soa.origin);
+  // error bound of the single precision distances
+  const ScalarType tol = ScalarType(1e-5)*(ScalarType(pf.Norm())+Si.bbox.Diag());
+  const typename GRID::Link *base = &Si.links[0];
+  std::vector<float> sqDist;
+  std::vector<std::pair<float,int> > cand;  // squared distance and link of the candidates
+  float bestSqDist = std::numeric_limits<float>::max();
+  float limitSqDist = float((_maxDist+tol)*(_maxDist+tol));
+  ScalarType curMinDist=_maxDist;
+
+  CellIterator first,last;
+  Box3i iboxdone,iboxtodo;
+  // with a small _maxDist (e.g. a narrow band distance field) a single step over the cells
+  // touching the sphere of radius _maxDist is enough.
+  ScalarType newradius = std::min(ScalarType(Si.voxel.Norm()),_maxDist);
+  ScalarType radius;
+
+  if(Si.bbox.IsInEx(_p))
+  {
+    Point3i _ip;
+    Si.PToIP(_p,_ip);
+    iboxdone=Box3i(_ip,_ip);
+    Si.Grid( _ip[0],_ip[1],_ip[2], first, last );
+    const int start=int(first-base), count=int(last-first);
+    sqDist.resize(count+TriangleSoA::BlockSize);
+    soa.tri.SquaredDistance(pf,start,count,&sqDist[0]);
+    for(int k=0;k<count;++k)
+      if(sqDist[k]<=limitSqDist)
+      {
+        cand.push_back(std::make_pair(sqDist[k],start+k));
+        bestSqDist=std::min(bestSqDist,sqDist[k]);
+      }
+    if(!cand.empty())
+    {
+      curMinDist=ScalarType(std::sqrt(bestSqDist))+tol;
+      limitSqDist=float(curMinDist*curMinDist);
+      newradius=curMinDist;
+    }
+  }
+
+  Box3i ibox(Point3i(0,0,0),Si.siz-Point3i(1,1,1));
+  do
+  {
+    radius=newradius;
+    Box3x boxtodo=Box3x(_p,radius);
+    Si.BoxToIBox(boxtodo, iboxtodo);
+    iboxtodo.Intersect(ibox);
+    if(!boxtodo.IsNull())
+    {
+      for (int ix=iboxtodo.min[0]; ix<=iboxtodo.max[0]; ix++)
+        for (int iy=iboxtodo.min[1]; iy<=iboxtodo.max[1]; iy++)
+          for (int iz=iboxtodo.min[2]; iz<=iboxtodo.max[2]; iz++)
+            if(ix<iboxdone.min[0] || ix>iboxdone.max[0] ||  // skip the already analyzed cells.
+               iy<iboxdone.min[1] || iy>iboxdone.max[1] ||
+               iz<iboxdone.min[2] || iz>iboxdone.max[2] )
+            {
+              Si.Grid( ix, iy, iz, first, last );
+              const int start=int(first-base), count=int(last-first);
+              if(count==0) continue;
+              if(int(sqDist.size())<count+TriangleSoA::BlockSize) sqDist.resize(count+TriangleSoA::BlockSize);
+              soa.tri.SquaredDistance(pf,start,count,&sqDist[0]);
+              for(int k=0;k<count;++k)
+                if(sqDist[k]<=limitSqDist)
+                {
+                  cand.push_back(std::make_pair(sqDist[k],start+k));
+                  bestSqDist=std::min(bestSqDist,sqDist[k]);
+                }
+            }
+    }
+    if(cand.empty()) newradius=radius+Si.voxel.Norm();
+    else
+    {
+      newradius=curMinDist=ScalarType(std::sqrt(bestSqDist))+tol;
+      limitSqDist=float(curMinDist*curMinDist);
+    }
+    iboxdone=iboxtodo;
+  }
+  while (curMinDist>radius);
+
+  // Exact distance and closest point with the requested functor, in order of the
+  // single precision distance, until the next candidate cannot be closer
+  std::sort(cand.begin(),cand.end());
+  ObjPtr best=0;
+  _minDist=_maxDist;
+  CoordType t_res;
+  for(size_t i=0;i<cand.size() && cand[i].first<=limitSqDist;++i)
+  {
+    if(best!=0 && ScalarType(std::sqrt(cand[i].first))>_minDist+tol) break;
+    ObjPtr elem=Si.links[cand[i].second].Elem();
+    if(_getPointDistance(*elem,_p,_minDist,t_res))
+    {
+      best=elem;
+      _closestPt=t_res;
+    }
+  }
+  if(best!=0 || cand.empty()) return best;
+
+  // the functor rejected all the candidates: try all the faces of the visited cells
+  for (int ix=iboxdone.min[0]; ix<=iboxdone.max[0]; ix++)
+    for (int iy=iboxdone.min[1]; iy<=iboxdone.max[1]; iy++)
+      for (int iz=iboxdone.min[2]; iz<=iboxdone.max[2]; iz++)
+      {
+        Si.Grid( ix, iy, iz, first, last );
+        for(;first!=last;++first)
+        {
+          ObjPtr elem=(*first).Elem();
+          if(!elem->IsD() && _getPointDistance(*elem,_p,_minDist,t_res))
+          {
+            best=elem;
+            _closestPt=t_res;
+          }
+        }
+      }
+  return best;
+}
+
+} // end namespace vcg
+
+#endif
@@ -6,6 +6,7 @@
 #include "mlsutils.h"
 #include "priorityqueue.h"
 #include <vector>
+#include <algorithm>
 #include <limits>
 #include <iostream>
 
@@ -42,6 +43,11 @@ public:
 
 /**
  * This class allows to create a Kd-Tree thought to perform the k-nearest neighbour query
+ *
+ * The Scalar type of the tree must match the one of the points (e.g. KdTree<double> for a mesh with
+ * Point3d coords). The top levels of the tree are built serially, then the remaining subtrees are
+ * built in parallel (when OpenMP is enabled); the resulting tree does not depend on the number of threads.
+ * New points can be added with insert(), without rebuilding the whole tree.
  */
 template<typename _Scalar>
 class KdTree
@@ -65,11 +71,12 @@ public:
                         //leaf
 			struct {
 				unsigned int start;
-				unsigned short size;
+				unsigned int size:26; // below the leaf flag; a leaf at the maximum depth can be large
 			};
                 };
 	};
 	typedef std::vector<Node> NodeList;
+	typedef HeapMaxPriorityQueue<int,Scalar> PriorityQueue;
 
         // return the protected members which store the nodes and the points list
 	inline const NodeList& _getNodes(void) { return mNodes; }
@@ -80,7 +87,7 @@ public:
 	inline int getNofFoundNeighbors(void) { return mNeighborQueue.getNofElements(); }
 	inline const VectorType& getNeighbor(int i) { return mPoints[ mNeighborQueue.getIndex(i) ]; }
 	inline unsigned int getNeighborId(int i) { return mIndices[mNeighborQueue.getIndex(i)]; }
-	inline float getNeighborSquaredDistance(int i) { return mNeighborQueue.getWeight(i); }
+	inline Scalar getNeighborSquaredDistance(int i) { return mNeighborQueue.getWeight(i); }
 
 public:
 
@@ -90,6 +97,12 @@ public:
 
 	void doQueryK(const VectorType& p);
 
+	void doQueryK(const VectorType& p, int k, PriorityQueue& queue) const;
+
+	void queryKBatch(const ConstDataWrapper<VectorType>& queries, int k, std::vector<int>& ids, std::vector<Scalar>& sqDists) const;
+
+	void insert(const ConstDataWrapper<VectorType>& points);
+
 protected:
 
 	// element of the stack
@@ -101,11 +114,31 @@ protected:
 			Scalar sq;            // squared distance to the next node
 	};
 
+	// subtrees with less points than this are built by a single thread;
+	// the query stack bounds the depth of the tree
+	enum { ParallelTaskMinSize = 4096, QueryStackSize = 128 };
+
+	// a subtree whose construction is deferred to the parallel phase of the build
+	struct BuildTask
+	{
+			BuildTask() {}
+			BuildTask(unsigned int n, unsigned int s, unsigned int e, unsigned int l) : nodeId(n), start(s), end(e), level(l) {}
+			unsigned int nodeId, start, end, level;
+	};
+
 	// used to build the tree: split the subset [start..end[ according to dim and splitValue,
 	// and returns the index of the first element of the second subset
-	unsigned int split(int start, int end, unsigned int dim, float splitValue);
+	unsigned int split(int start, int end, unsigned int dim, Scalar splitValue);
 
-	void createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level, unsigned int targetCellsize, unsigned int targetMaxDepth);
+	void createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level, unsigned int targetCellsize, unsigned int targetMaxDepth,
+	                std::vector<BuildTask>* tasks = 0, unsigned int taskSize = 0);
+
+	void buildSubtree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level);
+
+	// the kNN query; the queue gets the ids of the points if storeIds, their position in mPoints otherwise
+	void findK(const VectorType& queryPoint, PriorityQueue& queue, bool storeIds) const;
+
+	static unsigned int mortonCode(const VectorType& p, const AxisAlignedBoxType& box);
 
 protected:
 
@@ -113,31 +146,47 @@ protected:
         NodeList mNodes; //kd-tree nodes
         std::vector<VectorType> mPoints; //points read from the input DataWrapper
         std::vector<int> mIndices; //points indices
+        unsigned int mCellSize; //target number of points per leaf
+        unsigned int mMaxDepth; //maximum depth of the tree
 
-        HeapMaxPriorityQueue<int,Scalar> mNeighborQueue; //used to perform the knn-query
-        QueryNode mNodeStack[64]; //used in the implementation of the knn-query
+        PriorityQueue mNeighborQueue; //used to perform the knn-query with the doQueryK(p) interface
 };
 
+/** Builds the tree of the given points, splitting the cells with more than nofPointsPerCell points.
+  * maxDepth is capped to QueryStackSize-2 (126), the depth the fixed size stack of the queries can handle;
+  * larger values are clamped in release builds.
+  */
 template<typename Scalar>
 KdTree<Scalar>::KdTree(const ConstDataWrapper<VectorType>& points, unsigned int nofPointsPerCell, unsigned int maxDepth)
-        : mPoints(points.size()), mIndices(points.size())
+        : mPoints(points.size()), mIndices(points.size()), mCellSize(nofPointsPerCell), mMaxDepth(std::min<unsigned int>(maxDepth, QueryStackSize-2))
 {
-        // compute the AABB of the input
-        mPoints[0] = points[0];
-        mAABB.Set(mPoints[0]);
-        for (unsigned int i=1 ; i<mPoints.size() ; ++i)
+        assert(maxDepth <= QueryStackSize-2);
+        const int n = int(mPoints.size());
+#pragma omp parallel for schedule(static)
+        for (int i=0 ; i<n ; ++i)
         {
                 mPoints[i] = points[i];
                 mIndices[i] = i;
-                mAABB.Add(mPoints[i]);
         }
 
+        // compute the AABB of the input
+        for (int i=0 ; i<n ; ++i)
+                mAABB.Add(mPoints[i]);
+
         mNodes.reserve(4*mPoints.size()/nofPointsPerCell);
 
         //first node inserted (no leaf). The others are made by the createTree function (recursively)
         mNodes.resize(1);
+        if (n==0)
+        {
+                // an empty tree is a single empty leaf, that can be filled by insert()
+                mNodes.back().leaf = 1;
+                mNodes.back().start = 0;
+                mNodes.back().size = 0;
+                return;
+        }
         mNodes.back().leaf = 0;
-        createTree(0, 0, mPoints.size(), 1, nofPointsPerCell, maxDepth);
+        buildSubtree(0, 0, mPoints.size(), 1);
 }
 
 template<typename Scalar>
@@ -166,29 +215,122 @@ void KdTree<Scalar>::setMaxNofNeighbors(unsigned int k)
   *
   * The result of the query, the k-nearest neighbors, are internally stored into a stack, where the
   * topmost element [0] is NOT the nearest but the farthest!! (they are not sorted but arranged into a heap)
+  *
+  * This version uses the queue of the tree, so it cannot be used by concurrent threads;
+  * use the const version below, with a queue for each thread, or queryKBatch().
         */
 template<typename Scalar>
 void KdTree<Scalar>::doQueryK(const VectorType& queryPoint)
 {
-        mNeighborQueue.init();
-        mNeighborQueue.insert(0xffffffff, std::numeric_limits<Scalar>::max());
+        findK(queryPoint, mNeighborQueue, false);
+}
+
+/** Performs the kNN query storing the result in a queue owned by the caller.
+        *
+        * The queue gets the ids of the k nearest points (queue.getIndex(i)) and their squared distances
+        * (queue.getWeight(i)), arranged into a heap as above. The tree is not modified, so concurrent
+        * queries are safe as long as each thread uses its own queue.
+        */
+template<typename Scalar>
+void KdTree<Scalar>::doQueryK(const VectorType& queryPoint, int k, PriorityQueue& queue) const
+{
+        queue.setMaxSize(k);
+        findK(queryPoint, queue, true);
+}
+
+/** Performs a kNN query for each of the given points, in parallel.
+        *
+        * The ids of the neighbours of the i-th query and their squared distances are stored, sorted by
+        * increasing distance, in ids[i*k .. i*k+k-1] and sqDists[i*k .. i*k+k-1]; when the tree has less
+        * than k points the remaining entries are -1 and std::numeric_limits<Scalar>::max().
+        * The queries are processed along a Morton curve, so that consecutive queries of a thread
+        * visit the same nodes of the tree, whatever the order of the input.
+        */
+template<typename Scalar>
+void KdTree<Scalar>::queryKBatch(const ConstDataWrapper<VectorType>& queries, int k, std::vector<int>& ids, std::vector<Scalar>& sqDists) const
+{
+        const int n = int(queries.size());
+        ids.assign(size_t(n)*k, -1);
+        sqDists.assign(size_t(n)*k, std::numeric_limits<Scalar>::max());
+
+        std::vector<std::pair<unsigned int,int> > order(n);
+#pragma omp parallel for schedule(static)
+        for (int i=0 ; i<n ; ++i)
+                order[i] = std::make_pair(mortonCode(queries[i], mAABB), i);
+        std::sort(order.begin(), order.end());
+
+#pragma omp parallel
+        {
+                PriorityQueue queue;
+                queue.setMaxSize(k);
+                std::vector<std::pair<Scalar,int> > sorted(k);
+#pragma omp for schedule(dynamic,256)
+                for (int o=0 ; o<n ; ++o)
+                {
+                        const int q = order[o].second;
+                        findK(queries[q], queue, true);
+                        int cnt = 0;
+                        for (int i=0 ; i<queue.getNofElements() ; ++i)
+                                if (queue.getIndex(i) != -1)
+                                        sorted[cnt++] = std::make_pair(queue.getWeight(i), queue.getIndex(i));
+                        std::sort(sorted.begin(), sorted.begin()+cnt);
+                        for (int i=0 ; i<cnt ; ++i)
+                        {
+                                ids[size_t(q)*k+i] = sorted[i].second;
+                                sqDists[size_t(q)*k+i] = sorted[i].first;
+                        }
+                }
+        }
+}
+
+/** Position of a point along the Morton (z-order) curve of the box, with 10 bits for each axis.
+        */
+template<typename Scalar>
+unsigned int KdTree<Scalar>::mortonCode(const VectorType& p, const AxisAlignedBoxType& box)
+{
+        unsigned int code = 0;
+        if (box.IsNull())
+                return code;
+        for (int i=0 ; i<3 ; ++i)
+        {
+                const Scalar len = box.max[i] - box.min[i];
+                Scalar t = (len > 0) ? (p[i] - box.min[i]) / len : Scalar(0);
+                t = std::max(Scalar(0), std::min(Scalar(1), t));
+                unsigned int v = std::min(1023u, (unsigned int)(t * 1024));
+                // spread the 10 bits of v so that there are two zero bits between each of them
+                v = (v | (v << 16)) & 0x030000FF;
+                v = (v | (v <<  8)) & 0x0300F00F;
+                v = (v | (v <<  4)) & 0x030C30C3;
+                v = (v | (v <<  2)) & 0x09249249;
+                code |= v << i;
+        }
+        return code;
+}
+
+template<typename Scalar>
+void KdTree<Scalar>::findK(const VectorType& queryPoint, PriorityQueue& queue, bool storeIds) const
+{
+        QueryNode nodeStack[QueryStackSize];
 
-        mNodeStack[0].nodeId = 0;
-        mNodeStack[0].sq = 0.f;
+        queue.init();
+        queue.insert(0xffffffff, std::numeric_limits<Scalar>::max());
+
+        nodeStack[0].nodeId = 0;
+        nodeStack[0].sq = 0;
         unsigned int count = 1;
 
         while (count)
         {
                 //we select the last node (AABB) inserted in the stack
-                QueryNode& qnode = mNodeStack[count-1];
+                QueryNode& qnode = nodeStack[count-1];
 
                 //while going down the tree qnode.nodeId is the nearest sub-tree, otherwise,
                 //in backtracking, qnode.nodeId is the other sub-tree that will be visited iff
                 //the actual nearest node is further than the split distance.
-                Node& node = mNodes[qnode.nodeId];
+                const Node& node = mNodes[qnode.nodeId];
 
                 //if the distance is less than the top of the max-heap, it could be one of the k-nearest neighbours
-                if (qnode.sq < mNeighborQueue.getTopWeight())
+                if (qnode.sq < queue.getTopWeight())
                 {
                         //when we arrive to a lef
                         if (node.leaf)
@@ -199,29 +341,29 @@ void KdTree<Scalar>::doQueryK(const VectorType& queryPoint)
                                 unsigned int end = node.start+node.size;
                                 //adding the element of the leaf to the heap
                                 for (unsigned int i=node.start ; i<end ; ++i)
-                                                mNeighborQueue.insert(i, vcg::SquaredNorm(queryPoint - mPoints[i]));
+                                                queue.insert(storeIds ? mIndices[i] : int(i), vcg::SquaredNorm(queryPoint - mPoints[i]));
                         }
                         //otherwise, if we're not on a leaf
                         else
                         {   
                                 // the new offset is the distance between the searched point and the actual split coordinate
-                                float new_off = queryPoint[node.dim] - node.splitValue;
+                                Scalar new_off = queryPoint[node.dim] - node.splitValue;
 
                                 //left sub-tree
                                 if (new_off < 0.)
                                 {
-                                                mNodeStack[count].nodeId  = node.firstChildId;
+                                                nodeStack[count].nodeId  = node.firstChildId;
                                                 //in the father's nodeId we save the index of the other sub-tree (for backtracking)
                                                 qnode.nodeId = node.firstChildId+1;
                                 }
                                 //right sub-tree (same as above)
                                 else
                                 {
-                                                mNodeStack[count].nodeId  = node.firstChildId+1;
+                                                nodeStack[count].nodeId  = node.firstChildId+1;
                                                 qnode.nodeId = node.firstChildId;
                                 }
                                 //distance is inherited from the father (while descending the tree it's equal to 0)
-                                mNodeStack[count].sq = qnode.sq;
+                                nodeStack[count].sq = qnode.sq;
                                 //distance of the father is the squared distance from the split plane
                                 qnode.sq = new_off*new_off;
                                 ++count;
@@ -241,7 +383,7 @@ void KdTree<Scalar>::doQueryK(const VectorType& queryPoint)
  * using the "dim" coordinate [0 = x, 1 = y, 2 = z].
  */
 template<typename Scalar>
-unsigned int KdTree<Scalar>::split(int start, int end, unsigned int dim, float splitValue)
+unsigned int KdTree<Scalar>::split(int start, int end, unsigned int dim, Scalar splitValue)
 {
         int l(start), r(end-1);
         for ( ; l<r ; ++l, --r)
@@ -275,12 +417,16 @@ unsigned int KdTree<Scalar>::split(int start, int end, unsigned int dim, float s
         *  Actually, storing at each node the exact AABB (we therefore have a binary BVH) allows
         *  to prune only about 10% of the leaves, but the overhead of this pruning (ball/ABBB intersection)
         *  is more expensive than the gain it provides and the memory consumption is x4 higher !
+        *
+        *  The new nodes are appended to the given node list. If tasks is not null, the children
+        *  with no more than taskSize points are not built but are appended to the tasks list.
         */
 template<typename Scalar>
-void KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level, unsigned int targetCellSize, unsigned int targetMaxDepth)
+void KdTree<Scalar>::createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level, unsigned int targetCellSize, unsigned int targetMaxDepth,
+                                std::vector<BuildTask>* tasks, unsigned int taskSize)
 {
         //select the first node
-        Node& node = mNodes[nodeId];
+        Node& node = nodes[nodeId];
         AxisAlignedBoxType aabb;
 
         //putting all the points in the bounding box
@@ -301,13 +447,13 @@ void KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigne
         unsigned int midId = split(start, end, dim, node.splitValue);
 
 
-        node.firstChildId = mNodes.size();
-        mNodes.resize(mNodes.size()+2);
+        node.firstChildId = nodes.size();
+        nodes.resize(nodes.size()+2);
 
         {
                 // left child
-                unsigned int childId = mNodes[nodeId].firstChildId;
-                Node& child = mNodes[childId];
+                unsigned int childId = nodes[nodeId].firstChildId;
+                Node& child = nodes[childId];
                 if (midId - start <= targetCellSize || level>=targetMaxDepth)
                 {
                                 child.leaf = 1;
@@ -317,14 +463,17 @@ void KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigne
                 else
                 {
                                 child.leaf = 0;
-                                createTree(childId, start, midId, level+1, targetCellSize, targetMaxDepth);
+                                if (tasks && midId - start <= taskSize)
+                                        tasks->push_back(BuildTask(childId, start, midId, level+1));
+                                else
+                                        createTree(nodes, childId, start, midId, level+1, targetCellSize, targetMaxDepth, tasks, taskSize);
                 }
         }
 
         {
                 // right child
-                unsigned int childId = mNodes[nodeId].firstChildId+1;
-                Node& child = mNodes[childId];
+                unsigned int childId = nodes[nodeId].firstChildId+1;
+                Node& child = nodes[childId];
                 if (end - midId <= targetCellSize || level>=targetMaxDepth)
                 {
                         child.leaf = 1;
@@ -334,7 +483,163 @@ void KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigne
                 else
                 {
                         child.leaf = 0;
-                        createTree(childId, midId, end, level+1, targetCellSize, targetMaxDepth);
+                        if (tasks && end - midId <= taskSize)
+                                tasks->push_back(BuildTask(childId, midId, end, level+1));
+                        else
+                                createTree(nodes, childId, midId, end, level+1, targetCellSize, targetMaxDepth, tasks, taskSize);
+                }
+        }
+}
+
+/** Builds the subtree rooted at the (non leaf) node nodeId, containing the points [start..end[.
+        *
+        * The top levels are built serially, until the subtrees have less than about 1/64 of the points;
+        * these subtrees are then built in parallel, each one in its own node list, and finally
+        * appended to mNodes. The task size does not depend on the number of threads, so the tree
+        * is always the same.
+        */
+template<typename Scalar>
+void KdTree<Scalar>::buildSubtree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level)
+{
+        if (end - start < 2*ParallelTaskMinSize)
+        {
+                createTree(mNodes, nodeId, start, end, level, mCellSize, mMaxDepth);
+                return;
+        }
+
+        std::vector<BuildTask> tasks;
+        unsigned int taskSize = std::max<unsigned int>((end - start)/64, ParallelTaskMinSize);
+        createTree(mNodes, nodeId, start, end, level, mCellSize, mMaxDepth, &tasks, taskSize);
+
+        std::vector<NodeList> subtrees(tasks.size());
+#pragma omp parallel for schedule(dynamic,1)
+        for (int t=0 ; t<int(tasks.size()) ; ++t)
+        {
+                // the root of the subtree is the local node 0
+                subtrees[t].reserve(4*(tasks[t].end - tasks[t].start)/mCellSize);
+                subtrees[t].resize(1);
+                subtrees[t][0].leaf = 0;
+                createTree(subtrees[t], 0, tasks[t].start, tasks[t].end, tasks[t].level, mCellSize, mMaxDepth);
+        }
+
+        for (size_t t=0 ; t<tasks.size() ; ++t)
+        {
+                // local node i>0 goes to offset+i, while the local root replaces the task node
+                const unsigned int offset = mNodes.size() - 1;
+                for (size_t i=1 ; i<subtrees[t].size() ; ++i)
+                {
+                        mNodes.push_back(subtrees[t][i]);
+                        if (!mNodes.back().leaf)
+                                mNodes.back().firstChildId += offset;
+                }
+                mNodes[tasks[t].nodeId] = subtrees[t][0];
+                mNodes[tasks[t].nodeId].firstChildId += offset;
+                NodeList().swap(subtrees[t]);
+        }
+}
+
+/** Adds a batch of points to the tree, without rebuilding it.
+        *
+        * The new points get the ids following the ones already in the tree (i.e. the i-th new point has
+        * id size+i), so when the points are vertices appended to a mesh the ids are still vertex indices:
+        *
+        *   ConstDataWrapper<CoordType> ww(&m.vert[oldVn].P(), m.vn-oldVn, sizeof(VertexType));
+        *   tree.insert(ww);
+        *
+        * Each new point is added to the leaf containing it, and the leaves that become larger than
+        * the target cell size are split as in the construction. The cost is linear in the number of
+        * points of the tree (the points array is compacted again) plus the cost of building the
+        * split leaves, much lower than a whole rebuild.
+        */
+template<typename Scalar>
+void KdTree<Scalar>::insert(const ConstDataWrapper<VectorType>& points)
+{
+        const int addNum = int(points.size());
+        if (addNum==0)
+                return;
+        const unsigned int oldNum = mPoints.size();
+        const int nodeNum = int(mNodes.size());
+
+        // find the leaf of each new point
+        std::vector<unsigned int> leafOf(addNum);
+#pragma omp parallel for schedule(static)
+        for (int i=0 ; i<addNum ; ++i)
+        {
+                const VectorType& p = points[i];
+                unsigned int id = 0;
+                while (!mNodes[id].leaf)
+                        id = mNodes[id].firstChildId + (p[mNodes[id].dim] < mNodes[id].splitValue ? 0 : 1);
+                leafOf[i] = id;
+        }
+        for (int i=0 ; i<addNum ; ++i)
+                mAABB.Add(points[i]);
+
+        // new layout of the points: the leaves keep their order, each one followed by its new points
+        std::vector<unsigned int> newSize(nodeNum, 0);
+        std::vector<unsigned int> newStart(nodeNum, 0);
+        for (int i=0 ; i<addNum ; ++i)
+                ++newSize[leafOf[i]];
+        std::vector<int> leaves;
+        for (int id=0 ; id<nodeNum ; ++id)
+                if (mNodes[id].leaf)
+                {
+                        newSize[id] += mNodes[id].size;
+                        leaves.push_back(id);
+                }
+        unsigned int pos = 0;
+        for (size_t l=0 ; l<leaves.size() ; ++l)
+        {
+                newStart[leaves[l]] = pos;
+                pos += newSize[leaves[l]];
+        }
+
+        std::vector<VectorType> points2(oldNum+addNum);
+        std::vector<int> indices2(oldNum+addNum);
+        std::vector<unsigned int> fill(nodeNum, 0);
+#pragma omp parallel for schedule(static)
+        for (int l=0 ; l<int(leaves.size()) ; ++l)
+        {
+                const Node& leaf = mNodes[leaves[l]];
+                const unsigned int dst = newStart[leaves[l]];
+                for (unsigned int i=0 ; i<leaf.size ; ++i)
+                {
+                        points2[dst+i] = mPoints[leaf.start+i];
+                        indices2[dst+i] = mIndices[leaf.start+i];
+                }
+                fill[leaves[l]] = dst + leaf.size;
+        }
+        for (int i=0 ; i<addNum ; ++i)
+        {
+                const unsigned int dst = fill[leafOf[i]]++;
+                points2[dst] = points[i];
+                indices2[dst] = oldNum + i;
+        }
+        mPoints.swap(points2);
+        mIndices.swap(indices2);
+
+        // level of each node; children are always stored after their parent
+        std::vector<unsigned int> level(nodeNum, 0);
+        level[0] = 1;
+        for (int id=0 ; id<nodeNum ; ++id)
+                if (!mNodes[id].leaf)
+                        level[mNodes[id].firstChildId] = level[mNodes[id].firstChildId+1] = level[id]+1;
+
+        // update the leaves, splitting the ones that are now too large
+        for (size_t l=0 ; l<leaves.size() ; ++l)
+        {
+                const int id = leaves[l];
+                const unsigned int start = newStart[id];
+                const unsigned int end = start + newSize[id];
+                if (end - start > mCellSize && level[id] <= mMaxDepth)
+                {
+                        mNodes[id].leaf = 0;
+                        buildSubtree(id, start, end, level[id]);
+                }
+                else
+                {
+                        assert(end - start < (1u<<26));
+                        mNodes[id].start = start;
+                        mNodes[id].size = end - start;
                 }
         }
 }
@@ -41,6 +41,32 @@ public:
 	{
 		mElements = 0;
 		mMaxSize = 0;
+		mCount = 0;
+	}
+
+	HeapMaxPriorityQueue(const HeapMaxPriorityQueue& q)
+	{
+		mElements = 0;
+		mMaxSize = 0;
+		mCount = 0;
+		*this = q;
+	}
+
+	~HeapMaxPriorityQueue()
+	{
+		delete[] mElements;
+	}
+
+	HeapMaxPriorityQueue& operator=(const HeapMaxPriorityQueue& q)
+	{
+		if (this != &q)
+		{
+			setMaxSize(q.mMaxSize);
+			mCount = q.mCount;
+			for (int i=0 ; i<mCount ; ++i)
+				mElements[i] = q.mElements[i];
+		}
+		return *this;
 	}
 
 	inline void setMaxSize(int maxSize)
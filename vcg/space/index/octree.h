@@ -279,31 +279,29 @@ public:
 			std::vector< ObjectPlaceholder< NodeType > > placeholders/*(dataset_dimension)*/;
 			vcg::Box3<ScalarType>		object_bb;
 			vcg::Point3<ScalarType> hit_leaf;
+			const CoordType &origin = TemplatedOctree::boundingBox.min;
+			const CoordType &leaf_dim = TemplatedOctree::leafDimension;
 			for (int i=0; i<dataset_dimension; i++, iObj++)
 			{
+				// the object is referenced by all the leaves overlapping its bounding-box
 				(*iObj).GetBBox(object_bb);
-				hit_leaf  = object_bb.min;
-
-				while (object_bb.IsIn(hit_leaf))
+				vcg::Point3i first_leaf, last_leaf;
+				for (int d=0; d<3; d++)
 				{
-					int placeholder_index = int(placeholders.size());
-					placeholders.push_back( ObjectPlaceholder< NodeType >() ); 
-                    placeholders[placeholder_index].z_order			 = TemplatedOctree::BuildRoute(hit_leaf, route);
-					placeholders[placeholder_index].leaf_pointer = route[depth];
-					placeholders[placeholder_index].object_index = i;					
-					
-					hit_leaf.X() += TemplatedOctree::leafDimension.X();
-					if (hit_leaf.X()>object_bb.max.X())
-					{
-						hit_leaf.X() = object_bb.min.X();
-						hit_leaf.Z()+= TemplatedOctree::leafDimension.Z();
-						if (hit_leaf.Z()>object_bb.max.Z())
+					first_leaf[d] = int(floor((object_bb.min[d]-origin[d])/leaf_dim[d]));
+					last_leaf[d]  = int(floor((object_bb.max[d]-origin[d])/leaf_dim[d]));
+				}
+				for (int y=first_leaf.Y(); y<=last_leaf.Y(); y++)
+					for (int z=first_leaf.Z(); z<=last_leaf.Z(); z++)
+						for (int x=first_leaf.X(); x<=last_leaf.X(); x++)
 						{
-							hit_leaf.Z() = object_bb.min.Z();
-							hit_leaf.Y()+= TemplatedOctree::leafDimension.Y();
+							hit_leaf = origin + CoordType(leaf_dim.X()*(x+0.5f), leaf_dim.Y()*(y+0.5f), leaf_dim.Z()*(z+0.5f));
+							int placeholder_index = int(placeholders.size());
+							placeholders.push_back( ObjectPlaceholder< NodeType >() ); 
+							placeholders[placeholder_index].z_order			 = TemplatedOctree::BuildRoute(hit_leaf, route);
+							placeholders[placeholder_index].leaf_pointer = route[depth];
+							placeholders[placeholder_index].object_index = i;					
 						}
-					}
-				}
 			}
 			delete []route;
 
@@ -347,12 +345,15 @@ public:
 
 		/*!
 		* Finds the closest object to a given point.
+		* The objects already tested are marked with the given marker and not with the
+		* marks stored in the octree, so that several threads can query the same octree,
+		* each with its own marker.
 		*/
 		template <class OBJECT_POINT_DISTANCE_FUNCTOR, class OBJECT_MARKER>
 		ObjectPointer GetClosest
 		(
 			OBJECT_POINT_DISTANCE_FUNCTOR & distance_functor, 
-			OBJECT_MARKER									& /*marker*/, 
+			OBJECT_MARKER									& marker, 
 			const CoordType								& query_point, 
 			const ScalarType							& max_distance,
 			ScalarType										& distance, 
@@ -366,26 +367,39 @@ public:
 				return NULL;
 			
 			std::vector< NodePointer > leaves;
-
-			//unsigned int object_count;
-			//int					 leaves_count;
-
-			IncrementMark();
 			AdjustBoundingBox(query_bb, sphere_radius, max_distance, leaves, 1);
 
 			if (sphere_radius>max_distance)
 				return NULL;
 
-			std::vector< Neighbour > neighbors;
-			RetrieveContainedObjects(query_point, distance_functor, max_distance, allow_zero_distance, leaves, neighbors);
-			
-			typename std::vector< Neighbour >::iterator first = neighbors.begin();
-			typename std::vector< Neighbour >::iterator last	= neighbors.end();
-			std::partial_sort(first, first+1, last);
-			
-			distance	= neighbors[0].distance;
-			point			= neighbors[0].point;
-			return			neighbors[0].object;
+			ObjectPointer closest_object = NULL;
+			CoordType			closest_point;
+			marker.UnMarkAll();
+			for (int i=0, leaves_count=int(leaves.size()); i<leaves_count; i++)
+			{
+				VoxelType	*voxel	= TemplatedOctree::Voxel(leaves[i]);
+				for (int begin=voxel->begin; begin<voxel->end; begin++)
+				{
+					ObjectPointer object = sorted_dataset[begin].pObject;
+					if (marker.IsMarked(object))
+						continue;
+					marker.Mark(object);
+
+					ScalarType object_distance = max_distance;
+					if (!distance_functor(*object, query_point, object_distance, closest_point))
+						continue;
+					if (object_distance==ScalarType(0.0) && !allow_zero_distance)
+						continue;
+
+					if (closest_object==NULL || object_distance<distance)
+					{
+						closest_object = object;
+						distance	= object_distance;
+						point			= closest_point;
+					}
+				}
+			}
+			return closest_object;
 		}; //end of GetClosest
 
 		/*!
@@ -447,7 +461,7 @@ OBJECT_RETRIEVER:
 		unsigned int GetInSphere
 			(
 				OBJECT_POINT_DISTANCE_FUNCTOR		&distance_functor, 
-				OBJECT_MARKER										&/*marker*/,
+				OBJECT_MARKER										&marker,
 				const CoordType									&sphere_center, 
 				const ScalarType								&sphere_radius,
 				OBJECT_POINTER_CONTAINER				&objects, 
@@ -468,13 +482,24 @@ OBJECT_RETRIEVER:
 			std::vector< Neighbour	 > neighbors;
 
 			IncrementMark();
-			ContainedLeaves(query_bb, leaves, TemplatedOctree::Root(), TemplatedOctree::boundingBox);
+			TemplatedOctree::ContainedLeaves(query_bb, leaves, TemplatedOctree::Root(), TemplatedOctree::boundingBox);
 
 			int	leaves_count = int(leaves.size());
 			if (leaves_count==0)
 				return 0;
 
-			int object_count = RetrieveContainedObjects(sphere_center, distance_functor, sphere_radius, allow_zero_distance, leaves, neighbors);
+			RetrieveContainedObjects(sphere_center, distance_functor, sphere_radius, allow_zero_distance, leaves, neighbors);
+
+			// an object spanning several leaves is retrieved once for each of them
+			marker.UnMarkAll();
+			int object_count = 0;
+			for (int i=0, neighbors_count=int(neighbors.size()); i<neighbors_count; i++)
+				if (!marker.IsMarked(neighbors[i].object))
+				{
+					marker.Mark(neighbors[i].object);
+					neighbors[object_count++] = neighbors[i];
+				}
+			neighbors.resize(object_count);
 
 			NeighbourIterator first = neighbors.begin();
 			NeighbourIterator last	= neighbors.end();
@@ -490,29 +515,29 @@ OBJECT_RETRIEVER:
 			template <class OBJECT_MARKER, class OBJECT_POINTER_CONTAINER>
 			unsigned int GetInBox
 				(
-					OBJECT_MARKER							&/*marker*/, 
+					OBJECT_MARKER							&marker, 
 					const BoundingBoxType			&query_bounding_box,
 					OBJECT_POINTER_CONTAINER	&objects
 					) 
 			{
 				//if the query bounding-box don't collide with the octree bounding-box, simply return 0
-				if (!query_bounding_box.Collide())
-				{
-					objects.clear();
+				objects.clear();
+				if (!TemplatedOctree::boundingBox.Collide(query_bounding_box))
 					return 0;
-				}
 				
 				//otherwise, retrieve the leaves and fill the container with the objects contained
 				std::vector< NodePointer > leaves;
-				unsigned int object_count;
+				BoundingBoxType query_bb = query_bounding_box;
 				int					 leaves_count;
 			
-				TemplatedOctree::ContainedLeaves(query_bounding_box, leaves, TemplatedOctree::Root(), TemplatedOctree::boundingBox);
+				TemplatedOctree::ContainedLeaves(query_bb, leaves, TemplatedOctree::Root(), TemplatedOctree::boundingBox);
 				leaves_count = int(leaves.size());
 				if (leaves_count==0)
 					return 0;
 				
-				IncrementMark();
+				// as in GridGetInBox, the objects are marked (an object can span several leaves)
+				// and returned only if their bounding-box collides with the query one
+				marker.UnMarkAll();
 				for (int i=0; i<leaves_count; i++)
 				{
 					VoxelType *voxel = TemplatedOctree::Voxel(leaves[i]);
@@ -520,12 +545,17 @@ OBJECT_RETRIEVER:
 					int end		= voxel->end;
 					for ( ; begin<end; begin++)
 					{
-						ObjectReference *ref	= &sorted_dataset[begin];
-						if (IsMarked(ref))
+						ObjectPointer object = sorted_dataset[begin].pObject;
+						if (marker.IsMarked(object))
 							continue;
-						
-						Mark(ref);
-						objects.push_back(ref->pObject);
+
+						BoundingBoxType object_bb;
+						object->GetBBox(object_bb);
+						if (object_bb.Collide(query_bounding_box))
+						{
+							marker.Mark(object);
+							objects.push_back(object);
+						}
 					} //end of for ( ; begin<end; begin++)
 				} // end of for (int i=0; i<leavesCount; i++)
 
@@ -0,0 +1,185 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2009                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_IO_ASCII_PARSER
+#define __VCGLIB_IO_ASCII_PARSER
+
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <locale>
+#include <string>
+#include <vector>
+
+namespace vcg {
+namespace tri {
+namespace io {
+
+/** Helpers for the ascii importers that parse a whole file (or a big part of it) kept in memory.
+The numbers are parsed without strtod/scanf, so the result does not depend on the C locale
+(the decimal separator is always '.') and the buffers do not need to be null terminated:
+every function gets the end of the buffer and advances the pointer past what it has read.
+The buffer can be split into chunks ending at a newline (SplitLines) that are then parsed
+by different threads.
+*/
+class AsciiParser
+{
+public:
+  static inline bool IsBlank(char c) { return c==' ' || c=='\t' || c=='\r'; }
+
+  static inline const char *SkipBlanks(const char *p, const char *end)
+  {
+    while(p<end && IsBlank(*p)) ++p;
+    return p;
+  }
+
+  /// End of the current token (a blank, a newline or the end of the buffer)
+  static inline const char *SkipToken(const char *p, const char *end)
+  {
+    while(p<end && !IsBlank(*p) && *p!='\n') ++p;
+    return p;
+  }
+
+  /// Beginning of the next line (or end)
+  static inline const char *NextLine(const char *p, const char *end)
+  {
+    const char *nl = (const char *)memchr(p,'\n',end-p);
+    return nl ? nl+1 : end;
+  }
+
+  /// Reads an integer with an optional sign; false if there are no digits.
+  /// The value is accumulated unsigned (modulo 2^32), so the unsigned values above INT_MAX
+  /// come back unchanged when the result is cast to unsigned int.
+  static inline bool ParseInt(const char *&p, const char *end, int &val)
+  {
+    bool neg=false;
+    if(p<end && (*p=='-' || *p=='+')) { neg=(*p=='-'); ++p; }
+    if(p==end || *p<'0' || *p>'9') return false;
+    unsigned int v=0;
+    while(p<end && *p>='0' && *p<='9') v=v*10u+unsigned(*p++-'0');
+    val = int(neg ? 0u-v : v);
+    return true;
+  }
+
+  /// Reads a floating point number (with optional sign, fraction and exponent);
+  /// false if it is not a number.
+  /// The usual numbers (up to 15 significant digits, small exponents) are computed with a single
+  /// multiplication or division by an exact power of ten, which gives the correctly rounded value;
+  /// the others (and inf/nan) go through a stream with the classic locale.
+  static inline bool ParseDouble(const char *&p, const char *end, double &val)
+  {
+    const char *start=p;
+    bool neg=false;
+    if(p<end && (*p=='-' || *p=='+')) { neg=(*p=='-'); ++p; }
+    unsigned long long mant=0;
+    int digits=0, exp10=0;
+    bool any=false;
+    while(p<end && *p=='0') { ++p; any=true; } // leading zeros are not significant
+    while(p<end && *p>='0' && *p<='9')
+    {
+      if(digits<19) { mant=mant*10+(*p-'0'); ++digits; }
+      else ++exp10;
+      ++p; any=true;
+    }
+    if(p<end && *p=='.')
+    {
+      ++p;
+      if(digits==0)
+        while(p<end && *p=='0') { ++p; --exp10; any=true; }
+      while(p<end && *p>='0' && *p<='9')
+      {
+        if(digits<19) { mant=mant*10+(*p-'0'); ++digits; --exp10; }
+        ++p; any=true;
+      }
+    }
+    if(!any) return SlowParseDouble(start,end,p,val);
+    if(p<end && (*p=='e' || *p=='E'))
+    {
+      const char *e=p+1;
+      int ev;
+      if(ParseInt(e,end,ev)) { exp10+=ev; p=e; }
+    }
+    if(digits>15 || exp10<-22 || exp10>22) return SlowParseDouble(start,end,p,val);
+    static const double pow10[23]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+                                   1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    double v=double(mant);
+    if(exp10<0) v/=pow10[-exp10];
+    else v*=pow10[exp10];
+    val = neg ? -v : v;
+    return true;
+  }
+
+  static inline bool ParseFloat(const char *&p, const char *end, float &val)
+  {
+    double d;
+    if(!ParseDouble(p,end,d)) return false;
+    val=float(d);
+    return true;
+  }
+
+  /// Split [begin,end) in at most chunkNum pieces of similar size, each one ending after a newline
+  /// (except the last). bounds gets the chunk limits: chunk i is [bounds[i],bounds[i+1]).
+  static void SplitLines(const char *begin, const char *end, int chunkNum, std::vector<const char *> &bounds)
+  {
+    bounds.clear();
+    bounds.push_back(begin);
+    const size_t step=size_t(end-begin)/size_t(chunkNum>0?chunkNum:1)+1;
+    const char *p=begin;
+    while(p<end)
+    {
+      const char *q=(size_t(end-p)>step) ? NextLine(p+step,end) : end;
+      bounds.push_back(q);
+      p=q;
+    }
+  }
+
+  /// Read the whole file in memory
+  static bool ReadFile(const char *filename, std::vector<char> &buf)
+  {
+    std::ifstream stream(filename, std::ios::in|std::ios::binary);
+    if(stream.fail()) return false;
+    stream.seekg(0,std::ios::end);
+    const std::streamoff len=stream.tellg();
+    stream.seekg(0,std::ios::beg);
+    if(len<0) return false;
+    buf.resize(size_t(len));
+    if(len>0) stream.read(&buf[0],len);
+    return !stream.fail();
+  }
+
+private:
+  static bool SlowParseDouble(const char *start, const char *end, const char *&p, double &val)
+  {
+    std::istringstream ss(std::string(start,SkipToken(start,end)));
+    ss.imbue(std::locale::classic());
+    ss >> val;
+    if(ss.fail()) return false;
+    const std::streamoff read = ss.eof() ? std::streamoff(SkipToken(start,end)-start) : std::streamoff(ss.tellg());
+    p=start+read;
+    return true;
+  }
+};
+
+} // end namespace io
+} // end namespace tri
+} // end namespace vcg
+#endif
@@ -0,0 +1,314 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_EXPORT_PLY_STREAM
+#define __VCGLIB_EXPORT_PLY_STREAM
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include <vcg/space/point3.h>
+#include <vcg/space/color4.h>
+#include <wrap/ply/plylib.h>
+#include <wrap/io_trimesh/io_mask.h>
+
+namespace vcg {
+namespace tri {
+namespace io {
+
+/** \brief Binary ply writer that receives the mesh in batches, without building it in memory.
+
+Vertices and triangles are pushed in any number of batches; face indices are global indices in the
+order the vertices were pushed. The mask given to Open() selects the optional properties:
+vertex normal, color and quality (IOM_VERTNORMAL, IOM_VERTCOLOR, IOM_VERTQUALITY) and face color
+and quality (IOM_FACECOLOR, IOM_FACEQUALITY); the batches that do not carry them write zero
+normals, white colors and zero quality.
+
+The records are converted in memory buffers written to the file with a few big fwrite.
+Vertices are written right after the header. The faces must follow all the vertices in a ply
+file, so they are spooled to a temporary file and appended by Close(), unless the number of vertices
+has been declared in Open(): then, if the first face is pushed after all the declared vertices, the
+faces go directly to the file (and no vertex can follow them).
+Close() writes the final element counts in the (fixed width) header fields, so the declared counts
+are only a hint.
+
+Typical users: the streaming marching cubes walker (StreamingWalker), point sampling (through
+PlyStreamSampler) and clustering (Clustering::ExtractMesh on a stream), or any generator that
+pushes pieces of mesh with PushMesh().
+
+\code
+  io::PlyStreamWriter out;
+  out.Open("out.ply", io::Mask::IOM_VERTNORMAL);
+  for(...) {
+    piece.Clear(); BuildPiece(piece);
+    out.PushMesh(piece);           // its vertices and faces, indices offset by the vertices already pushed
+  }
+  out.Close();
+\endcode
+*/
+class PlyStreamWriter
+{
+public:
+  /// Errors returned by Close() when the file could not be completely written, or when some vertices
+  /// were pushed after faces already written (the other codes are the ply ones)
+  enum { E_CANTWRITE = ::vcg::ply::E_MAXPLYERRORS, E_VERTAFTERFACE };
+
+  PlyStreamWriter():fpout(0),fpface(0),vn(0),fn(0),mask(0),declaredVn(-1),direct(false),error(::vcg::ply::E_NOERROR) {}
+  ~PlyStreamWriter() { if(fpout) Close(); }
+
+  /// Create the file and write the header; vertNum and faceNum, if known, are written in the header
+  /// (otherwise placeholders) and a known vertNum avoids spooling the faces.
+  int Open(const char *filename, int _mask=0, int vertNum=-1, int faceNum=-1)
+  {
+    fpout = fopen(filename,"wb");
+    if(fpout==NULL) return ::vcg::ply::E_CANTOPEN;
+    fpface = 0;
+    vn=fn=0;
+    mask=_mask;
+    declaredVn=vertNum;
+    direct=false;
+    error=::vcg::ply::E_NOERROR;
+    vbuf.clear();
+    fbuf.clear();
+    fprintf(fpout,
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "comment VCGLIB generated\n"
+      "element vertex ");
+    vnPos=ftell(fpout);
+    fprintf(fpout,"%*d\n",CountWidth,vertNum>0?vertNum:0);
+    fprintf(fpout,
+      "property float x\n"
+      "property float y\n"
+      "property float z\n");
+    if(mask & Mask::IOM_VERTNORMAL)  fprintf(fpout,"property float nx\nproperty float ny\nproperty float nz\n");
+    if(mask & Mask::IOM_VERTCOLOR)   fprintf(fpout,"property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n");
+    if(mask & Mask::IOM_VERTQUALITY) fprintf(fpout,"property float quality\n");
+    fprintf(fpout,"element face ");
+    fnPos=ftell(fpout);
+    fprintf(fpout,"%*d\n",CountWidth,faceNum>0?faceNum:0);
+    fprintf(fpout,"property list uchar int vertex_indices\n");
+    if(mask & Mask::IOM_FACECOLOR)   fprintf(fpout,"property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n");
+    if(mask & Mask::IOM_FACEQUALITY) fprintf(fpout,"property float quality\n");
+    fprintf(fpout,"end_header\n");
+    return ::vcg::ply::E_NOERROR;
+  }
+
+  /// Append a vertex; the optional properties are taken only if the mask has them
+  template <class PointType>
+  void PushVertex(const PointType &p, const PointType &n=PointType(0,0,0), const Color4b &c=Color4b(Color4b::White), float q=0)
+  {
+    if(direct) error=E_VERTAFTERFACE;
+    char *r=NewRecord(vbuf,VertexRecordSize());
+    r=Put(r,float(p[0])); r=Put(r,float(p[1])); r=Put(r,float(p[2]));
+    if(mask & Mask::IOM_VERTNORMAL) { r=Put(r,float(n[0])); r=Put(r,float(n[1])); r=Put(r,float(n[2])); }
+    if(mask & Mask::IOM_VERTCOLOR)   { memcpy(r,&c[0],4); r+=4; }
+    if(mask & Mask::IOM_VERTQUALITY) r=Put(r,q);
+    ++vn;
+    if(vbuf.size()>=BufferSize) FlushVertices();
+  }
+
+  /// Append a batch of vertices
+  template <class PointType>
+  void PushVertices(const std::vector<PointType> &pos)
+  {
+    for(size_t i=0;i<pos.size();++i)
+      PushVertex(pos[i]);
+  }
+
+  /// Append a triangle, given as global vertex indices
+  void PushFace(int v0, int v1, int v2, const Color4b &c=Color4b(Color4b::White), float q=0)
+  {
+    assert(v0>=0 && v0<vn && v1>=0 && v1<vn && v2>=0 && v2<vn);
+    if(fn==0 && declaredVn>=0 && vn>=declaredVn)
+    {
+      // all the vertices are known: the faces follow them in the file
+      direct=true;
+      FlushVertices();
+    }
+    char *r=NewRecord(fbuf,FaceRecordSize());
+    *r++=3;
+    r=Put(r,v0); r=Put(r,v1); r=Put(r,v2);
+    if(mask & Mask::IOM_FACECOLOR)   { memcpy(r,&c[0],4); r+=4; }
+    if(mask & Mask::IOM_FACEQUALITY) r=Put(r,q);
+    ++fn;
+    if(fbuf.size()>=BufferSize) FlushFaces();
+  }
+
+  /// Append a batch of triangles, given as global vertex indices
+  void PushFaces(const std::vector<Point3i> &tri)
+  {
+    for(size_t i=0;i<tri.size();++i)
+      PushFace(tri[i][0],tri[i][1],tri[i][2]);
+  }
+
+  /// Append the (not deleted) vertices and faces of a mesh: the face indices are offset
+  /// by the number of vertices already pushed. The properties of the mask that the
+  /// mesh does not have get the default values.
+  template <class MeshType>
+  void PushMesh(const MeshType &m)
+  {
+    typedef typename MeshType::CoordType CoordType;
+    if(m.vert.empty()) return;
+    const bool hasN=HasPerVertexNormal(m), hasC=HasPerVertexColor(m), hasQ=HasPerVertexQuality(m);
+    const int base=vn;
+    std::vector<int> remap(m.vert.size(),-1);
+    for(size_t i=0;i<m.vert.size();++i)
+    {
+      const typename MeshType::VertexType &v=m.vert[i];
+      if(v.IsD()) continue;
+      remap[i]=vn-base;
+      PushVertex(v.cP(), hasN ? v.cN() : CoordType(0,0,0),
+                 hasC ? v.cC() : Color4b(Color4b::White), hasQ ? float(v.cQ()) : 0.f);
+    }
+    const bool hasFC=HasPerFaceColor(m), hasFQ=HasPerFaceQuality(m);
+    for(size_t i=0;i<m.face.size();++i)
+    {
+      const typename MeshType::FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      PushFace(base+remap[f.cV(0)-&m.vert[0]],base+remap[f.cV(1)-&m.vert[0]],base+remap[f.cV(2)-&m.vert[0]],
+               hasFC ? f.cC() : Color4b(Color4b::White), hasFQ ? float(f.cQ()) : 0.f);
+    }
+  }
+
+  int VN() const { return vn; }
+  int FN() const { return fn; }
+
+  /// Append the spooled faces and write the final counts in the header.
+  int Close()
+  {
+    FlushVertices();
+    FlushFaces();
+    int ret=error;
+    if(fpface)
+    {
+      rewind(fpface);
+      std::vector<char> copyBuf(BufferSize);
+      size_t n;
+      while((n=fread(&copyBuf[0],1,copyBuf.size(),fpface))>0)
+        if(fwrite(&copyBuf[0],1,n,fpout)!=n) ret=E_CANTWRITE;
+      fclose(fpface);
+      fpface=0;
+    }
+    fseek(fpout,vnPos,SEEK_SET);
+    fprintf(fpout,"%*d",CountWidth,vn);
+    fseek(fpout,fnPos,SEEK_SET);
+    fprintf(fpout,"%*d",CountWidth,fn);
+    if(fclose(fpout)!=0) ret=E_CANTWRITE;
+    fpout=0;
+    return ret;
+  }
+
+protected:
+  enum { CountWidth = 12, BufferSize = 1<<20 };
+
+  int VertexRecordSize() const
+  {
+    return 12 + ((mask & Mask::IOM_VERTNORMAL)?12:0) + ((mask & Mask::IOM_VERTCOLOR)?4:0) + ((mask & Mask::IOM_VERTQUALITY)?4:0);
+  }
+  int FaceRecordSize() const
+  {
+    return 13 + ((mask & Mask::IOM_FACECOLOR)?4:0) + ((mask & Mask::IOM_FACEQUALITY)?4:0);
+  }
+  static char *NewRecord(std::vector<char> &b, int size)
+  {
+    const size_t old=b.size();
+    b.resize(old+size);
+    return &b[old];
+  }
+  template <class T>
+  static char *Put(char *r, const T &v) { memcpy(r,&v,sizeof(T)); return r+sizeof(T); }
+
+  void FlushVertices()
+  {
+    if(vbuf.empty()) return;
+    if(fwrite(&vbuf[0],1,vbuf.size(),fpout)!=vbuf.size()) error=E_CANTWRITE;
+    vbuf.clear();
+  }
+  void FlushFaces()
+  {
+    if(fbuf.empty()) return;
+    FILE *fp=fpout;
+    if(!direct)
+    {
+      if(fpface==0) fpface=tmpfile();
+      if(fpface==0) { error=E_CANTWRITE; fbuf.clear(); return; }
+      fp=fpface;
+    }
+    if(fwrite(&fbuf[0],1,fbuf.size(),fp)!=fbuf.size()) error=E_CANTWRITE;
+    fbuf.clear();
+  }
+
+  FILE *fpout;
+  FILE *fpface;
+  long vnPos,fnPos;
+  int vn,fn;
+  int mask;
+  int declaredVn;
+  bool direct;   // the faces are written right after the vertices, decided by the first face
+  int error;
+  std::vector<char> vbuf;
+  std::vector<char> fbuf;
+};
+
+/** Sampler for SurfaceSampling that writes the samples (position and normal) to a PlyStreamWriter
+instead of keeping them in memory. The writer must be opened with IOM_VERTNORMAL to store the normals.
+\code
+  io::PlyStreamWriter out;
+  out.Open("samples.ply",io::Mask::IOM_VERTNORMAL);
+  io::PlyStreamSampler<MyMesh> ps(out);
+  SurfaceSampling<MyMesh,io::PlyStreamSampler<MyMesh> >::Montecarlo(m,ps,100000000);
+  out.Close();
+\endcode
+*/
+template <class MeshType>
+class PlyStreamSampler
+{
+public:
+  typedef typename MeshType::CoordType  CoordType;
+  typedef typename MeshType::VertexType VertexType;
+  typedef typename MeshType::FaceType   FaceType;
+
+  PlyStreamSampler(PlyStreamWriter &_out):out(&_out) {}
+
+  void AddVert(const VertexType &p)
+  {
+    out->PushVertex(p.cP(),p.cN());
+  }
+  void AddFace(const FaceType &f, const CoordType &p)
+  {
+    out->PushVertex(f.cP(0)*p[0] + f.cP(1)*p[1] +f.cP(2)*p[2], f.cN());
+  }
+  void AddTextureSample(const FaceType &, const CoordType &, const Point2i &, float )
+  {
+  }
+
+protected:
+  PlyStreamWriter *out;
+};
+
+} // end namespace io
+} // end namespace tri
+} // end namespace vcg
+#endif
@@ -33,11 +33,13 @@
 #include <wrap/gl/glu_tesselator.h>
 #endif
 #include <vcg/space/color4.h>
+#include <wrap/io_trimesh/ascii_parser.h>
 
 
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 
 namespace vcg {
@@ -71,6 +73,7 @@ namespace vcg {
 						mask	= 0;
 						cb		= 0;
 						numTexCoords=0;
+						chunkedParsing=false;
 					}
 
 					/// It returns a bit mask describing the field preesnt in the ply file
@@ -90,6 +93,11 @@ namespace vcg {
 					/// number of normals
 					int numNormals;
 
+					/// if true Open reads the whole file in memory and parses it in parallel
+					/// (see OpenChunked); the mask is computed from the parsed data, so it does
+					/// not need a previous LoadMask call.
+					bool chunkedParsing;
+
 				}; // end class
 
 
@@ -217,6 +225,9 @@ namespace vcg {
 				*/
 				static int Open( OpenMeshType &m, const char * filename, Info &oi)
 				{
+					if (oi.chunkedParsing)
+						return OpenChunked(m, filename, oi);
+
 					int result = E_NOERROR;
 
 					m.Clear();
@@ -452,6 +463,7 @@ namespace vcg {
 											locInd[iii]=indexTriangulatedVect[pi+iii];
 											ff.v[iii]=indexVVect[ locInd[iii] ];
 											ff.t[iii]=indexTVect[ locInd[iii] ];
+											ff.n[iii]=indexNVect[ locInd[iii] ];
 										}
 
 										// Setting internal edges: only edges formed by consecutive edges are external.
@@ -631,6 +643,491 @@ namespace vcg {
 				} // end of Open
 
 
+				// A mtllib or usemtl line, with the number of vertices and polygons of the chunk before it
+				struct ObjMtlEvent
+				{
+					bool lib;
+					std::string name;
+					int vertNum;
+					int polyNum;
+				};
+
+				// The material in use: its index, the texture index and the color given to the faces
+				struct ObjMtlState
+				{
+					int idx;
+					int tInd;
+					Color4b color;
+				};
+
+				// What is read from a piece of the file by OpenChunked.
+				// The indices of the polygon corners are 0 based; the ones that were negative in the
+				// file are relative to the vertices (texcoords, normals) of the chunk (they can
+				// be negative, referring to the previous chunks): their positions are in relV (relT, relN)
+				// and they become absolute adding the number of vertices of the previous chunks.
+				struct ObjChunk
+				{
+					ObjChunk():mrgbLineNum(0),error(E_NOERROR),vertColorLine(false),useMtlLine(false) {}
+					std::vector<CoordType> vert;
+					std::vector<Color4b> vertColor;
+					std::vector<unsigned char> vertHasColor;
+					std::vector<ObjTexCoord> tex;
+					std::vector<CoordType> norm;
+					std::vector<int> polyStart; // corners of polygon i: [polyStart[i],polyStart[i+1])
+					std::vector<int> cornerV, cornerT, cornerN;
+					std::vector<int> relV, relT, relN;
+					std::vector<Color4b> mrgb;  // ZBrush vertex colors in the comments
+					int mrgbLineNum;
+					std::vector<ObjMtlEvent> events;
+					int error;
+					bool vertColorLine, useMtlLine;
+
+					// the faces of the mesh made with the polygons (after the fan triangulation of a trimesh)
+					std::vector<int> faceStart;  // corners of face i: faceCorner[faceStart[i]..faceStart[i+1])
+					std::vector<int> faceCorner;
+					std::vector<unsigned char> faceFaux; // bit j: edge j is internal to the polygon
+					std::vector<int> facePoly;
+				};
+
+				static int ChunkNumbers(const char *&q, const char *le, double *val, int maxNum)
+				{
+					int n=0;
+					for(;;)
+					{
+						q = AsciiParser::SkipBlanks(q,le);
+						if(q==le || *q=='\n' || n==maxNum) return n;
+						if(!AsciiParser::ParseDouble(q,le,val[n])) return n;
+						++n;
+						q = AsciiParser::SkipToken(q,le);
+					}
+				}
+
+				static void ChunkIndex(int raw, int localNum, std::vector<int> &corner, std::vector<int> &rel)
+				{
+					if(raw<0)
+					{
+						rel.push_back(int(corner.size()));
+						corner.push_back(localNum+raw);
+					}
+					else corner.push_back(raw-1); // 0 is not a valid index and becomes -1
+				}
+
+				// Parse the lines in [p,end) in the same way Open does
+				static void ParseChunk(const char *p, const char *end, ObjChunk &c)
+				{
+					c.polyStart.push_back(0);
+					double val[8];
+					while(p<end && c.error==E_NOERROR)
+					{
+						const char *le = AsciiParser::NextLine(p,end);
+						size_t len = le-p;
+						if(len>0 && p[len-1]=='\n') --len;
+						if(*p=='#')
+						{
+							// ZBrush Vertex Color (Polypaint) as in TokenizeNextLine
+							if(len>=5 && p[1]=='M' && p[2]=='R' && p[3]=='G' && p[4]=='B')
+							{
+								c.mrgbLineNum++;
+								for(size_t i=6;(i+7)<len;i+=8)
+								{
+									Color4b cc(Color4b::Black);
+									for(size_t j=1;j<4;j++)
+									{
+										char buf[3] = { p[i+j*2+0], p[i+j*2+1], 0 };
+										char *e;
+										cc[j-1] = (unsigned char)strtoul(buf,&e,16);
+									}
+									c.mrgb.push_back(cc);
+								}
+							}
+							p = le;
+							continue;
+						}
+						const char *q = AsciiParser::SkipBlanks(p,le);
+						const char *te = AsciiParser::SkipToken(q,le);
+						const std::string header(q,te);
+						q = te;
+						if(header=="v")
+						{
+							const int n = ChunkNumbers(q,le,val,7);
+							if(n<3) { c.error = E_BAD_VERTEX_STATEMENT; break; }
+							c.vert.push_back(CoordType(ScalarType(val[0]),ScalarType(val[1]),ScalarType(val[2])));
+							if(len>=7) c.vertColorLine = true;
+							if(n>=6)
+							{
+								ScalarType rf(val[3]), gf(val[4]), bf(val[5]);
+								ScalarType scaling = (rf<=1 && gf<=1 && bf<=1) ? 255. : 1;
+								const ScalarType af = (n>=7) ? ScalarType(val[6]) : ScalarType(1);
+								c.vertColor.push_back(Color4b((unsigned char)(rf*scaling),(unsigned char)(gf*scaling),
+								                              (unsigned char)(bf*scaling),(unsigned char)(af*scaling)));
+								c.vertHasColor.push_back(1);
+							}
+							else
+							{
+								c.vertColor.push_back(Color4b());
+								c.vertHasColor.push_back(0);
+							}
+						}
+						else if(header=="vt")
+						{
+							if(ChunkNumbers(q,le,val,2)<2) { c.error = E_BAD_VERT_TEX_STATEMENT; break; }
+							ObjTexCoord t;
+							t.u = static_cast<float>(val[0]);
+							t.v = static_cast<float>(val[1]);
+							c.tex.push_back(t);
+						}
+						else if(header=="vn")
+						{
+							if(ChunkNumbers(q,le,val,4)!=3) { c.error = E_BAD_VERT_NORMAL_STATEMENT; break; }
+							c.norm.push_back(CoordType(ScalarType(val[0]),ScalarType(val[1]),ScalarType(val[2])));
+						}
+						else if(header=="f" || header=="q")
+						{
+							const bool quadFlag = (header=="q"); // QOBJ indices are zero based
+							int n=0;
+							for(;;)
+							{
+								q = AsciiParser::SkipBlanks(q,le);
+								if(q==le || *q=='\n') break;
+								int vi=0, ti=1, ni=1; // a missing texcoord or normal index is 0, as in SplitToken
+								AsciiParser::ParseInt(q,le,vi);
+								if(q<le && *q=='/')
+								{
+									++q;
+									if(q<le && *q!='/') AsciiParser::ParseInt(q,le,ti);
+									if(q<le && *q=='/') { ++q; AsciiParser::ParseInt(q,le,ni); }
+								}
+								q = AsciiParser::SkipToken(q,le);
+								if(quadFlag) ChunkIndex(vi+1,int(c.vert.size()),c.cornerV,c.relV);
+								else ChunkIndex(vi,int(c.vert.size()),c.cornerV,c.relV);
+								ChunkIndex(ti,int(c.tex.size()),c.cornerT,c.relT);
+								ChunkIndex(ni,int(c.norm.size()),c.cornerN,c.relN);
+								++n;
+							}
+							if(n<3) { c.error = E_LESS_THAN_3VERTINFACE; break; }
+							c.polyStart.push_back(int(c.cornerV.size()));
+						}
+						else if(header=="mtllib" || header=="usemtl")
+						{
+							q = AsciiParser::SkipBlanks(q,le);
+							ObjMtlEvent e;
+							e.lib = (header=="mtllib");
+							e.name.assign(q,AsciiParser::SkipToken(q,le));
+							e.vertNum = int(c.vert.size());
+							e.polyNum = int(c.polyStart.size())-1;
+							c.events.push_back(e);
+							if(!e.lib) c.useMtlLine = true;
+						}
+						p = le;
+					}
+				}
+
+				// Build the faces of the chunk polygons checking the indices (after the chunk offsets
+				// have been added) as Open does: a trimesh skips the triangles with bad indices,
+				// for a polygonal mesh they are an error.
+				static int BuildChunkFaces(ObjChunk &c, const Info &oi, int vn, int tn, int nn, int &result)
+				{
+					const bool polyMesh = OpenMeshType::FaceType::HasPolyInfo();
+					const bool checkT = (oi.mask & (Mask::IOM_WEDGTEXCOORD|Mask::IOM_VERTTEXCOORD))!=0;
+					const bool checkN = (oi.mask & (Mask::IOM_WEDGNORMAL|Mask::IOM_VERTNORMAL))!=0;
+					const int polyNum = int(c.polyStart.size())-1;
+					c.faceStart.assign(1,0);
+					for(int pi=0;pi<polyNum;++pi)
+					{
+						const int s = c.polyStart[pi];
+						const int n = c.polyStart[pi+1]-s;
+						if(polyMesh && n>3)
+						{
+							std::vector<int> tmp(c.cornerV.begin()+s,c.cornerV.begin()+s+n);
+							std::sort(tmp.begin(),tmp.end());
+							if(std::unique(tmp.begin(),tmp.end())!=tmp.end())
+								result = E_VERTICES_WITH_SAME_IDX_IN_FACE;
+							for(int i=s;i<s+n;++i)
+							{
+								if(c.cornerV[i]<0 || c.cornerV[i]>=vn) return E_BAD_VERT_INDEX;
+								if(checkT && (c.cornerT[i]<0 || c.cornerT[i]>=tn)) return E_BAD_VERT_TEX_INDEX;
+								if(checkN && (c.cornerN[i]<0 || c.cornerN[i]>=nn)) return E_BAD_VERT_NORMAL_INDEX;
+								c.faceCorner.push_back(i);
+							}
+							c.faceFaux.push_back(0);
+							c.facePoly.push_back(pi);
+							c.faceStart.push_back(int(c.faceCorner.size()));
+							continue;
+						}
+						// fan triangulation, as InternalFanTessellator
+						for(int t=0;t<n-2;++t)
+						{
+							const int loc[3] = { 0, t+1, t+2 };
+							bool valid = true;
+							unsigned char faux = 0;
+							for(int j=0;j<3;++j)
+							{
+								const int i = s+loc[j];
+								if(c.cornerV[i]<0 || c.cornerV[i]>=vn) valid = false;
+								if(checkT && (c.cornerT[i]<0 || c.cornerT[i]>=tn)) valid = false;
+								if(checkN && (c.cornerN[i]<0 || c.cornerN[i]>=nn)) valid = false;
+								if( (loc[j]+1)%n != loc[(j+1)%3]) faux |= (1<<j);
+							}
+							if(!valid) continue;
+							if(c.cornerV[s+loc[0]]==c.cornerV[s+loc[1]] || c.cornerV[s+loc[0]]==c.cornerV[s+loc[2]] || c.cornerV[s+loc[1]]==c.cornerV[s+loc[2]])
+								result = E_VERTICES_WITH_SAME_IDX_IN_FACE;
+							for(int j=0;j<3;++j) c.faceCorner.push_back(s+loc[j]);
+							c.faceFaux.push_back(faux);
+							c.facePoly.push_back(pi);
+							c.faceStart.push_back(int(c.faceCorner.size()));
+						}
+					}
+					return E_NOERROR;
+				}
+
+				/*!
+				* Same as Open, but the whole file is read in memory and split in chunks ending at a newline
+				* (a few MB each) that are parsed in parallel with a locale independent number parser;
+				* then the chunks are merged: the negative (relative) indices become absolute adding the
+				* number of vertices, texcoords and normals of the previous chunks, the mtllib and usemtl
+				* lines are replayed in file order, and the faces are built and copied in parallel.
+				* The differences with Open: the polygons of a trimesh are always triangulated with a fan
+				* (Open can use the glu tessellator), positive indices are checked against the total
+				* number of elements of the file, and the memory used for the file is freed only at the end.
+				*/
+				static int OpenChunked( OpenMeshType &m, const char * filename, Info &oi)
+				{
+					int result = E_NOERROR;
+					m.Clear();
+					CallBackPos *cb = oi.cb;
+
+					std::vector<char> buf;
+					if (!AsciiParser::ReadFile(filename, buf))
+						return E_CANTOPEN;
+					if ((cb !=NULL) && !(*cb)(10, "Parsing"))
+						return E_ABORTED;
+
+					const int ChunkSize = 1<<22;
+					std::vector<const char *> bounds;
+					const char *data = buf.empty() ? 0 : &buf[0];
+					AsciiParser::SplitLines(data, data+buf.size(), int(buf.size()/ChunkSize)+1, bounds);
+					const int chunkNum = int(bounds.size())-1;
+					std::vector<ObjChunk> chunks(chunkNum);
+#pragma omp parallel for schedule(dynamic,1)
+					for(int i=0;i<chunkNum;++i)
+						ParseChunk(bounds[i], bounds[i+1], chunks[i]);
+					std::vector<char>().swap(buf);
+
+					// offsets of the chunks and mask
+					std::vector<int> vertOff(chunkNum+1,0), texOff(chunkNum+1,0), normOff(chunkNum+1,0);
+					bool bHasPerFaceColor = false, bHasPerVertexColor = false;
+					int polyNum = 0;
+					for(int i=0;i<chunkNum;++i)
+					{
+						if(chunks[i].error!=E_NOERROR) return chunks[i].error;
+						vertOff[i+1] = vertOff[i]+int(chunks[i].vert.size());
+						texOff[i+1]  = texOff[i] +int(chunks[i].tex.size());
+						normOff[i+1] = normOff[i]+int(chunks[i].norm.size());
+						polyNum += int(chunks[i].polyStart.size())-1;
+						bHasPerFaceColor   |= chunks[i].useMtlLine;
+						bHasPerVertexColor |= chunks[i].vertColorLine;
+					}
+					oi.numVertices  = vertOff[chunkNum];
+					oi.numTexCoords = texOff[chunkNum];
+					oi.numNormals   = normOff[chunkNum];
+					oi.numFaces     = polyNum;
+					// the mask is computed here unless LoadMask has filled it (a default Info has mask 0)
+					if (oi.mask == -1 || oi.mask == 0)
+						ComputeMask(oi, bHasPerFaceColor, oi.numNormals>0, bHasPerVertexColor);
+					Mask::ClampMask<OpenMeshType>(m,oi.mask);
+					if (oi.numVertices == 0)
+						return E_NO_VERTEX;
+					if ((cb !=NULL) && !(*cb)(50, "Merging"))
+						return E_ABORTED;
+
+					// the materials, in file order
+					std::vector<Material> materials(1);
+					std::vector<ObjMtlState> chunkMtl(chunkNum);
+					std::vector<std::vector<ObjMtlState> > eventMtl(chunkNum);
+					ObjMtlState cur;
+					cur.idx = 0;
+					cur.tInd = materials[0].index;
+					cur.color = Color4b::LightGray;
+					for(int i=0;i<chunkNum;++i)
+					{
+						chunkMtl[i] = cur;
+						for(size_t e=0;e<chunks[i].events.size();++e)
+						{
+							const ObjMtlEvent &ev = chunks[i].events[e];
+							if(ev.lib)
+							{
+								if (!LoadMaterials(ev.name.c_str(), materials, m.textures))
+									result = E_MATERIAL_FILE_NOT_FOUND;
+							}
+							else
+							{
+								size_t k=0;
+								while(k<materials.size() && materials[k].materialName!=ev.name) ++k;
+								if(k<materials.size())
+								{
+									const Material &material = materials[k];
+									cur.idx = int(k);
+									cur.color = Color4b((unsigned char) (material.Kd[0] * 255.0), (unsigned char) (material.Kd[1] * 255.0),
+									                    (unsigned char) (material.Kd[2] * 255.0), (unsigned char) (material.Tr * 255.0));
+								}
+								else
+								{
+									cur.idx = 0;
+									result = E_MATERIAL_NOT_FOUND;
+								}
+							}
+							cur.tInd = (size_t(cur.idx)<materials.size()) ? materials[cur.idx].index : 0;
+							eventMtl[i].push_back(cur);
+						}
+					}
+
+					// absolute indices and faces
+					std::vector<int> chunkErr(chunkNum);
+#pragma omp parallel for schedule(dynamic,1)
+					for(int i=0;i<chunkNum;++i)
+					{
+						ObjChunk &c = chunks[i];
+						for(size_t k=0;k<c.relV.size();++k) c.cornerV[c.relV[k]] += vertOff[i];
+						for(size_t k=0;k<c.relT.size();++k) c.cornerT[c.relT[k]] += texOff[i];
+						for(size_t k=0;k<c.relN.size();++k) c.cornerN[c.relN[k]] += normOff[i];
+						int chunkResult = E_NOERROR;
+						chunkErr[i] = BuildChunkFaces(c, oi, oi.numVertices, oi.numTexCoords, oi.numNormals, chunkResult);
+						if(chunkResult!=E_NOERROR)
+						{
+#pragma omp critical (ObjChunkResult)
+							result = chunkResult;
+						}
+					}
+
+					std::vector<int> faceOff(chunkNum+1,0);
+					for(int i=0;i<chunkNum;++i)
+					{
+						if(chunkErr[i]!=E_NOERROR) return chunkErr[i];
+						faceOff[i+1] = faceOff[i]+int(chunks[i].faceStart.size())-1;
+						MRGBLineCount() += chunks[i].mrgbLineNum;
+						if(!OpenMeshType::FaceType::HasPolyInfo())
+							for(size_t p=0;p+1<chunks[i].polyStart.size();++p)
+								if(chunks[i].polyStart[p+1]-chunks[i].polyStart[p]>3)
+									oi.mask |= Mask::IOM_BITPOLYGONAL;
+					}
+
+					vcg::tri::Allocator<OpenMeshType>::AddVertices(m,oi.numVertices);
+					vcg::tri::Allocator<OpenMeshType>::AddFaces(m,faceOff[chunkNum]);
+					const bool vertColor = ((oi.mask & Mask::IOM_VERTCOLOR) != 0) && HasPerVertexColor(m);
+					const bool wedgeTex  = ((oi.mask & Mask::IOM_WEDGTEXCOORD) != 0) && HasPerWedgeTexCoord(m);
+					const bool wedgeNorm = (oi.mask & Mask::IOM_WEDGNORMAL) != 0;
+					const bool faceColor = ((oi.mask & Mask::IOM_FACECOLOR) != 0) && HasPerFaceColor(m);
+#pragma omp parallel for schedule(dynamic,1)
+					for(int i=0;i<chunkNum;++i)
+					{
+						const ObjChunk &c = chunks[i];
+						size_t e = 0;
+						ObjMtlState mtl = chunkMtl[i];
+						for(size_t k=0;k<c.vert.size();++k)
+						{
+							VertexType &v = m.vert[vertOff[i]+k];
+							v.P() = c.vert[k];
+							if(!vertColor) continue;
+							while(e<c.events.size() && c.events[e].vertNum<=int(k)) mtl = eventMtl[i][e++];
+							v.C() = c.vertHasColor[k] ? c.vertColor[k] : mtl.color;
+						}
+					}
+					// the faces only after all the vertices: a face can refer to the vertices of any chunk
+#pragma omp parallel for schedule(dynamic,1)
+					for(int i=0;i<chunkNum;++i)
+					{
+						const ObjChunk &c = chunks[i];
+						size_t e = 0;
+						ObjMtlState mtl = chunkMtl[i];
+						for(size_t f=0;f+1<c.faceStart.size();++f)
+						{
+							while(e<c.events.size() && c.events[e].polyNum<=c.facePoly[f]) mtl = eventMtl[i][e++];
+							FaceType &face = m.face[faceOff[i]+f];
+							const int n = c.faceStart[f+1]-c.faceStart[f];
+							face.Alloc(n); // it does not do anything if it is a trimesh
+							for(int j=0;j<n;++j)
+							{
+								const int ci = c.faceCorner[c.faceStart[f]+j];
+								face.V(j) = &m.vert[c.cornerV[ci]];
+								if (wedgeTex)
+								{
+									const ObjTexCoord &t = TexCoordOf(chunks,texOff,c.cornerT[ci]);
+									face.WT(j).u() = t.u;
+									face.WT(j).v() = t.v;
+									face.WT(j).n() = mtl.tInd;
+								}
+								if (wedgeNorm)
+									face.WN(j).Import(NormalOf(chunks,normOff,c.cornerN[ci]));
+								if (c.faceFaux[f] & (1<<j)) face.SetF(j);
+								else face.ClearF(j);
+							}
+							if (HasPerFaceNormal(m))
+							{
+								if (faceColor)
+									face.C() = mtl.color;
+								if (wedgeNorm && HasPerWedgeNormal(m))
+									face.N().Import(face.WN(0)+face.WN(1)+face.WN(2));
+								else
+									face::ComputeNormalizedNormal(face);
+							}
+						}
+					}
+
+					// the per vertex texcoords and normals are given by the faces: the last one wins, as in Open
+					const bool vertTex  = ((oi.mask & Mask::IOM_VERTTEXCOORD) != 0) && HasPerVertexTexCoord(m);
+					const bool vertNorm = ((oi.mask & Mask::IOM_VERTNORMAL) != 0) && HasPerVertexNormal(m);
+					if (vertTex || vertNorm)
+						for(int i=0;i<chunkNum;++i)
+						{
+							const ObjChunk &c = chunks[i];
+							size_t e = 0;
+							ObjMtlState mtl = chunkMtl[i];
+							for(size_t f=0;f+1<c.faceStart.size();++f)
+							{
+								while(e<c.events.size() && c.events[e].polyNum<=c.facePoly[f]) mtl = eventMtl[i][e++];
+								for(int j=c.faceStart[f];j<c.faceStart[f+1];++j)
+								{
+									const int ci = c.faceCorner[j];
+									VertexType &v = m.vert[c.cornerV[ci]];
+									if (vertTex)
+									{
+										const ObjTexCoord &t = TexCoordOf(chunks,texOff,c.cornerT[ci]);
+										v.T().u() = t.u;
+										v.T().v() = t.v;
+										v.T().n() = mtl.tInd;
+									}
+									if (vertNorm)
+										v.N().Import(NormalOf(chunks,normOff,c.cornerN[ci]));
+								}
+							}
+						}
+
+					// the ZBrush PerVertex Color that are managed into comments
+					if (HasPerVertexColor(m))
+					{
+						int k = 0;
+						for(int i=0;i<chunkNum;++i)
+							for(size_t j=0;j<chunks[i].mrgb.size() && k<m.vn;++j)
+								m.vert[k++].C() = chunks[i].mrgb[j];
+					}
+					if ((cb !=NULL) && !(*cb)(100, "Done"))
+						return E_ABORTED;
+					return result;
+				} // end of OpenChunked
+
+				// The i-th texcoord (normal) of the file, stored in the chunk that has read it
+				static const ObjTexCoord &TexCoordOf(const std::vector<ObjChunk> &chunks, const std::vector<int> &off, int i)
+				{
+					const int c = int(std::upper_bound(off.begin(),off.end(),i)-off.begin())-1;
+					return chunks[c].tex[i-off[c]];
+				}
+				static const CoordType &NormalOf(const std::vector<ObjChunk> &chunks, const std::vector<int> &off, int i)
+				{
+					const int c = int(std::upper_bound(off.begin(),off.end(),i)-off.begin())-1;
+					return chunks[c].norm[i-off[c]];
+				}
+
+
 				/*!
 				* Read the next valid line and parses it into "tokens", allowing
 				*	the tokens to be read one at a time.
@@ -909,6 +1406,13 @@ namespace vcg {
 							}
 						}
 					}
+					ComputeMask(oi, bHasPerFaceColor, bHasNormals, bHasPerVertexColor);
+					return true;
+				}
+
+				// The mask deduced from the counts in oi and from what has been found in the file
+				static void ComputeMask(Info &oi, bool bHasPerFaceColor, bool bHasNormals, bool bHasPerVertexColor)
+				{
 					oi.mask = 0;
 					if (oi.numTexCoords)
 					{
@@ -927,8 +1431,6 @@ namespace vcg {
 						else
 							oi.mask |= vcg::tri::io::Mask::IOM_WEDGNORMAL;
 					}
-
-					return true;
 				}
 
 				static bool LoadMask(const char * filename, int &mask)
@@ -328,6 +328,128 @@ static bool ErrorCritical(int err)
 }
 	
 
+// Offset of a component inside the element, -1 if it is not stored inside it (e.g. optional or soa components)
+template <class ElemType, class CompType>
+static int InnerOffset(const ElemType &e, const CompType &c)
+{
+  const ptrdiff_t d = (const char *)&c - (const char *)&e;
+  return (d>=0 && size_t(d)+sizeof(CompType)<=sizeof(ElemType)) ? int(d) : -1;
+}
+
+template <class CompType>
+static int PlyTypeOf(const CompType &) { return PlyType<CompType>(); }
+
+// Descriptor that stores a property of the file straight into a component of the element
+template <class ElemType, class CompType>
+static bool InnerDesc(const ply::PlyProperty &p, const ElemType &e, const CompType &c, PropDescriptor &d)
+{
+  d = p.desc;
+  d.propname = p.name.c_str();
+  d.offset1 = InnerOffset(e,c);
+  d.memtype1 = PlyTypeOf(c);
+  return d.offset1!=size_t(-1) && d.memtype1!=0;
+}
+
+/// Fast path for the vertices of the memory mapped files (binary or ascii):
+/// the properties are converted straight into the vertex vector, without the LoadPly_VertAux copy.
+/// Returns false (and nothing is read) for the layouts it does not manage: lists,
+/// intensity, texture coords, radius, user data, components not stored in the vertex.
+static bool ReadVertexBlock(ply::PlyFile &pf, int elem, VertexIterator vi, int n, PlyInfo &pi, bool hasIntensity)
+{
+  const ply::PlyElement &el = pf.elements[elem];
+  if(!pf.IsMapped() || n==0 || el.RecordSize()<0 || hasIntensity || pi.vdn>0) return false;
+  typedef LoadPly_VertAux<ScalarType> VA;
+  VertexType &v = *vi;
+  bool color = false;
+  std::vector<PropDescriptor> desc;
+  for(size_t k=0;k<el.props.size();++k)
+  {
+    const ply::PlyProperty &p = el.props[k];
+    if(!p.bestored) continue;
+    const size_t o = p.desc.offset1;
+    PropDescriptor d;
+    bool ok;
+    if(o>=offsetof(VA,p) && o<offsetof(VA,p)+3*sizeof(ScalarType))
+      ok = InnerDesc(p,v,v.P()[(o-offsetof(VA,p))/sizeof(ScalarType)],d);
+    else if(o>=offsetof(VA,n) && o<offsetof(VA,n)+3*sizeof(ScalarType))
+      ok = InnerDesc(p,v,v.N()[(o-offsetof(VA,n))/sizeof(ScalarType)],d);
+    else if(o==offsetof(VA,flags)) ok = InnerDesc(p,v,v.Flags(),d);
+    else if(o==offsetof(VA,q))     ok = InnerDesc(p,v,v.Q(),d);
+    else if(o==offsetof(VA,r))   { ok = InnerDesc(p,v,v.C()[0],d); color=true; }
+    else if(o==offsetof(VA,g))   { ok = InnerDesc(p,v,v.C()[1],d); color=true; }
+    else if(o==offsetof(VA,b))   { ok = InnerDesc(p,v,v.C()[2],d); color=true; }
+    else ok = false;
+    if(!ok) return false;
+    desc.push_back(d);
+  }
+  if(pf.ReadBlock(desc,&v,sizeof(VertexType))==-1) return false;
+  if(color)
+    for(int j=0;j<n;++j)
+      (vi+j)->C()[3] = 255;
+  return true;
+}
+
+/// Fast path for the triangles of the memory mapped files (binary or ascii): the vertex indices
+/// and the other properties are converted with a loop for each property.
+/// Returns -1 (and nothing is read) if it cannot be used (a face that is not a triangle,
+/// lists other than the vertex indices, per wedge attributes, user data), otherwise the error code.
+static int ReadFaceBlock(ply::PlyFile &pf, int elem, OpenMeshType &m, FaceIterator fi, int n, PlyInfo &pi, const std::vector<VertexPointer> &index)
+{
+  const ply::PlyElement &el = pf.elements[elem];
+  if(!pf.IsMapped() || n==0 || pi.fdn>0 || HasPolyInfo(m) ||
+     (pi.mask & (Mask::IOM_WEDGTEXCOORD|Mask::IOM_WEDGCOLOR)) ) return -1;
+  FaceType &f = *fi;
+  std::vector<int> vid(3*size_t(n));
+  std::vector<ply::PlyFile::BlockDest> dest;
+  bool color = false, indices = false;
+  for(size_t k=0;k<el.props.size();++k)
+  {
+    const ply::PlyProperty &p = el.props[k];
+    if(!p.bestored) continue;
+    const size_t o = p.desc.offset1;
+    PropDescriptor d;
+    bool ok;
+    if(p.islist)
+    {
+      if(o!=offsetof(LoadPly_FaceAux,v)) return -1;
+      ply::PlyFile::BlockDest bd = { p.name.c_str(), ply::T_INT, &vid[0], 3*sizeof(int) };
+      dest.push_back(bd);
+      indices = true;
+      continue;
+    }
+    if(o==offsetof(LoadPly_FaceAux,flags))
+    {
+      if(!HasPerFaceFlags(m)) continue; // always in the file, even when the mesh does not have them
+      ok = InnerDesc(p,f,f.Flags(),d);
+    }
+    else if(o==offsetof(LoadPly_FaceAux,q))  ok = InnerDesc(p,f,f.Q(),d);
+    else if(o==offsetof(LoadPly_FaceAux,r)) { ok = InnerDesc(p,f,f.C()[0],d); color=true; }
+    else if(o==offsetof(LoadPly_FaceAux,g)) { ok = InnerDesc(p,f,f.C()[1],d); color=true; }
+    else if(o==offsetof(LoadPly_FaceAux,b)) { ok = InnerDesc(p,f,f.C()[2],d); color=true; }
+    else ok = false;
+    if(!ok) return -1;
+    ply::PlyFile::BlockDest bd = { p.name.c_str(), d.memtype1, (char *)&f+d.offset1, sizeof(FaceType) };
+    dest.push_back(bd);
+  }
+  // it succeeds only if all the faces are triangles
+  if(!indices || pf.ReadBlock(dest,3)==-1) return -1;
+
+  int badNum = 0;
+#pragma omp parallel for schedule(static) reduction(+:badNum)
+  for(int j=0;j<n;++j)
+    for(int k=0;k<3;++k)
+    {
+      const int id = vid[3*size_t(j)+k];
+      if(id<0 || id>=m.vn) ++badNum;
+      else (fi+j)->V(k) = index[id];
+    }
+  if(badNum>0) return PlyInfo::E_BAD_VERT_INDEX;
+  if(color)
+    for(int j=0;j<n;++j)
+      (fi+j)->C()[3] = 255;
+  return ply::E_NOERROR;
+}
+
 /// Standard call for reading a mesh, returns 0 on success.
 static int Open( OpenMeshType &m, const char * filename, CallBackPos *cb=0)
 {
@@ -637,6 +759,7 @@ static int Open( OpenMeshType &m, const char * filename, PlyInfo &pi )
 			pf.SetCurElement(i);
       VertexIterator vi=Allocator<OpenMeshType>::AddVertices(m,n);
 			
+      if(!ReadVertexBlock(pf,i,vi,n,pi,hasIntensity))
       for(j=0;j<n;++j)
 			{
 				if(pi.cb && (j%1000)==0) pi.cb(j*50/n,"Vertex Loading");
@@ -726,6 +849,13 @@ static int Open( OpenMeshType &m, const char * filename, PlyInfo &pi )
       FaceIterator fi=Allocator<OpenMeshType>::AddFaces(m,n);
 			pf.SetCurElement(i);
 
+			const int blockStatus = ReadFaceBlock(pf,i,m,fi,n,pi,index);
+			if(blockStatus>0)
+			{
+				pi.status = blockStatus;
+				return pi.status;
+			}
+			if(blockStatus<0)
 			for(j=0;j<n;++j)
 			{
 				int k;
@@ -47,6 +47,16 @@ of Greg Turk and on the work of Claudio Rocchini
 
 #ifdef WIN32
 #include <direct.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 #include <fcntl.h>
@@ -63,6 +73,7 @@ of Greg Turk and on the work of Claudio Rocchini
 #include <algorithm>
 
 #include "plylib.h"
+#include <wrap/io_trimesh/ascii_parser.h>
 using namespace std;
 namespace vcg{
   namespace ply{
@@ -84,6 +95,13 @@ typedef unsigned int uint;
 #define pb_fopen  fopen
 #define pb_fgets(s,n,f)  fgets(s,n,f)
 #define pb_fread(b,s,n,f) fread(b,s,n,f)
+#ifdef _MSC_VER
+#define pb_ftell64 _ftelli64
+#define pb_fseek64 _fseeki64
+#else
+#define pb_ftell64 ftello
+#define pb_fseek64 fseeko
+#endif
 //#endif
 
 //#ifdef WIN32
@@ -877,6 +895,40 @@ PlyProperty * PlyElement::FindProp( const char * na )
 	return 0;
 }
 
+int PlyElement::RecordSize( int listSize ) const
+{
+	int sz = 0;
+	vector<PlyProperty>::const_iterator i;
+	for(i=props.begin();i!=props.end();++i)
+	{
+		if(i->islist)
+		{
+			if(listSize<0) return -1;
+			sz += TypeSize[i->tipoindex] + listSize*TypeSize[i->tipo];
+		}
+		else sz += TypeSize[i->tipo];
+	}
+	return sz;
+}
+
+int PlyElement::PropOffset( const char * na, int listSize ) const
+{
+	assert(na);
+	int off = 0;
+	vector<PlyProperty>::const_iterator i;
+	for(i=props.begin();i!=props.end();++i)
+	{
+		if( i->name == na ) return off;
+		if(i->islist)
+		{
+			if(listSize<0) return -1;
+			off += TypeSize[i->tipoindex] + listSize*TypeSize[i->tipo];
+		}
+		else off += TypeSize[i->tipo];
+	}
+	return -1;
+}
+
 int PlyElement::AddToRead(
 		const char * propname,
 		int	stotype1,
@@ -948,6 +1000,9 @@ PlyFile::PlyFile( void )
 	format		= F_UNSPECIFIED;
 	cure		= 0;
 	ReadCB		= 0;
+	mapData		= 0;
+	mapSize		= 0;
+	mapHandle	= 0;
 	InitSBuffer();
 }
 
@@ -971,6 +1026,7 @@ int PlyFile::Open( const char * filename, int mode )
 
 void PlyFile::Destroy( void )
 {
+	UnmapFile();
 	if(gzfp!=0)
 	{
 		pb_fclose(gzfp);
@@ -1254,6 +1310,13 @@ int PlyFile::OpenRead( const char * filename )
 	else
 		ReadCB = ReadBin;
 
+#ifdef LITTLE_MACHINE
+	if(format==F_BINLITTLE)
+		MapFile(filename);
+#endif
+	if(format==F_ASCII)
+		MapFile(filename);
+
 	return 0;
 
 error:
@@ -3631,6 +3694,285 @@ int PlyFile::Read( void * mem )
 	return 0;
 }
 
+// ******************************************************
+	// Lettura veloce dei file binary little endian mappati in memoria
+	// ******************************************************
+
+void PlyFile::MapFile( const char * filename )
+{
+#ifndef USE_ZLIB
+#ifdef WIN32
+	HANDLE fh = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+	if(fh==INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER fs;
+	HANDLE mh = 0;
+	if(GetFileSizeEx(fh,&fs) && fs.QuadPart>0)
+		mh = CreateFileMappingA(fh,0,PAGE_READONLY,0,0,0);
+	CloseHandle(fh);
+	if(mh==0) return;
+	mapData = (const char *)MapViewOfFile(mh,FILE_MAP_READ,0,0,0);
+	if(mapData==0) { CloseHandle(mh); return; }
+	mapSize = size_t(fs.QuadPart);
+	mapHandle = mh;
+#else
+	int fd = open(filename,O_RDONLY);
+	if(fd<0) return;
+	struct stat st;
+	if(fstat(fd,&st)==0 && st.st_size>0)
+	{
+		void * p = mmap(0,size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+		if(p!=MAP_FAILED)
+		{
+			mapData = (const char *)p;
+			mapSize = size_t(st.st_size);
+			madvise(p,mapSize,MADV_SEQUENTIAL);
+		}
+	}
+	close(fd);
+#endif
+#endif
+}
+
+void PlyFile::UnmapFile()
+{
+	if(mapData==0) return;
+#ifdef WIN32
+	UnmapViewOfFile(mapData);
+	CloseHandle((HANDLE)mapHandle);
+#else
+	munmap((void *)mapData,mapSize);
+#endif
+	mapData = 0;
+	mapSize = 0;
+	mapHandle = 0;
+}
+
+const char * PlyFile::MappedData( size_t & avail )
+{
+	avail = 0;
+	if(mapData==0 || gzfp==0) return 0;
+	long long pos = pb_ftell64(gzfp);
+	if(pos<0 || size_t(pos)>mapSize) return 0;
+	avail = mapSize-size_t(pos);
+	return mapData+pos;
+}
+
+int PlyFile::Skip( size_t bytes )
+{
+	return pb_fseek64(gzfp,bytes,SEEK_CUR)==0 ? 0 : -1;
+}
+
+int PlyFile::TypeSizeOf( int type )
+{
+	assert(type>=0 && type<T_MAXTYPE);
+	return TypeSize[type];
+}
+
+template<class S, class D>
+static void ConvertT( const char * src, size_t ss, char * dst, size_t ds, int n )
+{
+	for(int i=0;i<n;++i)
+	{
+		S v;
+		memcpy(&v,src+i*ss,sizeof(S));
+		const D d = D(v);
+		memcpy(dst+i*ds,&d,sizeof(D));
+	}
+}
+
+template<class S>
+static void ConvertFrom( const char * src, size_t ss, char * dst, size_t ds, int memtype, int n )
+{
+	switch(memtype)
+	{
+		case T_CHAR:   ConvertT<S,char>  (src,ss,dst,ds,n); break;
+		case T_SHORT:  ConvertT<S,short> (src,ss,dst,ds,n); break;
+		case T_INT:    ConvertT<S,int>   (src,ss,dst,ds,n); break;
+		case T_UCHAR:  ConvertT<S,uchar> (src,ss,dst,ds,n); break;
+		case T_USHORT: ConvertT<S,ushort>(src,ss,dst,ds,n); break;
+		case T_UINT:   ConvertT<S,uint>  (src,ss,dst,ds,n); break;
+		case T_FLOAT:  ConvertT<S,float> (src,ss,dst,ds,n); break;
+		case T_DOUBLE: ConvertT<S,double>(src,ss,dst,ds,n); break;
+		default: assert(0);
+	}
+}
+
+void PlyFile::ConvertBlock( const char * src, size_t srcStride, int stotype, void * dst, size_t dstStride, int memtype, int n )
+{
+	char * d = (char *)dst;
+	switch(stotype)
+	{
+		case T_CHAR:   ConvertFrom<char>  (src,srcStride,d,dstStride,memtype,n); break;
+		case T_SHORT:  ConvertFrom<short> (src,srcStride,d,dstStride,memtype,n); break;
+		case T_INT:    ConvertFrom<int>   (src,srcStride,d,dstStride,memtype,n); break;
+		case T_UCHAR:  ConvertFrom<uchar> (src,srcStride,d,dstStride,memtype,n); break;
+		case T_USHORT: ConvertFrom<ushort>(src,srcStride,d,dstStride,memtype,n); break;
+		case T_UINT:   ConvertFrom<uint>  (src,srcStride,d,dstStride,memtype,n); break;
+		case T_FLOAT:  ConvertFrom<float> (src,srcStride,d,dstStride,memtype,n); break;
+		case T_DOUBLE: ConvertFrom<double>(src,srcStride,d,dstStride,memtype,n); break;
+		default: assert(0);
+	}
+}
+
+int PlyFile::ReadBlock( const std::vector<PropDescriptor> & desc, void * mem, size_t stride )
+{
+	vector<BlockDest> dest(desc.size());
+	for(size_t k=0;k<desc.size();++k)
+	{
+		dest[k].propname = desc[k].propname;
+		dest[k].memtype  = desc[k].memtype1;
+		dest[k].base     = (char *)mem+desc[k].offset1;
+		dest[k].stride   = stride;
+	}
+	return ReadBlock(dest);
+}
+
+	// Legge un valore ascii di tipo tf e lo converte in tm (come ReadScalarA)
+static inline bool ParseScalarA( const char * & p, const char * end, int tf, void * mem, int tm )
+{
+	using vcg::tri::io::AsciiParser;
+	p = AsciiParser::SkipBlanks(p,end);
+	const char * q = p;
+	if(tf==T_FLOAT || tf==T_DOUBLE)
+	{
+		double d;
+		if(!AsciiParser::ParseDouble(q,end,d)) return false;
+		if(tf==T_FLOAT) { float f = float(d); PlyFile::ConvertBlock((const char *)&f,0,T_FLOAT,mem,0,tm,1); }
+		else PlyFile::ConvertBlock((const char *)&d,0,T_DOUBLE,mem,0,tm,1);
+	}
+	else
+	{
+		int i;
+		if(!AsciiParser::ParseInt(q,end,i)) return false;
+		char ch = char(i); short sh = short(i); uchar uc = uchar(i); ushort us = ushort(i); uint ui = uint(i);
+		switch(tf)
+		{
+		case T_CHAR:   PlyFile::ConvertBlock((const char *)&ch,0,tf,mem,0,tm,1); break;
+		case T_SHORT:  PlyFile::ConvertBlock((const char *)&sh,0,tf,mem,0,tm,1); break;
+		case T_UCHAR:  PlyFile::ConvertBlock((const char *)&uc,0,tf,mem,0,tm,1); break;
+		case T_USHORT: PlyFile::ConvertBlock((const char *)&us,0,tf,mem,0,tm,1); break;
+		case T_UINT:   PlyFile::ConvertBlock((const char *)&ui,0,tf,mem,0,tm,1); break;
+		default:       PlyFile::ConvertBlock((const char *)&i ,0,T_INT,mem,0,tm,1); break;
+		}
+	}
+		// the value must be followed by a separator
+	if(q<end && !AsciiParser::IsBlank(*q) && *q!='\n') return false;
+	p = q;
+	return true;
+}
+
+int PlyFile::ReadBlock( const std::vector<BlockDest> & dest, int listSize )
+{
+	assert(cure);
+	size_t avail;
+	const char * data = MappedData(avail);
+	if(data==0 || (format!=F_ASCII && cure->RecordSize(listSize)<0))
+	{
+		error = E_BADTYPE;
+		return -1;
+	}
+	const int n = cure->number;
+	const size_t np = cure->props.size();
+		// destination of each property of the element (-1 if it is not read)
+	vector<int> pdest(np,-1);
+	for(size_t k=0;k<dest.size();++k)
+	{
+		const PlyProperty * p = cure->FindProp(dest[k].propname);
+		if(p==0) { error = E_PROPNOTFOUND; return -1; }
+		if(!CrossType[p->tipo][dest[k].memtype] || (p->islist && listSize<0)) { error = E_BADCAST; return -1; }
+		pdest[p-&cure->props[0]] = int(k);
+	}
+	const int BlockSize = 1<<14;
+	const int blockNum = (n+BlockSize-1)/BlockSize;
+
+	if(format==F_ASCII)
+	{
+			// one record for each line: the lines are found first, then parsed in parallel
+		const char * end = data+avail;
+		vector<const char *> line(size_t(n)+1);
+		const char * p = data;
+		for(int j=0;j<n;++j)
+		{
+			if(p==end) { error = E_UNESPECTEDEOF; return -1; }
+			line[j] = p;
+			p = vcg::tri::io::AsciiParser::NextLine(p,end);
+		}
+		line[n] = p;
+		int badNum = 0;
+#pragma omp parallel for schedule(static) reduction(+:badNum)
+		for(int b=0;b<blockNum;++b)
+		{
+			const int last = std::min(n,(b+1)*BlockSize);
+			for(int j=b*BlockSize;j<last && badNum==0;++j)
+			{
+				const char * q = line[j];
+				const char * le = line[j+1];
+				bool ok = true;
+				for(size_t i=0;i<np && ok;++i)
+				{
+					const PlyProperty & pr = cure->props[i];
+					const int d = pdest[i];
+					double skip;
+					int cnt = 1;
+					if(pr.islist)
+					{
+						ok = ParseScalarA(q,le,pr.tipoindex,&cnt,T_INT) && (listSize<0 || cnt==listSize);
+						if(d>=0) cnt = listSize;
+					}
+					for(int c=0;c<cnt && ok;++c)
+					{
+						if(d>=0)
+							ok = ParseScalarA(q,le,pr.tipo,(char *)dest[d].base+size_t(j)*dest[d].stride+c*TypeSize[dest[d].memtype],dest[d].memtype);
+						else
+							ok = ParseScalarA(q,le,pr.tipo,&skip,T_DOUBLE);
+					}
+				}
+				q = vcg::tri::io::AsciiParser::SkipBlanks(q,le);
+				if(!ok || (q<le && *q!='\n')) ++badNum;
+			}
+		}
+		if(badNum>0) { error = E_BADTYPE; return -1; }
+		return Skip(size_t(line[n]-data));
+	}
+
+	const int rs = cure->RecordSize(listSize);
+	if(avail < size_t(n)*rs)
+	{
+		error = E_UNESPECTEDEOF;
+		return -1;
+	}
+		// all the lists must have listSize items (the records must have the same size)
+	for(size_t i=0;i<np;++i)
+		if(cure->props[i].islist)
+		{
+			vector<int> cnt(n);
+			ConvertBlock(data+cure->PropOffset(cure->props[i].name.c_str(),listSize),rs,cure->props[i].tipoindex,&cnt[0],sizeof(int),T_INT,n);
+			if(std::count(cnt.begin(),cnt.end(),listSize)!=n) { error = E_BADTYPE; return -1; }
+		}
+	vector<int> off(dest.size()), tipo(dest.size()), cnt(dest.size(),1);
+	for(size_t i=0;i<np;++i)
+	{
+		const int d = pdest[i];
+		if(d<0) continue;
+		const PlyProperty & pr = cure->props[i];
+		off[d] = cure->PropOffset(pr.name.c_str(),listSize);
+		tipo[d] = pr.tipo;
+		if(pr.islist) { off[d] += TypeSize[pr.tipoindex]; cnt[d] = listSize; }
+	}
+		// a block of records at a time, converting each property with its own loop
+#pragma omp parallel for schedule(static)
+	for(int b=0;b<blockNum;++b)
+	{
+		const int first = b*BlockSize;
+		const int num = std::min(BlockSize,n-first);
+		for(size_t k=0;k<dest.size();++k)
+			for(int c=0;c<cnt[k];++c)
+				ConvertBlock(data+size_t(first)*rs+off[k]+c*TypeSize[tipo[k]],rs,tipo[k],
+				             (char *)dest[k].base+size_t(first)*dest[k].stride+c*TypeSize[dest[k].memtype],dest[k].stride,dest[k].memtype,num);
+	}
+	return Skip(size_t(n)*rs);
+}
+
 void interpret_texture_name(const char*a, const char*fn, char*output){
 	int ia=0,io=0;
 	output[0]=0;
@@ -226,6 +226,12 @@ public:
 
 	PlyProperty * FindProp( const char * name );
 
+		// Size in bytes of a record of this element on a binary file when all its lists
+		// have listSize items (-1 if it has lists and listSize is negative)
+	int RecordSize( int listSize=-1 ) const;
+		// Offset in bytes of a property (of the counter, for a list) inside such a record (-1 if not found)
+	int PropOffset( const char * name, int listSize=-1 ) const;
+
 	std::string name;				// Nome dell'elemento
 	int    number;				// Numero di elementi di questo tipo
 
@@ -295,6 +301,35 @@ public:
 		// Lettura du un elemento
 	int Read( void * mem );
 
+		// Fast path for the binary little endian and the ascii files: they are memory mapped
+		// and all the records of an element can be read at once with ReadBlock, converting
+		// each property with a single loop straight into the destination arrays
+		// (e.g. the vertex vector); the ascii records are parsed in parallel, one for each line.
+	inline bool IsMapped() const { return mapData!=0; }
+		// Raw data from the current read position to the end of the file (0 if not mapped)
+	const char * MappedData( size_t & avail );
+		// Move forward the current read position
+	int Skip( size_t bytes );
+		// Destination of a property for ReadBlock: the value of the i-th record (for a list,
+		// its items one after the other) is stored with type memtype at base+i*stride
+	struct BlockDest
+	{
+		const char * propname;
+		int memtype;
+		void * base;
+		size_t stride;
+	};
+		// Read all the records of the current element; the lists (if any) must all have listSize
+		// items, otherwise it fails (and nothing is consumed) so that they can be read with Read.
+	int ReadBlock( const std::vector<BlockDest> & dest, int listSize=-1 );
+		// Same, for elements without lists: the descriptors give names, memory types and
+		// offsets of the properties to store in records stride bytes apart
+	int ReadBlock( const std::vector<PropDescriptor> & desc, void * mem, size_t stride );
+		// Size in bytes of a ply type
+	static int TypeSizeOf( int type );
+		// Convert n values from stotype (stored srcStride bytes apart) to memtype (dstStride bytes apart)
+	static void ConvertBlock( const char * src, size_t srcStride, int stotype, void * dst, size_t dstStride, int memtype, int n );
+
   std::vector<PlyElement>   elements;	// Vettore degli elementi
 	std::vector<std::string>  comments;	// Vettore dei commenti
 	static const char * typenames[9];
@@ -313,11 +348,17 @@ protected:
 
 	PlyElement * cure;			// Elemento da leggere
 
+	const char * mapData;		// Il file mappato in memoria (ascii e binary little endian)
+	size_t mapSize;
+	void * mapHandle;
+
 		// Callback di lettura: vale ReadBin o ReadAcii
 	int (* ReadCB)( GZFILE fp, const PlyProperty * r, void * mem, int fmt );
 
 	int OpenRead( const char * filename );
 	int OpenWrite( const char * filename );
+	void MapFile( const char * filename );
+	void UnmapFile();
 	
 	PlyElement * AddElement( const char * name, int number );
 	int FindType( const char * name ) const;